@@ -45,13 +45,23 @@ void sys_msleep(unsigned int ms);
 
 namespace rtps {
 
+class Reader;
 class Writer;
 
 class ThreadPool {
 public:
   using receiveJumppad_fp = void (*)(void *callee, const PacketInfo &packet);
-
-  ThreadPool(receiveJumppad_fp receiveCallback, void *callee);
+  //! Decides in the UDP receive callback whether a packet can be dropped
+  //! right away, e.g. because it is our own one coming back
+  using dropFilter_fp = bool (*)(void *callee, Ip4Port_t destPort,
+                                 const pbuf *packet);
+  //! Sends combined messages that are due. Returns the time in ms until the
+  //! next one is, 0 if none is waiting.
+  using flushJumppad_fp = uint32_t (*)(void *callee);
+
+  ThreadPool(receiveJumppad_fp receiveCallback, void *callee,
+             dropFilter_fp dropFilter = nullptr,
+             flushJumppad_fp flushCallback = nullptr);
 
   ~ThreadPool();
 
@@ -60,30 +70,61 @@ public:
 
   void clearQueues();
   bool addWorkload(Writer *workload);
+  //! Queues workload once delayMs have passed instead of blocking a writer
+  //! thread, e.g. while a flow controller throttles it. Each writer waits at
+  //! most once, a second request keeps the earlier time.
+  bool addWorkload(Writer *workload, uint32_t delayMs);
   bool addNewPacket(PacketInfo &&packet);
+  //! Runs the pending callbacks of reader on a callback thread
+  bool addCallbackWork(Reader *reader);
+  bool hasCallbackThreads() const {
+    return Config::THREAD_POOL_NUM_CALLBACK_THREADS > 0;
+  }
 
   static void readCallback(void *arg, udp_pcb *pcb, pbuf *p,
                            const ip_addr_t *addr, Ip4Port_t port);
+  //! Wakes a writer thread to flush combined messages in time
+  static void flushRequestCallback(void *arg);
   static void writerThreadFunction(void *arg);
   static void readerThreadFunction(void *arg);
+  static void callbackThreadFunction(void *arg);
 
 private:
   receiveJumppad_fp m_receiveJumppad;
+  dropFilter_fp m_dropFilter;
+  flushJumppad_fp m_flushJumppad;
   void *m_callee;
   bool m_running = false;
   std::array<sys_thread_t, Config::THREAD_POOL_NUM_WRITERS> m_writers;
   std::array<sys_thread_t, Config::THREAD_POOL_NUM_READERS> m_readers;
+  std::array<sys_thread_t, Config::THREAD_POOL_NUM_CALLBACK_THREADS>
+      m_callbackThreads;
 
   sys_sem_t m_readerNotificationSem;
   sys_sem_t m_writerNotificationSem;
+  sys_sem_t m_callbackNotificationSem;
+
+  struct DelayedWorkload {
+    Writer *workload;
+    uint32_t dueMs;
+  };
+  sys_mutex_t m_delayedMutex;
+  // Only stateless writers are throttled without a thread of their own
+  std::array<DelayedWorkload, Config::NUM_STATELESS_WRITERS> m_delayed{};
 
   ThreadSafeCircularBuffer<Writer *, Config::THREAD_POOL_WORKLOAD_QUEUE_LENGTH>
       m_queueOutgoing;
   ThreadSafeCircularBuffer<PacketInfo,
                            Config::THREAD_POOL_WORKLOAD_QUEUE_LENGTH>
       m_queueIncoming;
+  ThreadSafeCircularBuffer<Reader *, Config::THREAD_POOL_WORKLOAD_QUEUE_LENGTH>
+      m_queueCallbacks;
   void doWriterWork();
+  //! Queues the delayed workloads that are due. Returns the time in ms until
+  //! the next one is, 0 if none is waiting.
+  uint32_t queueDueWorkloads();
   void doReaderWork();
+  void doCallbackWork();
 };
 } // namespace rtps
 #ifdef __cplusplus
@@ -91,6 +132,7 @@ extern "C" {
 #endif
 void callWriterThreadFunction(void *arg);
 void callReaderThreadFunction(void *arg);
+void callCallbackThreadFunction(void *arg);
 #ifdef __cplusplus
 }
 #endif
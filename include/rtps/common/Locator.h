@@ -63,6 +63,16 @@ struct Locator {
 
   bool isValid() const { return kind != LocatorKind_t::LOCATOR_KIND_INVALID; }
 
+  bool isMulticast() const {
+    return kind == LocatorKind_t::LOCATOR_KIND_UDPv4 &&
+           (address[12] & 0xF0) == 0xE0;
+  }
+
+  bool operator==(const Locator &other) const {
+    return kind == other.kind && port == other.port &&
+           address == other.address;
+  }
+
   bool readFromUcdrBuffer(ucdrBuffer &buffer) {
     if (ucdr_buffer_remaining(&buffer) < sizeof(Locator)) {
       return false;
@@ -111,9 +121,7 @@ inline Locator getUserUnicastLocator(ParticipantId_t participantId) {
 }
 
 inline Locator getUserMulticastLocator() {
-  return Locator::createUDPv4Locator(
-      Config::IP_ADDRESS[0], Config::IP_ADDRESS[1], Config::IP_ADDRESS[2],
-      Config::IP_ADDRESS[3], getUserMulticastPort());
+  return Locator::createUDPv4Locator(239, 255, 0, 1, getUserMulticastPort());
 }
 
 inline Locator getDefaultSendMulticastLocator() {
@@ -77,6 +77,16 @@ enum class ReliabilityKind_t : uint32_t {
   RELIABLE = 2 // Specification says 3 but eprosima sends 2
 };
 
+// Ordered such that a writer offering a kind satisfies all lower requests
+enum class DurabilityKind_t : uint32_t {
+  VOLATILE = 0,
+  TRANSIENT_LOCAL = 1,
+  TRANSIENT = 2,
+  PERSISTENT = 3
+};
+
+enum class HistoryKind_t : uint32_t { KEEP_LAST = 0, KEEP_ALL = 1 };
+
 struct GuidPrefix_t {
   std::array<uint8_t, 12> id;
 
@@ -159,7 +169,7 @@ struct SequenceNumber_t {
   }
 };
 
-const uint32_t SNS_NUM_BITS = 32;
+const uint32_t SNS_NUM_BITS = 256;
 struct SequenceNumberSet {
 
   SequenceNumberSet() = default;
@@ -169,23 +179,55 @@ struct SequenceNumberSet {
   SequenceNumber_t base = {0, 0};
   // Cannot be static because of packed
   uint32_t numBits = SNS_NUM_BITS;
-  std::array<uint32_t, 8> bitMap{};
+  std::array<uint32_t, SNS_NUM_BITS / 32> bitMap{};
 
-  // We only need 1 byte because atm we don't store packets.
   bool isSet(uint32_t bit) const {
     if (bit >= SNS_NUM_BITS) {
       return true;
     }
     const auto bucket = static_cast<uint8_t>(bit / 32);
     const auto pos = static_cast<uint8_t>(bit % 32);
-    return (bitMap[bucket] & (1 << (31 - pos))) != 0;
+    return (bitMap[bucket] & (uint32_t{1} << (31 - pos))) != 0;
   }
+
+  void set(uint32_t bit) {
+    if (bit < SNS_NUM_BITS) {
+      bitMap[bit / 32] |= uint32_t{1} << (31 - bit % 32);
+    }
+  }
+
+  //! Number of 32 bit words needed on the wire for numBits
+  uint32_t getNumWords() const { return (numBits + 31) / 32; }
 };
 
 struct FragmentNumber_t {
   uint32_t value;
 };
 
+const uint32_t FNS_NUM_BITS = 256;
+
+struct FragmentNumberSet {
+  FragmentNumber_t base = {1};
+  uint32_t numBits = 0;
+  std::array<uint32_t, FNS_NUM_BITS / 32> bitMap{};
+
+  bool isSet(uint32_t bit) const {
+    if (bit >= FNS_NUM_BITS) {
+      return false;
+    }
+    return (bitMap[bit / 32] & (uint32_t{1} << (31 - bit % 32))) != 0;
+  }
+
+  void set(uint32_t bit) {
+    if (bit < FNS_NUM_BITS) {
+      bitMap[bit / 32] |= uint32_t{1} << (31 - bit % 32);
+    }
+  }
+
+  //! Number of 32 bit words needed on the wire for numBits
+  uint32_t getNumWords() const { return (numBits + 31) / 32; }
+};
+
 struct Count_t {
   int32_t value;
 };
@@ -0,0 +1,97 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_MESSAGEAGGREGATOR_H
+#define RTPS_MESSAGEAGGREGATOR_H
+
+#include "lwip/sys.h"
+#include "rtps/common/types.h"
+#include "rtps/communication/PacketInfo.h"
+#include "rtps/config.h"
+
+#include <array>
+
+namespace rtps {
+
+/**
+ * Combines the messages of all writers to the same destination into one
+ * message with a single RTPS header. A combined message is sent once it would
+ * exceed SEND_AGGREGATION_MAX_MESSAGE_SIZE, once it waited
+ * SEND_AGGREGATION_LATENCY_MS or on flush().
+ *
+ * Submessages are copied, as messages may end with a payload that is chained
+ * from the history of a writer. Such a last submessage is padded to 4 bytes
+ * before anything is appended behind it.
+ */
+class MessageAggregator {
+public:
+  using send_fp = void (*)(void *callee, PacketInfo &packet);
+
+  MessageAggregator(send_fp send, void *callee);
+  ~MessageAggregator();
+  MessageAggregator(const MessageAggregator &) = delete;
+  MessageAggregator &operator=(const MessageAggregator &) = delete;
+
+  static constexpr bool isEnabled() {
+    return Config::SEND_AGGREGATION_LATENCY_MS != 0;
+  }
+
+  //! Queues packet or sends it right away. Returns true if packet started a
+  //! new combined message, i.e. flushDue() has to be called in time.
+  bool add(PacketInfo &packet);
+  //! Sends all combined messages
+  void flush();
+  //! Sends the combined messages that waited long enough. Returns the time
+  //! in ms until the next one is due, 0 if none is left.
+  uint32_t flushDue();
+
+private:
+  struct Batch {
+    PacketInfo packet;
+    GuidPrefix_t prefix = GUIDPREFIX_UNKNOWN;
+    uint32_t startMs = 0;
+    bool isUsed = false;
+    //! Set if the last submessage can't be padded, nothing may follow it
+    bool isClosed = false;
+  };
+
+  send_fp m_send;
+  void *m_callee;
+  sys_mutex_t m_mutex;
+  std::array<Batch, Config::SEND_AGGREGATION_NUM_DESTINATIONS> m_batches;
+
+  Batch *findBatch(const PacketInfo &packet, const GuidPrefix_t &prefix);
+  Batch *findFreeBatch();
+  static bool append(Batch &batch, const PacketInfo &packet);
+  //! Pads the submessages copied to buffer from start on to a multiple of 4
+  //! bytes and fixes the length of the last one. Returns false if it can't
+  //! be padded, i.e. nothing may be appended behind it.
+  static bool alignEnd(PBufWrapper &buffer, DataSize_t start);
+  void send(PacketInfo &packet) { m_send(m_callee, packet); }
+};
+
+} // namespace rtps
+
+#endif // RTPS_MESSAGEAGGREGATOR_H
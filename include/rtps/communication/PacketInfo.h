@@ -30,14 +30,19 @@ Author: i11 - Embedded Software, RWTH Aachen University
 
 namespace rtps {
 
+struct UdpConnection;
+
 struct PacketInfo {
   Ip4Port_t srcPort; // TODO Do we need that?
   ip4_addr_t destAddr;
   Ip4Port_t destPort;
   PBufWrapper buffer;
+  //! Connection of srcPort, looked up on sending if not resolved beforehand
+  const UdpConnection *conn = nullptr;
 
   void copyTriviallyCopyable(const PacketInfo &other) {
     this->srcPort = other.srcPort;
+    this->conn = other.conn;
     this->destPort = other.destPort;
     this->destAddr = other.destAddr;
   }
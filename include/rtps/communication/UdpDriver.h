@@ -28,6 +28,7 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "UdpConnection.h"
 #include "lwip/udp.h"
 #include "rtps/common/types.h"
+#include "rtps/communication/MessageAggregator.h"
 #include "rtps/communication/PacketInfo.h"
 #include "rtps/config.h"
 #include "rtps/storages/PBufWrapper.h"
@@ -41,12 +42,24 @@ class UdpDriver {
 public:
   typedef void (*udpRxFunc_fp)(void *arg, udp_pcb *pcb, pbuf *p,
                                const ip_addr_t *addr, Ip4Port_t port);
+  //! Called with the args of the receive callback when a combined message
+  //! was started. flushDue() has to be called within the latency budget.
+  typedef void (*flushRequest_fp)(void *arg);
 
-  UdpDriver(udpRxFunc_fp callback, void *args);
+  UdpDriver(udpRxFunc_fp callback, void *args,
+            flushRequest_fp flushRequest = nullptr);
 
   const rtps::UdpConnection *createUdpConnection(Ip4Port_t receivePort);
   bool joinMultiCastGroup(ip4_addr_t addr) const;
+  //! Combined with other messages to the same destination if
+  //! SEND_AGGREGATION_LATENCY_MS is set
   void sendPacket(PacketInfo &info);
+  //! Sends several messages under a single tcpip core lock
+  void sendPackets(PacketInfo *packets, uint8_t numPackets);
+  //! Sends all combined messages right away
+  void flush();
+  //! See MessageAggregator::flushDue()
+  uint32_t flushDue();
 
   static bool isSameSubnet(ip4_addr_t addr);
 
@@ -55,9 +68,15 @@ private:
   std::size_t m_numConns = 0;
   udpRxFunc_fp m_rxCallback = nullptr;
   void *m_callbackArgs = nullptr;
+  flushRequest_fp m_flushRequest = nullptr;
+  MessageAggregator m_aggregator;
 
-  bool sendPacket(const UdpConnection &conn, ip4_addr_t &destAddr,
-                  Ip4Port_t destPort, pbuf &buffer);
+  void sendPacketNow(PacketInfo &info);
+  static void sendJumppad(void *callee, PacketInfo &info);
+
+  const UdpConnection *resolveConnection(PacketInfo &info);
+  //! Requires the tcpip core lock
+  bool sendLocked(const UdpConnection &conn, PacketInfo &info);
 };
 } // namespace rtps
 
@@ -53,18 +53,60 @@ const uint8_t NUM_WRITERS_PER_PARTICIPANT = 4;
 const uint8_t NUM_READERS_PER_PARTICIPANT = 4;
 const uint8_t NUM_WRITER_PROXIES_PER_READER = 3;
 const uint8_t NUM_READER_PROXIES_PER_WRITER = 3;
+// Remote writers whose DATA to ENTITYID_UNKNOWN is routed to matched readers
+const uint8_t NUM_WRITER_ROUTES_PER_PARTICIPANT = 16;
+// Changes a reliable reader buffers ahead of a gap per matched writer (<= 32)
+const uint8_t SF_READER_REORDER_WINDOW_SIZE = 8;
 
 const uint8_t HISTORY_SIZE = 10;
+// Upper bound for the depth of a reader's receive history (take()/read())
+const uint8_t READER_HISTORY_SIZE = 16;
+// Writers with PERSISTENT durability keep their history in a file per writer
+const uint8_t NUM_PERSISTENT_WRITERS = 2;
+const uint16_t PERSISTENT_HISTORY_MAX_SAMPLE_SIZE = 1024; // byte
+const char *const PERSISTENT_HISTORY_DIR = ".";
 
 const uint8_t MAX_TYPENAME_LENGTH = 20;
 const uint8_t MAX_TOPICNAME_LENGTH = 20;
 
-const int HEARTBEAT_STACKSIZE = 1200;          // byte
-const int THREAD_POOL_WRITER_STACKSIZE = 1100; // byte
-const int THREAD_POOL_READER_STACKSIZE = 1600; // byte
-const uint16_t SPDP_WRITER_STACKSIZE = 550;    // byte
+const int HEARTBEAT_STACKSIZE = 1200;            // byte
+const int THREAD_POOL_WRITER_STACKSIZE = 1100;   // byte
+const int THREAD_POOL_READER_STACKSIZE = 1600;   // byte
+const int THREAD_POOL_CALLBACK_STACKSIZE = 2048; // byte
+const uint16_t SPDP_WRITER_STACKSIZE = 550;      // byte
 
 const uint16_t SF_WRITER_HB_PERIOD_MS = 4000;
+// While readers have unacked changes, heartbeats start at the fast period and
+// back off to SF_WRITER_HB_PERIOD_MS. Fully acked writers use the idle period,
+// 0 stops heartbeating.
+const uint16_t SF_WRITER_HB_FAST_PERIOD_MS = 20;
+const uint16_t SF_WRITER_HB_IDLE_PERIOD_MS = 30000;
+// Late-joiner replay of TRANSIENT_LOCAL writers: samples per burst and reader
+const uint8_t DURABILITY_REPLAY_BURST_SIZE = 2;
+const uint16_t DURABILITY_REPLAY_PERIOD_MS = 20;
+// Append a HEARTBEAT to every n-th pushed DATA and to the last one of a burst.
+// 0 disables piggybacking.
+const uint8_t SF_WRITER_PIGGYBACK_HB_PERIOD = 4;
+// Retransmissions for one ACKNACK are packed into messages up to this size
+const uint16_t SF_WRITER_MAX_MESSAGE_SIZE = 1400; // byte
+// Larger samples are sent as DATA_FRAG with fragments of this size. A whole
+// message must fit SF_WRITER_MAX_MESSAGE_SIZE: RTPS header (20), INFO_DST
+// (16), INFO_TS (12), DATA_FRAG header (36) and a HEARTBEAT (32).
+const uint16_t FRAGMENT_SIZE =
+    (SF_WRITER_MAX_MESSAGE_SIZE - 20 - 16 - 12 - 36 - 32) & ~3; // byte
+// Readers announce the user multicast locator. A sample goes out as one
+// multicast message once this many matched readers share it, repairs stay
+// unicast. 0 disables multicast user data.
+const uint8_t MULTICAST_MIN_READERS = 2;
+// Default token bucket of each writer. Data above the rate is deferred.
+// 0 bytes per period disables flow control.
+const uint32_t FLOW_CONTROL_BYTES_PER_PERIOD = 0;
+const uint16_t FLOW_CONTROL_PERIOD_MS = 10;
+const uint32_t FLOW_CONTROL_MAX_BURST = 8192; // byte
+// Readers not answering heartbeats for this long get no data anymore, only
+// a heartbeat every SF_WRITER_HB_PERIOD_MS until they answer again. They are
+// removed with their participant once its SPDP lease expires. 0 disables it.
+const uint32_t SF_WRITER_READER_INACTIVE_MS = 20000;
 const uint16_t SPDP_RESEND_PERIOD_MS = 10000;
 const uint8_t SPDP_WRITER_PRIO = 3;
 const uint8_t SPDP_MAX_NUMBER_FOUND_PARTICIPANTS = 5;
@@ -72,18 +114,30 @@ const uint8_t SPDP_MAX_NUM_LOCATORS = 5;
 const Duration_t SPDP_LEASE_DURATION = {100, 0};
 
 const int MAX_NUM_UDP_CONNECTIONS = 10;
+// Submessages indexed at once, longer messages are indexed in several rounds
+const uint8_t MAX_SUBMESSAGES_PER_MESSAGE = 16;
+// Messages of all writers to the same destination are combined into one for
+// up to this long. 0 sends every message right away.
+const uint8_t SEND_AGGREGATION_LATENCY_MS = 1;
+const uint8_t SEND_AGGREGATION_NUM_DESTINATIONS = 4;
+const uint16_t SEND_AGGREGATION_MAX_MESSAGE_SIZE = 1400; // byte
 
 const int THREAD_POOL_NUM_WRITERS = 2;
 const int THREAD_POOL_NUM_READERS = 2;
 const int THREAD_POOL_WRITER_PRIO = 3;
 const int THREAD_POOL_READER_PRIO = 3;
+// Threads running reader callbacks of readers that use the callback executor.
+// 0 disables the executor.
+const int THREAD_POOL_NUM_CALLBACK_THREADS = 1;
+const int THREAD_POOL_CALLBACK_PRIO = 2;
 const int THREAD_POOL_WORKLOAD_QUEUE_LENGTH = 10;
 
 constexpr int OVERALL_HEAP_SIZE =
     THREAD_POOL_NUM_WRITERS * THREAD_POOL_WRITER_STACKSIZE +
     THREAD_POOL_NUM_READERS * THREAD_POOL_READER_STACKSIZE +
+    THREAD_POOL_NUM_CALLBACK_THREADS * THREAD_POOL_CALLBACK_STACKSIZE +
     MAX_NUM_PARTICIPANTS * SPDP_WRITER_STACKSIZE +
-    NUM_STATEFUL_WRITERS * HEARTBEAT_STACKSIZE;
+    (NUM_STATEFUL_WRITERS + NUM_PERSISTENT_WRITERS) * HEARTBEAT_STACKSIZE;
 } // namespace Config
 } // namespace rtps
 
@@ -58,8 +58,11 @@ public:
       m_defaultMulticastLocatorList;
   Count_t m_manualLivelinessCount{1};
   Duration_t m_leaseDuration = Config::SPDP_LEASE_DURATION;
+  //! Local time of the last announcement, each one renews the lease
+  uint32_t m_lastAnnouncementMs = 0;
 
   void reset();
+  bool isLeaseExpired(uint32_t nowMs) const;
 
   bool readFromUcdrBuffer(ucdrBuffer &buffer);
 
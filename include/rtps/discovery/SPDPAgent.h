@@ -57,6 +57,8 @@ private:
 
   sys_mutex_t m_mutex;
   bool initialized = false;
+  //! Last time an announcement of a known participant was answered
+  uint32_t m_lastAnswerMs = 0;
   static void receiveCallback(void *callee,
                               const ReaderCacheChange &cacheChange);
   void handleSPDPPackage(const ReaderCacheChange &cacheChange);
@@ -41,7 +41,10 @@ struct TopicData {
   char typeName[Config::MAX_TYPENAME_LENGTH];
   char topicName[Config::MAX_TOPICNAME_LENGTH];
   ReliabilityKind_t reliabilityKind;
+  DurabilityKind_t durabilityKind = DurabilityKind_t::VOLATILE;
   Locator unicastLocator;
+  // Only readers announce one, invalid otherwise
+  Locator multicastLocator;
 
   TopicData() = default;
   TopicData(Guid guid, ReliabilityKind_t reliability, Locator loc)
@@ -41,12 +41,21 @@ public:
 
   bool completeInit();
   void stop();
+  //! Sends messages that wait to be combined with others right away
+  void flush();
 
   Participant *createParticipant();
-  Writer *createWriter(Participant &part, const char *topicName,
-                       const char *typeName, bool reliable);
-  Reader *createReader(Participant &part, const char *topicName,
-                       const char *typeName, bool reliable);
+  Writer *
+  createWriter(Participant &part, const char *topicName, const char *typeName,
+               bool reliable,
+               DurabilityKind_t durability = DurabilityKind_t::VOLATILE);
+  Reader *
+  createReader(Participant &part, const char *topicName, const char *typeName,
+               bool reliable,
+               DurabilityKind_t durability = DurabilityKind_t::VOLATILE);
+  //! Runs the callbacks of reader on the callback threads of the domain
+  //! instead of the thread that received the sample
+  bool useCallbackExecutor(Reader &reader);
 
   Writer *writerExists(Participant &part, const char *topicName,
                        const char *typeName, bool reliable);
@@ -68,6 +77,11 @@ private:
   uint8_t m_numStatefulReaders = 0;
   std::array<StatefulWriter, Config::NUM_STATEFUL_WRITERS> m_statefulWriters;
   uint8_t m_numStatefulWriters = 0;
+#if defined(unix) || defined(__unix__)
+  std::array<PersistentStatefulWriter, Config::NUM_PERSISTENT_WRITERS>
+      m_persistentWriters;
+  uint8_t m_numPersistentWriters = 0;
+#endif
 
   bool m_initComplete = false;
 
@@ -76,6 +90,12 @@ private:
   void createBuiltinWritersAndReaders(Participant &part);
   void registerPort(const Participant &part);
   static void receiveJumppad(void *callee, const PacketInfo &packet);
+  //! True if packet was sent by one of our participants and none of the
+  //! others listens on destPort
+  bool isOwnPacket(Ip4Port_t destPort, const pbuf *packet) const;
+  static bool isOwnPacketJumppad(void *callee, Ip4Port_t destPort,
+                                 const pbuf *packet);
+  static uint32_t flushJumppad(void *callee);
 };
 } // namespace rtps
 
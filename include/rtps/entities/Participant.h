@@ -29,7 +29,11 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/config.h"
 #include "rtps/discovery/SEDPAgent.h"
 #include "rtps/discovery/SPDPAgent.h"
+#include "rtps/messages/MessageIndex.h"
 #include "rtps/messages/MessageReceiver.h"
+#include "rtps/storages/EntityIndex.h"
+#include "rtps/storages/MemoryPool.h"
+#include "rtps/storages/WriterRouteTable.h"
 
 namespace rtps {
 
@@ -65,29 +69,53 @@ public:
   bool registerOnNewSubscriberMatchedCallback(void (*callback)(void *arg),
                                               void *args);
 
-  //! Not-thread-safe function to add a writer
+  //! Not-thread-safe function to add a writer. Fails if the participant is full
+  //! or the entity id is taken.
   Writer *addWriter(Writer *writer);
   bool isWritersFull();
 
-  //! Not-thread-safe function to add a reader
+  //! Not-thread-safe function to add a reader. Fails if the participant is full
+  //! or the entity id is taken.
   Reader *addReader(Reader *reader);
   bool isReadersFull();
 
   //! (Probably) Thread safe if writers cannot be removed
   Writer *getWriter(EntityId_t id) const;
+  //! Matches on topic, type and reliability. Durability is not a criterion:
+  //! a VOLATILE writer still serves TRANSIENT_LOCAL readers (as ROS 2 does),
+  //! they only miss the history.
   Writer *getMatchingWriter(const TopicData &topicData) const;
   //! (Probably) Thread safe if readers cannot be removed
   Reader *getReader(EntityId_t id) const;
-  Reader *getMatchingReader(const TopicData &topicData) const;
+  //! All readers that match the writer described by topicData, by the same
+  //! criteria as getMatchingWriter
+  uint8_t getMatchingReaders(const TopicData &topicData,
+                             WriterRouteTable::ReaderList &readers) const;
+
+  //! Routes DATA of the remote writer that is sent to ENTITYID_UNKNOWN to
+  //! reader. Called on matching.
+  bool addWriterRoute(const Guid &writerGuid, Reader &reader);
+  uint8_t getRoutedReaders(const Guid &writerGuid,
+                           WriterRouteTable::ReaderList &readers);
 
   bool addNewRemoteParticipant(const ParticipantProxyData &remotePart);
+  //! Forgets the remote participant together with the proxies and routes of
+  //! its endpoints. It is matched anew once it announces itself again.
   bool removeRemoteParticipant(const GuidPrefix_t &prefix);
+  //! Removes every remote participant whose SPDP lease expired at nowMs
+  void removeExpiredRemoteParticipants(uint32_t nowMs);
+  //! Renews the lease of a known remote participant. False if it is unknown.
+  bool renewRemoteParticipantLease(const GuidPrefix_t &prefix, uint32_t nowMs);
   const ParticipantProxyData *findRemoteParticipant(const GuidPrefix_t &prefix);
   uint32_t getRemoteParticipantCount();
   MessageReceiver *getMessageReceiver();
 
   void addBuiltInEndpoints(BuiltInEndpoints &endpoints);
-  void newMessage(const uint8_t *data, DataSize_t size);
+  void newMessage(const uint8_t *data, DataSize_t size,
+                  pbuf *packetBuffer = nullptr);
+  //! Same as above for a message indexed once for several participants.
+  //! state belongs to this participant and is kept for all rounds.
+  void newMessage(const MessageIndex &index, ReceiverState &state);
 
 private:
   MessageReceiver m_receiver;
@@ -95,14 +123,20 @@ private:
   std::array<uint8_t, 3> m_nextUserEntityId{{0, 0, 1}};
   std::array<Writer *, Config::NUM_WRITERS_PER_PARTICIPANT> m_writers{};
   uint8_t m_numWriters = 0;
+  EntityIndex<Writer, Config::NUM_WRITERS_PER_PARTICIPANT> m_writerIndex;
   std::array<Reader *, Config::NUM_READERS_PER_PARTICIPANT> m_readers{};
   uint8_t m_numReaders = 0;
+  EntityIndex<Reader, Config::NUM_READERS_PER_PARTICIPANT> m_readerIndex;
+  WriterRouteTable m_writerRoutes;
 
   MemoryPool<ParticipantProxyData, Config::SPDP_MAX_NUMBER_FOUND_PARTICIPANTS>
       m_remoteParticipants;
 
   SPDPAgent m_spdpAgent;
   SEDPAgent m_sedpAgent;
+
+  static bool isMatchingReader(Reader &reader,
+                               const TopicData &writerTopicData);
 };
 } // namespace rtps
 
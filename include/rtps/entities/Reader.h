@@ -30,11 +30,15 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/discovery/TopicData.h"
 #include "rtps/entities/WriterProxy.h"
 #include "rtps/storages/PBufWrapper.h"
+#include "rtps/storages/ReaderHistory.h"
 #include <cstring>
 
 namespace rtps {
 
 struct SubmessageHeartbeat;
+struct SubmessageGap;
+struct SubmessageDataFrag;
+class ThreadPool;
 
 class ReaderCacheChange {
 private:
@@ -46,10 +50,15 @@ public:
   const Guid writerGuid;
   const SequenceNumber_t sn;
   const uint8_t *data;
+  //! pbuf that data points into, if any. Taking a reference (pbuf_ref) keeps
+  //! data valid after the callback returned.
+  pbuf *const packetBuffer;
 
   ReaderCacheChange(ChangeKind_t kind, Guid &writerGuid, SequenceNumber_t sn,
-                    const uint8_t *data, DataSize_t size)
-      : data(data), kind(kind), size(size), writerGuid(writerGuid), sn(sn){};
+                    const uint8_t *data, DataSize_t size,
+                    pbuf *packetBuffer = nullptr)
+      : data(data), kind(kind), size(size), writerGuid(writerGuid), sn(sn),
+        packetBuffer(packetBuffer){};
 
   ~ReaderCacheChange() =
       default; // No need to free data. It's not owned by this object
@@ -81,16 +90,66 @@ class Reader {
 public:
   TopicData m_attributes;
   virtual void newChange(const ReaderCacheChange &cacheChange) = 0;
-  virtual void registerCallback(ddsReaderCallback_fp cb, void *callee) = 0;
+  //! Received samples are queued in the history and handed to cb once the
+  //! reader released its locks. Enables a KEEP_ALL history if there is none.
+  void registerCallback(ddsReaderCallback_fp cb, void *callee);
+  //! Runs the callback on the callback threads of pool instead of the
+  //! receiving thread
+  bool setCallbackExecutor(ThreadPool *pool);
+  //! Hands all queued samples to the callback
+  void executeCallbacks();
   virtual bool onNewHeartbeat(const SubmessageHeartbeat &msg,
                               const GuidPrefix_t &remotePrefix) = 0;
+  virtual bool onNewGap(const SubmessageGap &msg,
+                        const GuidPrefix_t &remotePrefix) = 0;
+  //! data holds the fragments of this submessage
+  virtual void onNewDataFrag(const SubmessageDataFrag &msg,
+                             const GuidPrefix_t &remotePrefix,
+                             const uint8_t *data, DataSize_t size) = 0;
   virtual bool addNewMatchedWriter(const WriterProxy &newProxy) = 0;
   virtual void removeWriter(const Guid &guid) = 0;
+  //! Removes all writers of the given remote participant
+  virtual void removeWriterOfParticipant(const GuidPrefix_t &guidPrefix) = 0;
   bool isInitialized() { return m_is_initialized_; }
 
+  //! Keeps received samples for take()/read(). Has to be called before
+  //! writers are matched.
+  bool enableHistory(HistoryKind_t kind, uint8_t depth) {
+    return m_history.init(kind, depth);
+  }
+  //! Removes up to maxSamples of the oldest received samples
+  uint32_t take(ReaderSample *samples, uint32_t maxSamples) {
+    return m_history.take(samples, maxSamples);
+  }
+  //! Returns up to maxSamples of the oldest received samples without
+  //! removing them
+  uint32_t read(ReaderSample *samples, uint32_t maxSamples) {
+    return m_history.read(samples, maxSamples);
+  }
+
 protected:
   bool m_is_initialized_ = false;
-  virtual ~Reader() = default;
+  ReaderHistory m_history;
+  ddsReaderCallback_fp m_callback = nullptr;
+  void *m_callee = nullptr;
+  ThreadPool *m_executor = nullptr;
+  //! Keeps callbacks in order if several threads dispatch
+  sys_mutex_t m_dispatchMutex;
+
+  virtual ~Reader();
+  //! Runs the callback for queued samples, here or on the executor
+  void dispatchCallbacks();
+
+  //! Calls dispatchCallbacks() when leaving the scope. Declared ahead of the
+  //! lock of a reader, the callbacks run after the lock was released.
+  class DispatchOnExit {
+  public:
+    explicit DispatchOnExit(Reader &reader) : m_reader(reader) {}
+    ~DispatchOnExit() { m_reader.dispatchCallbacks(); }
+
+  private:
+    Reader &m_reader;
+  };
 };
 } // namespace rtps
 
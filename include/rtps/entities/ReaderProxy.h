@@ -26,20 +26,78 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #define RTPS_READERPROXY_H
 
 #include "rtps/common/types.h"
+#include "rtps/config.h"
 #include "rtps/discovery/ParticipantProxyData.h"
 
 namespace rtps {
 struct ReaderProxy {
   Guid remoteReaderGuid;
   Locator remoteLocator;
+  // Invalid if the reader takes unicast only
+  Locator multicastLocator;
+  // Only TRANSIENT_LOCAL and above are served the retained history on match
+  DurabilityKind_t durabilityKind = DurabilityKind_t::VOLATILE;
   SequenceNumberSet ackNackSet;
   Count_t ackNackCount;
+  Count_t nackFragCount{0};
+  // Historical samples [replayNextSN, replayEndSN) still owed to a late joiner
+  SequenceNumber_t replayNextSN{0, 0};
+  SequenceNumber_t replayEndSN{0, 0};
+  // Last request the flow controller held back, resent once it admits it
+  SequenceNumberSet deferredRequest;
+  bool hasDeferredRequest = false;
+  // Everything below was acknowledged by the reader
+  SequenceNumber_t firstUnackedSN{0, 0};
+  // Liveness: set by a heartbeat, cleared by the next ACKNACK. Silent readers
+  // turn inactive and are removed later.
+  bool awaitingAckNack = false;
+  uint32_t awaitingSinceMs = 0;
+  bool isActive = true;
+
+  bool hasPendingReplay() const { return replayNextSN < replayEndSN; }
+  bool isReplayPending(const SequenceNumber_t &sn) const {
+    return replayNextSN <= sn && sn < replayEndSN;
+  }
+  bool hasUnacked(const SequenceNumber_t &lastSN) const {
+    return lastSN != SEQUENCENUMBER_UNKNOWN && !(lastSN < firstUnackedSN);
+  }
 
   ReaderProxy() : remoteReaderGuid({GUIDPREFIX_UNKNOWN, ENTITYID_UNKNOWN}){};
-  ReaderProxy(const Guid &guid, const Locator &loc)
+  ReaderProxy(const Guid &guid, const Locator &loc,
+              const Locator &multicastLoc = Locator(),
+              DurabilityKind_t durability = DurabilityKind_t::VOLATILE)
       : remoteReaderGuid(guid), remoteLocator(loc),
+        multicastLocator(multicastLoc), durabilityKind(durability),
         ackNackSet(), ackNackCount{0} {};
 };
+
+// Multicast locator that at least Config::MULTICAST_MIN_READERS active readers
+// share, invalid if there is none. A reader still owed a replay rules its
+// locator out, it must not get newer samples ahead of the replayed ones.
+// Requires the writer's mutex, the replay fields change under it.
+template <class ProxyView>
+Locator getSharedMulticastLocator(ProxyView &proxies) {
+  if (Config::MULTICAST_MIN_READERS == 0) {
+    return Locator();
+  }
+  for (const ReaderProxy &candidate : proxies) {
+    if (!candidate.multicastLocator.isValid() || !candidate.isActive) {
+      continue;
+    }
+    uint32_t numSharing = 0;
+    bool isReplayPending = false;
+    for (const ReaderProxy &proxy : proxies) {
+      if (proxy.multicastLocator == candidate.multicastLocator) {
+        numSharing += proxy.isActive ? 1 : 0;
+        isReplayPending = isReplayPending || proxy.hasPendingReplay();
+      }
+    }
+    if (!isReplayPending && numSharing >= Config::MULTICAST_MIN_READERS) {
+      return candidate.multicastLocator;
+    }
+  }
+  return Locator();
+}
 } // namespace rtps
 
 #endif // RTPS_READERPROXY_H
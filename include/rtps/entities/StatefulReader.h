@@ -30,7 +30,8 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/config.h"
 #include "rtps/entities/Reader.h"
 #include "rtps/entities/WriterProxy.h"
-#include "rtps/storages/MemoryPool.h"
+#include "rtps/storages/FragmentBuffer.h"
+#include "rtps/storages/ProxyTable.h"
 
 namespace rtps {
 struct SubmessageHeartbeat;
@@ -40,21 +41,41 @@ public:
   ~StatefulReaderT() override;
   void init(const TopicData &attributes, NetworkDriver &driver);
   void newChange(const ReaderCacheChange &cacheChange) override;
-  void registerCallback(ddsReaderCallback_fp cb, void *callee) override;
   bool addNewMatchedWriter(const WriterProxy &newProxy) override;
   void removeWriter(const Guid &guid) override;
+  void removeWriterOfParticipant(const GuidPrefix_t &guidPrefix) override;
   bool onNewHeartbeat(const SubmessageHeartbeat &msg,
                       const GuidPrefix_t &remotePrefix) override;
+  bool onNewGap(const SubmessageGap &msg,
+                const GuidPrefix_t &remotePrefix) override;
+  void onNewDataFrag(const SubmessageDataFrag &msg,
+                     const GuidPrefix_t &remotePrefix, const uint8_t *data,
+                     DataSize_t size) override;
 
 private:
   PacketInfo
       m_packetInfo; // TODO intended for reuse but buffer not used as such
   NetworkDriver *m_transport;
-  MemoryPool<WriterProxy, Config::NUM_WRITER_PROXIES_PER_READER> m_proxies;
+  ProxyTable<WriterProxy, Config::NUM_WRITER_PROXIES_PER_READER> m_proxies;
 
-  ddsReaderCallback_fp m_callback = nullptr;
-  void *m_callee = nullptr;
   sys_mutex_t m_mutex;
+  FragmentBuffer m_fragments;
+  //! Counted per reader, not per writer proxy. A writer matched again after
+  //! its participant expired must not drop the new ACKNACKs as old ones.
+  Count_t m_ackNackCount{1};
+
+  //! Requires m_mutex
+  Count_t getNextAckNackCount();
+
+  //! Hands the change to the history. False if a KEEP_ALL history is full.
+  bool deliver(const ReaderCacheChange &cacheChange);
+  //! Delivers the change or keeps it in the reorder window. Requires m_mutex.
+  void handleChange(WriterProxy &proxy, const ReaderCacheChange &cacheChange);
+  //! Hands out buffered changes that became next in order. Requires m_mutex.
+  void deliverBufferedChanges(WriterProxy &proxy);
+  //! True if the sample in m_fragments won't be delivered anymore. Requires
+  //! m_mutex.
+  bool isFragmentBufferStale();
 };
 
 using StatefulReader = StatefulReaderT<UdpDriver>;
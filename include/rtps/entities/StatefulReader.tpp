@@ -48,6 +48,7 @@ void StatefulReaderT<NetworkDriver>::init(const TopicData &attributes,
   m_attributes = attributes;
   m_transport = &driver;
   m_packetInfo.srcPort = attributes.unicastLocator.port;
+  m_packetInfo.conn = driver.createUdpConnection(m_packetInfo.srcPort);
   sys_mutex_new(&m_mutex);
   m_is_initialized_ = true;
 }
@@ -55,33 +56,144 @@ void StatefulReaderT<NetworkDriver>::init(const TopicData &attributes,
 template <class NetworkDriver>
 void StatefulReaderT<NetworkDriver>::newChange(
     const ReaderCacheChange &cacheChange) {
-  if (m_callback == nullptr) {
+  if (!m_history.isEnabled()) {
     return;
   }
+  DispatchOnExit dispatch{*this};
   Lock lock{m_mutex};
-  for (auto &proxy : m_proxies) {
+  for (auto &proxy : m_proxies.read()) {
     if (proxy.remoteWriterGuid == cacheChange.writerGuid) {
-      //if (proxy.expectedSN == cacheChange.sn) {
-        m_callback(m_callee, cacheChange);
-        ++proxy.expectedSN;
-        return;
-      //}
+      handleChange(proxy, cacheChange);
+      return;
     }
   }
 }
 
 template <class NetworkDriver>
-void StatefulReaderT<NetworkDriver>::registerCallback(ddsReaderCallback_fp cb,
-                                                      void *callee) {
-  if (cb != nullptr) {
-    m_callback = cb;
-    m_callee = callee; // It's okay if this is null
-  } else {
-#if SLR_VERBOSE
-    printf("StatefulReader[%s]: Passed callback is nullptr\n",
-           &m_attributes.topicName[0]);
+void StatefulReaderT<NetworkDriver>::handleChange(
+    WriterProxy &proxy, const ReaderCacheChange &cacheChange) {
+  if (cacheChange.sn < proxy.expectedSN || proxy.isBuffered(cacheChange.sn)) {
+#if SFR_VERBOSE
+    printf("StatefulReader[%s]: Dropping duplicate (%i,%u)\n",
+           &this->m_attributes.topicName[0], cacheChange.sn.high,
+           cacheChange.sn.low);
+#endif
+    return;
+  }
+  if (proxy.expectedSN == cacheChange.sn) {
+    if (!deliver(cacheChange)) {
+      // No room in the history. Not acknowledging it makes the writer send
+      // it again later.
+      return;
+    }
+    ++proxy.expectedSN;
+    deliverBufferedChanges(proxy);
+  } else if (!proxy.bufferChange(cacheChange.sn, cacheChange.kind,
+                                 cacheChange.packetBuffer, cacheChange.data,
+                                 cacheChange.size)) {
+    // Requested again with the next acknack
+#if SFR_VERBOSE
+    printf("StatefulReader[%s]: Couldn't buffer (%i,%u)\n",
+           &this->m_attributes.topicName[0], cacheChange.sn.high,
+           cacheChange.sn.low);
+#endif
+  }
+}
+
+template <class NetworkDriver>
+void StatefulReaderT<NetworkDriver>::onNewDataFrag(
+    const SubmessageDataFrag &msg, const GuidPrefix_t &sourceGuidPrefix,
+    const uint8_t *data, DataSize_t size) {
+  if (!m_history.isEnabled()) {
+    return;
+  }
+  DispatchOnExit dispatch{*this};
+  Lock lock{m_mutex};
+  const Guid writerGuid{sourceGuidPrefix, msg.writerId};
+  WriterProxy *writer = nullptr;
+  auto proxies = m_proxies.read();
+  for (auto &proxy : proxies) {
+    if (proxy.remoteWriterGuid == writerGuid) {
+      writer = &proxy;
+      break;
+    }
+  }
+  if (writer == nullptr || msg.writerSN < writer->expectedSN ||
+      writer->isBuffered(msg.writerSN)) {
+    return;
+  }
+
+  if (!m_fragments.isFor(writerGuid, msg.writerSN)) {
+    // The next sample in order always gets the buffer, anything else has to
+    // wait until it's free
+    if (m_fragments.isInUse() && !isFragmentBufferStale() &&
+        msg.writerSN != writer->expectedSN) {
+#if SFR_VERBOSE
+      printf("StatefulReader[%s]: Busy reassembling. Dropping fragment.\n",
+             &this->m_attributes.topicName[0]);
 #endif
+      return;
+    }
+    if (!m_fragments.start(writerGuid, msg.writerSN, msg.sampleSize,
+                           msg.fragmentSize)) {
+      return;
+    }
+  }
+
+  m_fragments.add(msg.fragmentStartingNum.value, msg.fragmentsInSubmessage,
+                  msg.fragmentSize, data, size);
+  if (m_fragments.isComplete()) {
+    ReaderCacheChange change{ChangeKind_t::ALIVE, writer->remoteWriterGuid,
+                             msg.writerSN, m_fragments.getData(),
+                             m_fragments.getSampleSize(),
+                             m_fragments.getPbuf()};
+    handleChange(*writer, change);
+    m_fragments.reset(); // A buffered change keeps its own reference
+  }
+}
+
+template <class NetworkDriver>
+bool StatefulReaderT<NetworkDriver>::isFragmentBufferStale() {
+  for (const auto &proxy : m_proxies.read()) {
+    if (proxy.remoteWriterGuid == m_fragments.getWriterGuid()) {
+      return m_fragments.getSequenceNumber() < proxy.expectedSN;
+    }
   }
+  return true;
+}
+
+template <class NetworkDriver>
+void StatefulReaderT<NetworkDriver>::deliverBufferedChanges(
+    WriterProxy &proxy) {
+  if (!m_history.isEnabled()) {
+    return;
+  }
+  const BufferedChange *next;
+  while ((next = proxy.getBufferedExpected()) != nullptr) {
+    ReaderCacheChange change{next->kind, proxy.remoteWriterGuid, next->sn,
+                             next->data, next->size,
+                             next->packet.firstElement};
+    if (!deliver(change)) {
+      return; // Stays buffered until the history has room again
+    }
+    proxy.releaseExpected();
+    ++proxy.expectedSN;
+  }
+}
+
+template <class NetworkDriver>
+bool StatefulReaderT<NetworkDriver>::deliver(
+    const ReaderCacheChange &cacheChange) {
+  return m_history.add(cacheChange.kind, cacheChange.writerGuid,
+                       cacheChange.sn, cacheChange.packetBuffer,
+                       cacheChange.data, cacheChange.size);
+}
+
+template <class NetworkDriver>
+rtps::Count_t StatefulReaderT<NetworkDriver>::getNextAckNackCount() {
+  const Count_t count = m_ackNackCount;
+  ++m_ackNackCount.value;
+  return count;
 }
 
 template <class NetworkDriver>
@@ -108,15 +220,32 @@ void StatefulReaderT<NetworkDriver>::removeWriter(const Guid &guid) {
   m_proxies.remove(thunk, &isElementToRemove);
 }
 
+template <class NetworkDriver>
+void StatefulReaderT<NetworkDriver>::removeWriterOfParticipant(
+    const GuidPrefix_t &guidPrefix) {
+  auto isElementToRemove = [&](const WriterProxy &proxy) {
+    return proxy.remoteWriterGuid.prefix == guidPrefix;
+  };
+  auto thunk = [](void *arg, const WriterProxy &value) {
+    return (*static_cast<decltype(isElementToRemove) *>(arg))(value);
+  };
+
+  while (m_proxies.remove(thunk, &isElementToRemove)) {
+  }
+}
+
 template <class NetworkDriver>
 bool StatefulReaderT<NetworkDriver>::onNewHeartbeat(
     const SubmessageHeartbeat &msg, const GuidPrefix_t &sourceGuidPrefix) {
+  DispatchOnExit dispatch{*this};
   Lock lock(m_mutex);
   PacketInfo info;
   info.srcPort = m_packetInfo.srcPort;
+  info.conn = m_packetInfo.conn;
   WriterProxy *writer = nullptr;
   // Search for writer
-  for (WriterProxy &proxy : m_proxies) {
+  auto proxies = m_proxies.read();
+  for (WriterProxy &proxy : proxies) {
     if (proxy.remoteWriterGuid.prefix == sourceGuidPrefix &&
         proxy.remoteWriterGuid.entityId == msg.writerId) {
       writer = &proxy;
@@ -144,14 +273,48 @@ bool StatefulReaderT<NetworkDriver>::onNewHeartbeat(
   }
 
   writer->hbCount.value = msg.count.value;
+  if (writer->expectedSN < msg.firstSN) {
+    // Whatever came before is gone on the writer side
+    writer->skipTo(msg.firstSN);
+  }
+  // Also picks up changes a full history couldn't take before
+  deliverBufferedChanges(*writer);
+  SequenceNumberSet missing = writer->getMissing(msg.firstSN, msg.lastSN);
+  // A partially received sample is repaired by fragment instead of as a whole.
+  // Later samples are not requested meanwhile, they would only crowd out the
+  // fragments while the reassembly buffer is busy.
+  const bool nackFragments =
+      m_fragments.isInUse() &&
+      m_fragments.getWriterGuid() == writer->remoteWriterGuid &&
+      missing.base <= m_fragments.getSequenceNumber() &&
+      m_fragments.getSequenceNumber() <= msg.lastSN;
+  if (nackFragments) {
+    SequenceNumber_t sn = missing.base;
+    for (uint32_t bit = 0; bit < missing.numBits; ++bit, ++sn) {
+      if (sn == m_fragments.getSequenceNumber()) {
+        missing.numBits = bit;
+        break;
+      }
+    }
+  }
+  if ((msg.header.flags & FLAG_FINAL) != 0 && missing.numBits == 0 &&
+      !nackFragments) {
+    // Final heartbeats, e.g. piggybacked on DATA, only ask for repair
+    return true;
+  }
   info.destAddr = writer->remoteLocator.getIp4Address();
   info.destPort = writer->remoteLocator.port;
   rtps::MessageFactory::addHeader(info.buffer,
                                   m_attributes.endpointGuid.prefix);
   rtps::MessageFactory::addSubMessageDestination(info.buffer);
   rtps::MessageFactory::addAckNack(info.buffer, msg.writerId, msg.readerId,
-                                   writer->getMissing(msg.firstSN, msg.lastSN),
-                                   writer->getNextAckNackCount());
+                                   missing, getNextAckNackCount());
+  if (nackFragments) {
+    rtps::MessageFactory::addNackFrag(
+        info.buffer, msg.writerId, msg.readerId,
+        m_fragments.getSequenceNumber(), m_fragments.getMissing(),
+        getNextAckNackCount());
+  }
 
 #if SFR_VERBOSE
   printf("StatefulReader[%s]: Sending acknack.\n",
@@ -161,4 +324,54 @@ bool StatefulReaderT<NetworkDriver>::onNewHeartbeat(
   return true;
 }
 
+template <class NetworkDriver>
+bool StatefulReaderT<NetworkDriver>::onNewGap(
+    const SubmessageGap &msg, const GuidPrefix_t &sourceGuidPrefix) {
+  DispatchOnExit dispatch{*this};
+  Lock lock(m_mutex);
+  WriterProxy *writer = nullptr;
+  // Search for writer
+  auto proxies = m_proxies.read();
+  for (WriterProxy &proxy : proxies) {
+    if (proxy.remoteWriterGuid.prefix == sourceGuidPrefix &&
+        proxy.remoteWriterGuid.entityId == msg.writerId) {
+      writer = &proxy;
+      break;
+    }
+  }
+
+  if (writer == nullptr) {
+#if SFR_VERBOSE
+    printf("StatefulReader[%s]: Ignore gap. Couldn't find a matching "
+           "writer with id: ",
+           &this->m_attributes.topicName[0]);
+    printEntityId(msg.writerId);
+    printf("\n");
+#endif
+    return false;
+  }
+
+  // Only a gap reaching expectedSN lets us move on. Later ones are requested
+  // and answered again once we get there.
+  if (writer->expectedSN < msg.gapStart) {
+    return true;
+  }
+  if (writer->expectedSN < msg.gapList.base) {
+    writer->skipTo(msg.gapList.base);
+  }
+  SequenceNumber_t sn = msg.gapList.base;
+  for (uint32_t bit = 0; bit < msg.gapList.numBits; ++bit, ++sn) {
+    if (sn == writer->expectedSN && msg.gapList.isSet(bit)) {
+      writer->skipTo(++SequenceNumber_t(sn));
+    }
+  }
+#if SFR_VERBOSE
+  printf("StatefulReader[%s]: Skipped to (%i,%u) on gap.\n",
+         &this->m_attributes.topicName[0], writer->expectedSN.high,
+         writer->expectedSN.low);
+#endif
+  deliverBufferedChanges(*writer);
+  return true;
+}
+
 #undef SFR_VERBOSE
@@ -27,29 +27,42 @@ Author: i11 - Embedded Software, RWTH Aachen University
 
 #include "rtps/entities/ReaderProxy.h"
 #include "rtps/entities/Writer.h"
-#include "rtps/storages/MemoryPool.h"
+#include "rtps/storages/PersistentHistoryCache.h"
+#include "rtps/storages/ProxyTable.h"
 #include "rtps/storages/SimpleHistoryCache.h"
+#include "rtps/utils/FlowController.h"
 
 
 
 namespace rtps {
 
-template <class NetworkDriver> class StatefulWriterT final : public Writer {
+template <class NetworkDriver, class History = SimpleHistoryCache>
+class StatefulWriterT final : public Writer {
 public:
   ~StatefulWriterT() override;
   bool init(TopicData attributes, TopicKind_t topicKind, ThreadPool *threadPool,
             NetworkDriver &driver);
+  //! Binds a history with backing storage (e.g. PersistentHistoryCache) to
+  //! path. Call before init.
+  bool openHistory(const char *path);
 
   bool addNewMatchedReader(const ReaderProxy &newProxy) override;
   void removeReader(const Guid &guid) override;
+  void removeReaderOfParticipant(const GuidPrefix_t &guidPrefix) override;
   //! Executes required steps like sending packets. Intended to be called by
   //! worker threads
   void progress() override;
   const CacheChange *newChange(ChangeKind_t kind, const uint8_t *data,
                                DataSize_t size) override;
+  uint32_t newChanges(ChangeKind_t kind, const Sample *samples,
+                      uint32_t count) override;
   void setAllChangesToUnsent() override;
   void onNewAckNack(const SubmessageAckNack &msg,
                     const GuidPrefix_t &sourceGuidPrefix) override;
+  void onNewNackFrag(const SubmessageNackFrag &msg,
+                     const GuidPrefix_t &sourceGuidPrefix) override;
+  void setFlowControl(uint32_t bytesPerPeriod, uint32_t periodMs,
+                      uint32_t maxBurst) override;
 
 private:
   sys_mutex_t m_mutex;
@@ -60,22 +73,81 @@ private:
 
   TopicKind_t m_topicKind = TopicKind_t::NO_KEY;
   SequenceNumber_t m_nextSequenceNumberToSend = {0, 1};
-  SimpleHistoryCache m_history;
+  History m_history;
   sys_thread_t m_heartbeatThread;
+  //! Wakes the heartbeat thread early, e.g. to start a late-joiner replay
+  sys_sem_t m_hbWakeup;
   Count_t m_hbCount{1};
+  uint8_t m_samplesSinceHb = 0;
+  //! Set by the heartbeat thread while all readers are acked
+  bool m_hbIdle = false;
+  //! Set when a reader acknowledged new data
+  bool m_hbBackoffReset = false;
+  FlowController m_flowController;
+  //! Set when the flow controller held back data, resumed by the heartbeat
+  //! thread once m_flowDeferredSize bytes are available
+  bool m_flowDeferred = false;
+  uint32_t m_flowDeferredSize = 0;
 
   bool m_running = true;
 
-  MemoryPool<ReaderProxy, Config::NUM_READER_PROXIES_PER_WRITER> m_proxies;
-
-  bool sendData(const ReaderProxy &reader, const SequenceNumber_t &sn);
+  using ReaderProxyTable =
+      ProxyTable<ReaderProxy, Config::NUM_READER_PROXIES_PER_WRITER>;
+  ReaderProxyTable m_proxies;
+
+  //! Sends a single DATA. withHeartbeat appends a final HEARTBEAT to the same
+  //! message.
+  bool sendData(const ReaderProxy &reader, const SequenceNumber_t &sn,
+                bool withHeartbeat = false);
+  //! Sends the changes requested from bit on in as few messages as possible,
+  //! with a GAP for those already evicted. withHeartbeat appends a final
+  //! HEARTBEAT to the message with the last change.
+  //! Returns the first bit that did not fit into the message.
+  uint32_t sendRequestedData(const ReaderProxy &reader,
+                             const SequenceNumberSet &requested, uint32_t bit,
+                             SequenceNumber_t &nextSN,
+                             bool withHeartbeat = false);
+  //! Sends the changes of run to ENTITYID_UNKNOWN at the multicast group in as
+  //! few messages as possible. withHeartbeat appends a final HEARTBEAT for
+  //! every reader of the group in proxies to the message with the last change.
+  //! Sends nothing and returns false if one of them is still owed a replay.
+  bool sendMulticastData(ReaderProxyTable::View &proxies, const Locator &group,
+                         const SequenceNumberSet &run, bool withHeartbeat);
+  //! Bytes needed to resend the requested changes. Requires m_mutex.
+  uint32_t getRequestedSize(const SequenceNumberSet &requested);
+  //! Sends the given fragments of sn, one DATA_FRAG per message
+  bool sendFragments(const ReaderProxy &reader, const SequenceNumber_t &sn,
+                     const FragmentNumberSet &fragments, bool withHeartbeat);
+  static FragmentNumberSet allFragmentsOf(DataSize_t size);
+  bool sendReplayBurst();
+  //! Takes size bytes from the flow controller or marks the data as deferred.
+  //! Requires m_mutex.
+  bool admit(uint32_t size);
+  //! Restarts deferred sending once the flow controller allows it.
+  //! Returns the time to wait before trying again, 0 if nothing is deferred.
+  uint32_t resumeDeferredSends();
+  //! Resends the ACKNACK requests the flow controller held back as far as it
+  //! admits them.
+  void sendDeferredRequests();
+  //! Demotes readers that stopped answering heartbeats. Returns the time
+  //! until the next reader is due, 0 if none is silent. anyInactive tells
+  //! whether demoted readers are waiting for their slow heartbeats.
+  uint32_t checkReaderLiveness(bool &anyInactive);
   void sendHeartBeatLoop();
-  void sendHeartBeat();
+  bool hasUnackedChanges();
+  //! UNACKED skips readers which acknowledged everything and inactive ones,
+  //! INACTIVE addresses only the inactive ones
+  enum class HeartbeatTargets : uint8_t { ALL, UNACKED, INACTIVE };
+  void sendHeartBeat(HeartbeatTargets targets = HeartbeatTargets::ALL);
   bool isIrrelevant(ChangeKind_t kind) const;
   static void hbFunctionJumppad(void *thisPointer);
 };
 
 using StatefulWriter = StatefulWriterT<UdpDriver>;
+#if defined(unix) || defined(__unix__)
+using PersistentStatefulWriter =
+    StatefulWriterT<UdpDriver, PersistentHistoryCache>;
+#endif
 } // namespace rtps
 extern void *networkSubDriverPtr;
 extern void *networkPubDriverPtr;
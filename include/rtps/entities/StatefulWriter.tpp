@@ -23,6 +23,7 @@ Author: i11 - Embedded Software, RWTH Aachen University
 */
 
 #include "rtps/messages/MessageFactory.h"
+#include <array>
 #include <cstring>
 #include <stdio.h>
 
@@ -45,31 +46,48 @@ line_cnt_ = (line_cnt_+1)%5; \
 #include "rtps/utils/printutils.h"
 #endif
 
-template <class NetworkDriver>
-StatefulWriterT<NetworkDriver>::~StatefulWriterT() {
+template <class NetworkDriver, class History>
+StatefulWriterT<NetworkDriver, History>::~StatefulWriterT() {
   m_running = false;
+  if (sys_sem_valid(&m_hbWakeup)) {
+    sys_sem_signal(&m_hbWakeup);
+  }
   sys_msleep(10); // Required for tests/ Join currently not available
                   // if(sys_mutex_valid(&m_mutex)){
   sys_mutex_free(&m_mutex);
   //}
+  if (sys_sem_valid(&m_hbWakeup)) {
+    sys_sem_free(&m_hbWakeup);
+  }
 }
 
-template <class NetworkDriver>
-bool StatefulWriterT<NetworkDriver>::init(TopicData attributes,
-                                          TopicKind_t topicKind,
-                                          ThreadPool * /*threadPool*/,
-                                          NetworkDriver &driver) {
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::init(TopicData attributes,
+                                                   TopicKind_t topicKind,
+                                                   ThreadPool *threadPool,
+                                                   NetworkDriver &driver) {
   if (sys_mutex_new(&m_mutex) != ERR_OK) {
 #if SFW_VERBOSE
     log("StatefulWriter: Failed to create mutex.\n");
 #endif
     return false;
   }
+  if (sys_sem_new(&m_hbWakeup, 0) != ERR_OK) {
+#if SFW_VERBOSE
+    log("StatefulWriter: Failed to create semaphore.\n");
+#endif
+    return false;
+  }
 
+  mp_threadPool = threadPool;
   m_transport = &driver;
+  m_flowController.configure(Config::FLOW_CONTROL_BYTES_PER_PERIOD,
+                             Config::FLOW_CONTROL_PERIOD_MS,
+                             Config::FLOW_CONTROL_MAX_BURST);
   m_attributes = attributes;
   m_topicKind = topicKind;
   m_packetInfo.srcPort = attributes.unicastLocator.port;
+  m_packetInfo.conn = driver.createUdpConnection(m_packetInfo.srcPort);
   if (m_attributes.endpointGuid.entityId ==
       ENTITYID_SEDP_BUILTIN_PUBLICATIONS_WRITER) {
     #ifdef MROS2_USE_EMBEDDEDRTPS
@@ -110,8 +128,21 @@ bool StatefulWriterT<NetworkDriver>::init(TopicData attributes,
   return true;
 }
 
-template <class NetworkDriver>
-bool StatefulWriterT<NetworkDriver>::addNewMatchedReader(
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::openHistory(const char *path) {
+  if (!m_history.open(path)) {
+    return false;
+  }
+  // Recovered samples are history for late joiners, not new data to push.
+  // Numbering continues after the last assigned number even if the history
+  // itself is empty by now.
+  m_nextSequenceNumberToSend =
+      ++SequenceNumber_t(m_history.getLastUsedSequenceNumber());
+  return true;
+}
+
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::addNewMatchedReader(
     const ReaderProxy &newProxy) {
 #if SFW_VERBOSE
   log("StatefulWriter[%s]: New reader added with id: ",
@@ -119,11 +150,35 @@ bool StatefulWriterT<NetworkDriver>::addNewMatchedReader(
   printGuid(newProxy.remoteReaderGuid);
   log("\n");
 #endif
-  return m_proxies.add(newProxy);
+  if (m_attributes.durabilityKind < DurabilityKind_t::TRANSIENT_LOCAL ||
+      newProxy.durabilityKind < DurabilityKind_t::TRANSIENT_LOCAL) {
+    if (!m_proxies.add(newProxy)) {
+      return false;
+    }
+    // The new reader has not acked anything yet
+    sys_sem_signal(&m_hbWakeup);
+    return true;
+  }
+
+  // Hand the retained history to the new reader only. The heartbeat thread
+  // paces it out; acknacks for these sequence numbers are ignored meanwhile.
+  ReaderProxy proxy = newProxy;
+  {
+    Lock lock(m_mutex);
+    if (m_history.getSeqNumMin() != SEQUENCENUMBER_UNKNOWN) {
+      proxy.replayNextSN = m_history.getSeqNumMin();
+      proxy.replayEndSN = ++SequenceNumber_t(m_history.getSeqNumMax());
+    }
+    if (!m_proxies.add(proxy)) {
+      return false;
+    }
+  }
+  sys_sem_signal(&m_hbWakeup);
+  return true;
 }
 
-template <class NetworkDriver>
-void StatefulWriterT<NetworkDriver>::removeReader(const Guid &guid) {
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::removeReader(const Guid &guid) {
   auto isElementToRemove = [&](const ReaderProxy &proxy) {
     return proxy.remoteReaderGuid == guid;
   };
@@ -134,8 +189,22 @@ void StatefulWriterT<NetworkDriver>::removeReader(const Guid &guid) {
   m_proxies.remove(thunk, &isElementToRemove);
 }
 
-template <class NetworkDriver>
-const rtps::CacheChange *StatefulWriterT<NetworkDriver>::newChange(
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::removeReaderOfParticipant(
+    const GuidPrefix_t &guidPrefix) {
+  auto isElementToRemove = [&](const ReaderProxy &proxy) {
+    return proxy.remoteReaderGuid.prefix == guidPrefix;
+  };
+  auto thunk = [](void *arg, const ReaderProxy &value) {
+    return (*static_cast<decltype(isElementToRemove) *>(arg))(value);
+  };
+
+  while (m_proxies.remove(thunk, &isElementToRemove)) {
+  }
+}
+
+template <class NetworkDriver, class History>
+const rtps::CacheChange *StatefulWriterT<NetworkDriver, History>::newChange(
     ChangeKind_t kind, const uint8_t *data, DataSize_t size) {
   if (isIrrelevant(kind)) {
     return nullptr;
@@ -157,6 +226,11 @@ const rtps::CacheChange *StatefulWriterT<NetworkDriver>::newChange(
   if (mp_threadPool != nullptr) {
     mp_threadPool->addWorkload(this);
   }
+  if (m_hbIdle) {
+    // Readers have unacked data again
+    m_hbIdle = false;
+    sys_sem_signal(&m_hbWakeup);
+  }
 
 #if SFW_VERBOSE
   log("StatefulWriter[%s]: Adding new data.\n", this->m_attributes.topicName);
@@ -164,25 +238,166 @@ const rtps::CacheChange *StatefulWriterT<NetworkDriver>::newChange(
   return result;
 }
 
-template <class NetworkDriver> void StatefulWriterT<NetworkDriver>::progress() {
-  for (const auto &proxy : m_proxies) {
-    if (!sendData(proxy, m_nextSequenceNumberToSend)) {
-      continue;
+template <class NetworkDriver, class History>
+uint32_t StatefulWriterT<NetworkDriver, History>::newChanges(
+    ChangeKind_t kind, const Sample *samples, uint32_t count) {
+  if (isIrrelevant(kind)) {
+    return 0;
+  }
+  uint32_t added = 0;
+  {
+    Lock lock{m_mutex};
+    for (; added < count; ++added) {
+      if (m_history.isFull() &&
+          !(m_history.getSeqNumMin() < m_nextSequenceNumberToSend)) {
+        break; // Would drop a change before it was sent
+      }
+      m_history.addChange(samples[added].data, samples[added].size);
+    }
+    if (added != 0 && m_hbIdle) {
+      m_hbIdle = false;
+      sys_sem_signal(&m_hbWakeup);
+    }
+  }
+  if (added != 0 && mp_threadPool != nullptr) {
+    mp_threadPool->addWorkload(this);
+  }
+  return added;
+}
+
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::progress() {
+  // Push everything that is not sent yet. A workload may find nothing left if
+  // an earlier one already drained the burst.
+  while (true) {
+    // All unsent changes available right now, e.g. from newChanges
+    SequenceNumberSet run;
+    run.numBits = 0;
+    bool withHeartbeat = false;
+    // DATA_FRAG stays unicast
+    bool isFragmented = false;
+    Locator group;
+    // One view picks the group and serves the readers. A reader that matches
+    // meanwhile recovers this run through its first heartbeat.
+    auto proxies = m_proxies.read();
+    {
+      Lock lock(m_mutex);
+      run.base = m_nextSequenceNumberToSend;
+      // The flow controller is charged per datagram: one for the group and one
+      // for every active reader outside of it. Inactive readers get none.
+      group = getSharedMulticastLocator(proxies);
+      uint32_t numActive = 0;
+      uint32_t numDatagrams = group.isValid() ? 1 : 0;
+      for (const auto &proxy : proxies) {
+        if (proxy.isActive) {
+          ++numActive;
+          const bool isMember =
+              group.isValid() && proxy.multicastLocator == group;
+          numDatagrams += isMember ? 0 : 1;
+        }
+      }
+      const CacheChange *change;
+      while (run.numBits < SNS_NUM_BITS &&
+             (change = m_history.getChangeBySN(m_nextSequenceNumberToSend)) !=
+                 nullptr) {
+        if (!isFragmented && change->data.spaceUsed() > Config::FRAGMENT_SIZE) {
+          if (group.isValid() && run.numBits != 0) {
+            break; // Keeps the run charged for the group multicast
+          }
+          isFragmented = true;
+          numDatagrams = numActive;
+        }
+        // A sample goes out to all readers or stays unsent for now
+        if (!admit(numDatagrams * (SubmessageData::getRawSize() +
+                                   change->data.spaceUsed()))) {
+          break;
+        }
+        run.set(run.numBits);
+        ++run.numBits;
+        ++m_nextSequenceNumberToSend;
+      }
+      if (run.numBits == 0) {
+        return;
+      }
+      if (Config::SF_WRITER_PIGGYBACK_HB_PERIOD != 0) {
+        const uint32_t samplesSinceHb = m_samplesSinceHb + run.numBits;
+        const bool endOfBurst =
+            m_history.getSeqNumMax() < m_nextSequenceNumberToSend;
+        withHeartbeat = endOfBurst || samplesSinceHb >=
+                                          Config::SF_WRITER_PIGGYBACK_HB_PERIOD;
+        m_samplesSinceHb = withHeartbeat ? 0 : samplesSinceHb;
+      }
+      if (isFragmented) {
+        group = Locator();
+      }
+    }
+
+    if (group.isValid() &&
+        !sendMulticastData(proxies, group, run, withHeartbeat)) {
+      group = Locator();
+    }
+    for (const auto &proxy : proxies) {
+      if (!proxy.isActive ||
+          (group.isValid() && proxy.multicastLocator == group)) {
+        continue;
+      }
+      if (run.numBits == 1) {
+        bool isReplayPending;
+        {
+          Lock lock(m_mutex);
+          isReplayPending = proxy.isReplayPending(run.base);
+        }
+        if (!isReplayPending) {
+          sendData(proxy, run.base, withHeartbeat);
+        }
+        continue;
+      }
+      // Packed into as few messages as the message size allows
+      uint32_t bit = 0;
+      SequenceNumber_t nextSN = run.base;
+      while (bit < run.numBits) {
+        bit = sendRequestedData(proxy, run, bit, nextSN, withHeartbeat);
+      }
+    }
+
+    if (withHeartbeat) {
+      Lock lock(m_mutex);
+      m_hbCount.value++;
     }
   }
-  ++m_nextSequenceNumberToSend;
 }
 
-template <typename NetworkDriver>
-bool StatefulWriterT<NetworkDriver>::isIrrelevant(ChangeKind_t kind) const {
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::isIrrelevant(
+    ChangeKind_t kind) const {
   // Right now we only allow alive changes
   // return kind == ChangeKind_t::INVALID || (m_topicKind == TopicKind_t::NO_KEY
   // && kind != ChangeKind_t::ALIVE);
   return kind != ChangeKind_t::ALIVE;
 }
 
-template <class NetworkDriver>
-void StatefulWriterT<NetworkDriver>::setAllChangesToUnsent() {
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::setFlowControl(
+    uint32_t bytesPerPeriod, uint32_t periodMs, uint32_t maxBurst) {
+  Lock lock(m_mutex);
+  m_flowController.configure(bytesPerPeriod, periodMs, maxBurst);
+}
+
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::admit(uint32_t size) {
+  if (m_flowController.tryConsume(size)) {
+    return true;
+  }
+  if (!m_flowDeferred) {
+    m_flowDeferred = true;
+    m_flowDeferredSize = size;
+    sys_sem_signal(&m_hbWakeup);
+  }
+  return false;
+}
+
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::setAllChangesToUnsent() {
   Lock lock(m_mutex);
 
   m_nextSequenceNumberToSend = m_history.getSeqNumMin();
@@ -192,13 +407,13 @@ void StatefulWriterT<NetworkDriver>::setAllChangesToUnsent() {
   }
 }
 
-template <class NetworkDriver>
-void StatefulWriterT<NetworkDriver>::onNewAckNack(
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::onNewAckNack(
     const SubmessageAckNack &msg, const GuidPrefix_t &sourceGuidPrefix) {
-  // Lock lock{m_mutex};
-  // Search for reader
+  // The view keeps reader valid even if it is removed meanwhile
   ReaderProxy *reader = nullptr;
-  for (auto &proxy : m_proxies) {
+  auto proxies = m_proxies.read();
+  for (auto &proxy : proxies) {
     if (proxy.remoteReaderGuid.prefix == sourceGuidPrefix &&
         proxy.remoteReaderGuid.entityId == msg.readerId) {
       reader = &proxy;
@@ -216,33 +431,28 @@ void StatefulWriterT<NetworkDriver>::onNewAckNack(
     return;
   }
 
-  uint8_t hash = 0;
-  for (int i = 0; i < sourceGuidPrefix.id.size(); i++) {
-    hash += sourceGuidPrefix.id.at(i);
-  }
-
-  char bfr[20];
-  size_t size = snprintf(bfr, sizeof(bfr), "%u <= %u", msg.count.value,
-                         reader->ackNackCount.value);
-  if (!(size < sizeof(bfr))) {
-    while (1)
-      ;
-  }
-
-  if (msg.count.value <= reader->ackNackCount.value) {
+  {
+    // Duplicates may arrive on several reader threads at once
+    Lock lock(m_mutex);
+    if (msg.count.value <= reader->ackNackCount.value) {
 #if SFW_VERBOSE
-    log("StatefulWriter[%s]: Count too small. Dropping acknack.\n",
-        &this->m_attributes.topicName[0]);
+      log("StatefulWriter[%s]: Count too small. Dropping acknack.\n",
+          &this->m_attributes.topicName[0]);
 #endif
-    return;
+      return;
+    }
+    reader->ackNackCount = msg.count;
+    reader->awaitingAckNack = false;
+    reader->isActive = true; // Anything missed meanwhile is requested here
+    if (reader->firstUnackedSN < msg.readerSNState.base) {
+      reader->firstUnackedSN = msg.readerSNState.base;
+      m_hbBackoffReset = true;
+    }
   }
 
-  reader->ackNackCount = msg.count;
-
   // Send missing packets
-  SequenceNumber_t nextSN = msg.readerSNState.base;
 #if SFW_VERBOSE
-  if (nextSN.low == 0 && nextSN.high == 0) {
+  if (msg.readerSNState.base.low == 0 && msg.readerSNState.base.high == 0) {
     log("StatefulWriter[%s]: Received preemptive acknack. Ignored.\n",
         &this->m_attributes.topicName[0]);
   } else {
@@ -250,30 +460,333 @@ void StatefulWriterT<NetworkDriver>::onNewAckNack(
         &this->m_attributes.topicName[0]);
   }
 #endif
-  for (uint32_t i = 0; i < msg.readerSNState.numBits; ++i, ++nextSN) {
-    if (msg.readerSNState.isSet(i)) {
+  {
+    Lock lock(m_mutex);
+    // A newer request replaces the one held back
+    reader->hasDeferredRequest = false;
+    if (!admit(getRequestedSize(msg.readerSNState))) {
+      reader->deferredRequest = msg.readerSNState;
+      reader->hasDeferredRequest = true;
+      return; // Resent by resumeDeferredSends
+    }
+  }
+
+  // New changes are pushed, so only the requested ones are resent here.
+  uint32_t bit = 0;
+  SequenceNumber_t nextSN = msg.readerSNState.base;
+  while (bit < msg.readerSNState.numBits) {
+    bit = sendRequestedData(*reader, msg.readerSNState, bit, nextSN);
+  }
+}
+
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::sendMulticastData(
+    ReaderProxyTable::View &proxies, const Locator &group,
+    const SequenceNumberSet &run, bool withHeartbeat) {
+  {
+    Lock lock(m_mutex);
+    for (const auto &proxy : proxies) {
+      if (proxy.multicastLocator == group && proxy.hasPendingReplay()) {
+        return false;
+      }
+    }
+  }
+  uint32_t bit = 0;
+  SequenceNumber_t sn = run.base;
+  while (bit < run.numBits) {
+    PacketInfo info;
+    info.srcPort = m_packetInfo.srcPort;
+    info.conn = m_packetInfo.conn;
+    info.destAddr = group.getIp4Address();
+    info.destPort = (Ip4Port_t)group.port;
+
+    MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
+    MessageFactory::addSubMessageDestination(info.buffer);
+    MessageFactory::addSubMessageTimeStamp(info.buffer);
+    const DataSize_t headerSize = info.buffer.spaceUsed();
+
+    SequenceNumber_t firstSN;
+    SequenceNumber_t lastSN;
+    Count_t hbCount;
+    {
+      Lock lock(m_mutex);
+      firstSN = m_history.getSeqNumMin();
+      lastSN = m_history.getSeqNumMax();
+      hbCount = m_hbCount;
+      // Room for the final HEARTBEATs
+      uint32_t heartbeatsSize = 0;
+      if (withHeartbeat) {
+        for (const auto &proxy : proxies) {
+          if (proxy.multicastLocator == group) {
+            heartbeatsSize += SubmessageInfoDst::getRawSize() +
+                              SubmessageHeartbeat::getRawSize();
+          }
+        }
+      }
+      for (; bit < run.numBits; ++bit, ++sn) {
+        const CacheChange *change = m_history.getChangeBySN(sn);
+        if (change == nullptr) {
+          continue; // Evicted meanwhile, repaired by a GAP on request
+        }
+        const uint32_t submsgSize =
+            SubmessageData::getRawSize() + change->data.spaceUsed() +
+            MessageFactory::getPadding(change->data.spaceUsed()) +
+            heartbeatsSize;
+        if (info.buffer.spaceUsed() != headerSize &&
+            info.buffer.spaceUsed() + submsgSize >
+                Config::SF_WRITER_MAX_MESSAGE_SIZE) {
+          break; // Continue with this one in the next message
+        }
+        MessageFactory::addSubMessageData(
+            info.buffer, change->data, false, change->sequenceNumber,
+            m_attributes.endpointGuid.entityId, ENTITYID_UNKNOWN, true);
+      }
+    }
+    if (withHeartbeat && bit >= run.numBits) {
+      // Each one behind an INFO_DST, so only the addressed reader answers
+      for (auto &proxy : proxies) {
+        if (!(proxy.multicastLocator == group)) {
+          continue;
+        }
+        MessageFactory::addSubMessageDestination(
+            info.buffer, proxy.remoteReaderGuid.prefix.id.data());
+        MessageFactory::addHeartbeat(
+            info.buffer, m_attributes.endpointGuid.entityId,
+            proxy.remoteReaderGuid.entityId, firstSN, lastSN, hbCount, true);
+      }
+    }
+
+    if (info.buffer.spaceUsed() != headerSize) {
+      m_transport->sendPacket(info);
+    }
+  }
+  return true;
+}
+
+template <class NetworkDriver, class History>
+uint32_t StatefulWriterT<NetworkDriver, History>::getRequestedSize(
+    const SequenceNumberSet &requested) {
+  uint32_t size = 0;
+  SequenceNumber_t sn = requested.base;
+  for (uint32_t bit = 0; bit < requested.numBits; ++bit, ++sn) {
+    const CacheChange *change;
+    if (requested.isSet(bit) &&
+        (change = m_history.getChangeBySN(sn)) != nullptr) {
+      size += SubmessageData::getRawSize() + change->data.spaceUsed();
+    }
+  }
+  return size;
+}
+
+template <class NetworkDriver, class History>
+uint32_t StatefulWriterT<NetworkDriver, History>::sendRequestedData(
+    const ReaderProxy &reader, const SequenceNumberSet &requested,
+    uint32_t bit, SequenceNumber_t &nextSN, bool withHeartbeat) {
+  PacketInfo info;
+  info.srcPort = m_packetInfo.srcPort;
+  info.conn = m_packetInfo.conn;
+  info.destAddr = reader.remoteLocator.getIp4Address();
+  info.destPort = (Ip4Port_t)reader.remoteLocator.port;
+
+  MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
+  MessageFactory::addSubMessageDestination(info.buffer);
+  MessageFactory::addSubMessageTimeStamp(info.buffer);
+  const DataSize_t headerSize = info.buffer.spaceUsed();
+  // Too large to share a message, sent as DATA_FRAG afterwards
+  SequenceNumber_t fragmentedSN = SEQUENCENUMBER_UNKNOWN;
+
+  {
+    Lock lock(m_mutex);
+    const SequenceNumber_t minSN = m_history.getSeqNumMin();
+    if (minSN != SEQUENCENUMBER_UNKNOWN && nextSN < minSN) {
+      // Evicted already. Tell the reader instead of leaving it to ask forever.
+      SequenceNumberSet gapList(minSN);
+      gapList.numBits = 0;
+      MessageFactory::addGap(info.buffer, m_attributes.endpointGuid.entityId,
+                             reader.remoteReaderGuid.entityId, nextSN,
+                             gapList);
+      while (nextSN < minSN && bit < requested.numBits) {
+        ++bit;
+        ++nextSN;
+      }
+    }
+    for (; bit < requested.numBits; ++bit, ++nextSN) {
+      // Samples still owed by the late-joiner replay go out in order there
+      if (!requested.isSet(bit) || reader.isReplayPending(nextSN)) {
+        continue;
+      }
+      const CacheChange *change = m_history.getChangeBySN(nextSN);
+      if (change == nullptr) {
+#if SFW_VERBOSE
+        log("StatefulWriter[%s]: Couldn't get a CacheChange with SN (%i,%u)\n",
+            &this->m_attributes.topicName[0], nextSN.high, nextSN.low);
+#endif
+        continue;
+      }
+      if (change->data.spaceUsed() > Config::FRAGMENT_SIZE) {
+        if (info.buffer.spaceUsed() == headerSize) {
+          fragmentedSN = nextSN;
+          ++bit;
+          ++nextSN;
+        }
+        break; // Sent on its own
+      }
+      // Padded as more may follow, room is left for the final HEARTBEAT
+      const uint32_t submsgSize =
+          SubmessageData::getRawSize() + change->data.spaceUsed() +
+          MessageFactory::getPadding(change->data.spaceUsed()) +
+          (withHeartbeat ? SubmessageHeartbeat::getRawSize() : 0);
+      if (info.buffer.spaceUsed() != headerSize &&
+          info.buffer.spaceUsed() + submsgSize >
+              Config::SF_WRITER_MAX_MESSAGE_SIZE) {
+        break; // Continue with this one in the next message
+      }
 #if SFW_VERBOSE
       log("StatefulWriter[%s]: Send Packet on acknack.\n",
           this->m_attributes.topicName);
 #endif
-      sendData(*reader, nextSN);
+      MessageFactory::addSubMessageData(
+          info.buffer, change->data, false, change->sequenceNumber,
+          m_attributes.endpointGuid.entityId, reader.remoteReaderGuid.entityId,
+          true);
+    }
+    const bool isLast = bit >= requested.numBits;
+    if (withHeartbeat && isLast && fragmentedSN == SEQUENCENUMBER_UNKNOWN &&
+        info.buffer.spaceUsed() != headerSize) {
+      MessageFactory::addHeartbeat(
+          info.buffer, m_attributes.endpointGuid.entityId,
+          reader.remoteReaderGuid.entityId, m_history.getSeqNumMin(),
+          m_history.getSeqNumMax(), m_hbCount, true);
+    }
+  }
+
+  if (info.buffer.spaceUsed() != headerSize) {
+    m_transport->sendPacket(info);
+  }
+  if (fragmentedSN != SEQUENCENUMBER_UNKNOWN) {
+    sendData(reader, fragmentedSN,
+             withHeartbeat && bit >= requested.numBits);
+  }
+  return bit;
+}
+
+template <class NetworkDriver, class History>
+rtps::FragmentNumberSet
+StatefulWriterT<NetworkDriver, History>::allFragmentsOf(DataSize_t size) {
+  static_assert((0xFFFF + Config::FRAGMENT_SIZE - 1) / Config::FRAGMENT_SIZE <=
+                    FNS_NUM_BITS,
+                "FRAGMENT_SIZE too small to number all fragments");
+  FragmentNumberSet fragments;
+  fragments.numBits =
+      (size + Config::FRAGMENT_SIZE - 1) / Config::FRAGMENT_SIZE;
+  for (uint32_t bit = 0; bit < fragments.numBits; ++bit) {
+    fragments.set(bit);
+  }
+  return fragments;
+}
+
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::sendFragments(
+    const ReaderProxy &reader, const SequenceNumber_t &sn,
+    const FragmentNumberSet &fragments, bool withHeartbeat) {
+  static_assert(Header::getRawSize() + SubmessageInfoDst::getRawSize() +
+                        SubmessageInfoTs::getRawSize() +
+                        SubmessageDataFrag::getRawSize() +
+                        Config::FRAGMENT_SIZE +
+                        SubmessageHeartbeat::getRawSize() <=
+                    Config::SF_WRITER_MAX_MESSAGE_SIZE,
+                "DATA_FRAG messages exceed SF_WRITER_MAX_MESSAGE_SIZE");
+  // Last requested one carries the heartbeat
+  uint32_t lastBit = 0;
+  for (uint32_t bit = 0; bit < fragments.numBits; ++bit) {
+    if (fragments.isSet(bit)) {
+      lastBit = bit;
+    }
+  }
+
+  for (uint32_t bit = 0; bit < fragments.numBits; ++bit) {
+    if (!fragments.isSet(bit)) {
+      continue;
+    }
+    PacketInfo info;
+    info.srcPort = m_packetInfo.srcPort;
+    info.conn = m_packetInfo.conn;
+    info.destAddr = reader.remoteLocator.getIp4Address();
+    info.destPort = (Ip4Port_t)reader.remoteLocator.port;
+
+    MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
+    MessageFactory::addSubMessageDestination(info.buffer);
+    MessageFactory::addSubMessageTimeStamp(info.buffer);
+    {
+      Lock lock(m_mutex);
+      const CacheChange *change = m_history.getChangeBySN(sn);
+      if (change == nullptr) {
+        return false;
+      }
+      const uint32_t fragmentNum = fragments.base.value + bit;
+      if ((fragmentNum - 1) * Config::FRAGMENT_SIZE >=
+          change->data.spaceUsed()) {
+        break;
+      }
+      MessageFactory::addSubMessageDataFrag(
+          info.buffer, change->data, fragmentNum, Config::FRAGMENT_SIZE, sn,
+          m_attributes.endpointGuid.entityId, reader.remoteReaderGuid.entityId);
+      if (withHeartbeat && bit == lastBit) {
+        MessageFactory::addHeartbeat(
+            info.buffer, m_attributes.endpointGuid.entityId,
+            reader.remoteReaderGuid.entityId, m_history.getSeqNumMin(),
+            m_history.getSeqNumMax(), m_hbCount, true);
+      }
+    }
+    m_transport->sendPacket(info);
+  }
+  return true;
+}
+
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::onNewNackFrag(
+    const SubmessageNackFrag &msg, const GuidPrefix_t &sourceGuidPrefix) {
+  ReaderProxy *reader = nullptr;
+  auto proxies = m_proxies.read();
+  for (auto &proxy : proxies) {
+    if (proxy.remoteReaderGuid.prefix == sourceGuidPrefix &&
+        proxy.remoteReaderGuid.entityId == msg.readerId) {
+      reader = &proxy;
+      break;
+    }
+  }
+  if (reader == nullptr || msg.fragmentNumberState.base.value == 0) {
+#if SFW_VERBOSE
+    log("StatefulWriter[%s]: Dropping nackfrag.\n",
+        &this->m_attributes.topicName[0]);
+#endif
+    return; // Fragment numbers start at 1
+  }
+  uint32_t numRequested = 0;
+  for (uint32_t bit = 0; bit < msg.fragmentNumberState.numBits; ++bit) {
+    if (msg.fragmentNumberState.isSet(bit)) {
+      ++numRequested;
     }
   }
-  // Check for sequence numbers after defined range
-  SequenceNumber_t maxSN;
   {
     Lock lock(m_mutex);
-    maxSN = m_history.getSeqNumMax();
-  }
-  while (nextSN <= maxSN) {
-    sendData(*reader, nextSN);
-    ++nextSN;
+    if (msg.count.value <= reader->nackFragCount.value) {
+      return;
+    }
+    reader->nackFragCount = msg.count;
+    if (!admit(numRequested * (SubmessageDataFrag::getRawSize() +
+                               Config::FRAGMENT_SIZE))) {
+      return; // Requested again after a heartbeat
+    }
   }
+
+  sendFragments(*reader, msg.writerSN, msg.fragmentNumberState, false);
 }
 
-template <class NetworkDriver>
-bool StatefulWriterT<NetworkDriver>::sendData(
-    const ReaderProxy &reader, const SequenceNumber_t &snMissing) {
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::sendData(
+    const ReaderProxy &reader, const SequenceNumber_t &snMissing,
+    bool withHeartbeat) {
 
   // TODO smarter packaging e.g. by creating MessageStruct and serialize after
   // adjusting values Reusing the pbuf is not possible. See
@@ -281,6 +794,7 @@ bool StatefulWriterT<NetworkDriver>::sendData(
 
   PacketInfo info;
   info.srcPort = m_packetInfo.srcPort;
+  info.conn = m_packetInfo.conn;
 
   MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
   MessageFactory::addSubMessageDestination(info.buffer);
@@ -292,6 +806,7 @@ bool StatefulWriterT<NetworkDriver>::sendData(
   info.destAddr = locator.getIp4Address();
   info.destPort = (Ip4Port_t)locator.port;
 
+  FragmentNumberSet fragments;
   {
     Lock lock(m_mutex);
     const CacheChange *next = m_history.getChangeBySN(snMissing);
@@ -302,31 +817,248 @@ bool StatefulWriterT<NetworkDriver>::sendData(
 #endif
       return false;
     }
-    MessageFactory::addSubMessageData(
-        info.buffer, next->data, false, next->sequenceNumber,
-        m_attributes.endpointGuid.entityId, reader.remoteReaderGuid.entityId);
+    if (next->data.spaceUsed() > Config::FRAGMENT_SIZE) {
+      fragments = allFragmentsOf(next->data.spaceUsed());
+    } else {
+      MessageFactory::addSubMessageData(
+          info.buffer, next->data, false, next->sequenceNumber,
+          m_attributes.endpointGuid.entityId, reader.remoteReaderGuid.entityId,
+          withHeartbeat || History::PAYLOADS_IN_PLACE);
+      if (withHeartbeat) {
+        // Final, so the reader only answers if it misses something
+        MessageFactory::addHeartbeat(
+            info.buffer, m_attributes.endpointGuid.entityId,
+            reader.remoteReaderGuid.entityId, m_history.getSeqNumMin(),
+            m_history.getSeqNumMax(), m_hbCount, true);
+      }
+    }
+  }
+  if (fragments.numBits != 0) {
+    return sendFragments(reader, snMissing, fragments, withHeartbeat);
   }
 
   m_transport->sendPacket(info);
   return true;
 }
 
-template <class NetworkDriver>
-void StatefulWriterT<NetworkDriver>::hbFunctionJumppad(void *thisPointer) {
-  auto *writer = static_cast<StatefulWriterT<NetworkDriver> *>(thisPointer);
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::hbFunctionJumppad(
+    void *thisPointer) {
+  auto *writer =
+      static_cast<StatefulWriterT<NetworkDriver, History> *>(thisPointer);
   writer->sendHeartBeatLoop();
 }
 
-template <class NetworkDriver>
-void StatefulWriterT<NetworkDriver>::sendHeartBeatLoop() {
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::sendReplayBurst() {
+  bool pending = false;
+  for (auto &proxy : m_proxies.read()) {
+    for (uint8_t i = 0; i < Config::DURABILITY_REPLAY_BURST_SIZE; ++i) {
+      SequenceNumber_t sn;
+      {
+        Lock lock(m_mutex);
+        // Skip whatever was evicted since the reader matched
+        const SequenceNumber_t minSN = m_history.getSeqNumMin();
+        if (minSN == SEQUENCENUMBER_UNKNOWN) {
+          proxy.replayNextSN = proxy.replayEndSN;
+        } else if (proxy.replayNextSN < minSN) {
+          proxy.replayNextSN = minSN;
+        }
+        if (!proxy.hasPendingReplay()) {
+          break;
+        }
+        const CacheChange *change = m_history.getChangeBySN(proxy.replayNextSN);
+        if (change != nullptr &&
+            !admit(SubmessageData::getRawSize() + change->data.spaceUsed())) {
+          break;
+        }
+        sn = proxy.replayNextSN;
+        ++proxy.replayNextSN;
+      }
+      sendData(proxy, sn);
+    }
+    Lock lock(m_mutex);
+    pending = pending || proxy.hasPendingReplay();
+  }
+  return pending;
+}
+
+template <class NetworkDriver, class History>
+bool StatefulWriterT<NetworkDriver, History>::hasUnackedChanges() {
+  Lock lock(m_mutex);
+  const SequenceNumber_t lastSN = m_history.getSeqNumMax();
+  for (const auto &proxy : m_proxies.read()) {
+    if (proxy.isActive && proxy.hasUnacked(lastSN)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class NetworkDriver, class History>
+uint32_t StatefulWriterT<NetworkDriver, History>::checkReaderLiveness(
+    bool &anyInactive) {
+  uint32_t nextDueMs = 0;
+  anyInactive = false;
+  if (Config::SF_WRITER_READER_INACTIVE_MS == 0) {
+    return 0;
+  }
+  Lock lock(m_mutex);
+  const uint32_t nowMs = sys_now();
+  for (auto &proxy : m_proxies.read()) {
+    if (!proxy.isActive) {
+      anyInactive = true;
+      continue;
+    }
+    if (!proxy.awaitingAckNack) {
+      continue;
+    }
+    const uint32_t silentMs = nowMs - proxy.awaitingSinceMs;
+    if (silentMs >= Config::SF_WRITER_READER_INACTIVE_MS) {
+#if SFW_VERBOSE
+      log("StatefulWriter[%s]: Reader stopped answering, demoting it.\n",
+          &this->m_attributes.topicName[0]);
+#endif
+      // Removed with its participant once the SPDP lease expires
+      proxy.isActive = false;
+      anyInactive = true;
+      continue;
+    }
+    const uint32_t dueMs = Config::SF_WRITER_READER_INACTIVE_MS - silentMs;
+    if (nextDueMs == 0 || dueMs < nextDueMs) {
+      nextDueMs = dueMs;
+    }
+  }
+  return nextDueMs;
+}
+
+template <class NetworkDriver, class History>
+uint32_t StatefulWriterT<NetworkDriver, History>::resumeDeferredSends() {
+  {
+    Lock lock(m_mutex);
+    if (!m_flowDeferred) {
+      return 0;
+    }
+    const uint32_t waitMs = m_flowController.getWaitMs(m_flowDeferredSize);
+    if (waitMs != 0) {
+      return waitMs;
+    }
+    m_flowDeferred = false;
+  }
+  sendDeferredRequests();
+  // Pushing continues in the thread pool. Readers ask again for the pushed
+  // changes that were held back.
+  if (mp_threadPool != nullptr) {
+    mp_threadPool->addWorkload(this);
+  }
+  sendHeartBeat(HeartbeatTargets::UNACKED);
+  return 0;
+}
+
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::sendDeferredRequests() {
+  auto proxies = m_proxies.read();
+  for (auto &proxy : proxies) {
+    SequenceNumberSet requested;
+    {
+      Lock lock(m_mutex);
+      if (!proxy.hasDeferredRequest) {
+        continue;
+      }
+      if (!admit(getRequestedSize(proxy.deferredRequest))) {
+        return; // Deferred again, the rest follows later
+      }
+      requested = proxy.deferredRequest;
+      proxy.hasDeferredRequest = false;
+    }
+    uint32_t bit = 0;
+    SequenceNumber_t nextSN = requested.base;
+    while (bit < requested.numBits) {
+      bit = sendRequestedData(proxy, requested, bit, nextSN);
+    }
+  }
+}
+
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::sendHeartBeatLoop() {
+  uint32_t lastHbMs = sys_now();
+  uint32_t lastInactiveHbMs = lastHbMs;
+  uint32_t backoffMs = Config::SF_WRITER_HB_FAST_PERIOD_MS;
+  bool wasUnacked = false;
   while (m_running) {
-    sendHeartBeat();
-    sys_msleep(Config::SF_WRITER_HB_PERIOD_MS);
+    const uint32_t flowWaitMs = resumeDeferredSends();
+    bool anyInactive;
+    const uint32_t livenessWaitMs = checkReaderLiveness(anyInactive);
+    const bool replayPending = sendReplayBurst();
+
+    const bool unacked = hasUnackedChanges();
+    {
+      Lock lock(m_mutex);
+      if (unacked && (!wasUnacked || m_hbBackoffReset)) {
+        // Fresh data or progress by a reader: repair fast again
+        backoffMs = Config::SF_WRITER_HB_FAST_PERIOD_MS;
+        if (!wasUnacked) {
+          lastHbMs = sys_now();
+        }
+      }
+      m_hbBackoffReset = false;
+      m_hbIdle = !unacked;
+    }
+    wasUnacked = unacked;
+
+    const uint32_t periodMs =
+        unacked ? backoffMs : Config::SF_WRITER_HB_IDLE_PERIOD_MS;
+    uint32_t sinceHbMs = sys_now() - lastHbMs;
+    if (periodMs != 0 && sinceHbMs >= periodMs) {
+      sendHeartBeat(unacked ? HeartbeatTargets::UNACKED
+                            : HeartbeatTargets::ALL);
+      lastHbMs = sys_now();
+      if (!unacked) {
+        lastInactiveHbMs = lastHbMs;
+      }
+      sinceHbMs = 0;
+      if (unacked && backoffMs < Config::SF_WRITER_HB_PERIOD_MS) {
+        backoffMs = backoffMs * 2 < Config::SF_WRITER_HB_PERIOD_MS
+                        ? backoffMs * 2
+                        : Config::SF_WRITER_HB_PERIOD_MS;
+      }
+    }
+
+    // 0 waits until woken up by new data or a new reader
+    uint32_t timeoutMs = periodMs == 0 ? 0 : periodMs - sinceHbMs;
+    if (replayPending && (timeoutMs == 0 || Config::DURABILITY_REPLAY_PERIOD_MS <
+                                                timeoutMs)) {
+      timeoutMs = Config::DURABILITY_REPLAY_PERIOD_MS;
+    }
+    if (flowWaitMs != 0 && (timeoutMs == 0 || flowWaitMs < timeoutMs)) {
+      timeoutMs = flowWaitMs;
+    }
+    if (livenessWaitMs != 0 &&
+        (timeoutMs == 0 || livenessWaitMs < timeoutMs)) {
+      timeoutMs = livenessWaitMs;
+    }
+    // Inactive readers get no data but keep being asked at the slow period,
+    // so they come back as soon as they answer again
+    if (anyInactive) {
+      uint32_t inactiveWaitMs = Config::SF_WRITER_HB_PERIOD_MS;
+      const uint32_t sinceInactiveHbMs = sys_now() - lastInactiveHbMs;
+      if (sinceInactiveHbMs >= Config::SF_WRITER_HB_PERIOD_MS) {
+        sendHeartBeat(HeartbeatTargets::INACTIVE);
+        lastInactiveHbMs = sys_now();
+      } else {
+        inactiveWaitMs -= sinceInactiveHbMs;
+      }
+      if (timeoutMs == 0 || inactiveWaitMs < timeoutMs) {
+        timeoutMs = inactiveWaitMs;
+      }
+    }
+    sys_arch_sem_wait(&m_hbWakeup, timeoutMs);
   }
 }
 
-template <class NetworkDriver>
-void StatefulWriterT<NetworkDriver>::sendHeartBeat() {
+template <class NetworkDriver, class History>
+void StatefulWriterT<NetworkDriver, History>::sendHeartBeat(
+    HeartbeatTargets targets) {
   if (m_proxies.isEmpty()) {
 #if SFW_VERBOSE
     log("StatefulWriter[%s]: Skipping heartbeat. No proxies.\n",
@@ -335,18 +1067,37 @@ void StatefulWriterT<NetworkDriver>::sendHeartBeat() {
     return;
   }
 
-  for (auto &proxy : m_proxies) {
+  // All heartbeats of a round go out under one tcpip core lock
+  std::array<PacketInfo, Config::NUM_READER_PROXIES_PER_WRITER> packets;
+  uint8_t numPackets = 0;
+  for (auto &proxy : m_proxies.read()) {
 
     PacketInfo info;
     info.srcPort = m_packetInfo.srcPort;
+    info.conn = m_packetInfo.conn;
 
     SequenceNumber_t firstSN;
     SequenceNumber_t lastSN;
+    Count_t hbCount;
+    bool isAcked;
     MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
     {
       Lock lock(m_mutex);
       firstSN = m_history.getSeqNumMin();
       lastSN = m_history.getSeqNumMax();
+      hbCount = m_hbCount;
+      isAcked = !proxy.hasUnacked(lastSN);
+      if (targets == HeartbeatTargets::UNACKED &&
+          (isAcked || !proxy.isActive)) {
+        continue;
+      }
+      if (targets == HeartbeatTargets::INACTIVE && proxy.isActive) {
+        continue;
+      }
+      if (!proxy.awaitingAckNack && firstSN != SEQUENCENUMBER_UNKNOWN) {
+        proxy.awaitingAckNack = true;
+        proxy.awaitingSinceMs = sys_now();
+      }
     }
     if (firstSN == SEQUENCENUMBER_UNKNOWN || lastSN == SEQUENCENUMBER_UNKNOWN) {
 #if SFW_VERBOSE
@@ -360,13 +1111,16 @@ void StatefulWriterT<NetworkDriver>::sendHeartBeat() {
     MessageFactory::addSubMessageDestination(info.buffer, proxy.remoteReaderGuid.prefix.id.data());
     MessageFactory::addHeartbeat(
         info.buffer, m_attributes.endpointGuid.entityId,
-        proxy.remoteReaderGuid.entityId, firstSN, lastSN, m_hbCount);
+        proxy.remoteReaderGuid.entityId, firstSN, lastSN, hbCount);
 
     info.destAddr = proxy.remoteLocator.getIp4Address();
     info.destPort = proxy.remoteLocator.port;
 
-    m_transport->sendPacket(info);
+    packets[numPackets++] = std::move(info);
   }
+  m_transport->sendPackets(packets.data(), numPackets);
+  // progress() counts its piggybacked heartbeats concurrently
+  Lock lock(m_mutex);
   m_hbCount.value++;
 }
 
@@ -33,15 +33,16 @@ class StatelessReader final : public Reader {
 public:
   void init(const TopicData &attributes);
   void newChange(const ReaderCacheChange &cacheChange) override;
-  void registerCallback(ddsReaderCallback_fp cb, void *callee) override;
   bool onNewHeartbeat(const SubmessageHeartbeat &msg,
                       const GuidPrefix_t &remotePrefix) override;
+  bool onNewGap(const SubmessageGap &msg,
+                const GuidPrefix_t &remotePrefix) override;
+  void onNewDataFrag(const SubmessageDataFrag &msg,
+                     const GuidPrefix_t &remotePrefix, const uint8_t *data,
+                     DataSize_t size) override;
   bool addNewMatchedWriter(const WriterProxy &newProxy) override;
   void removeWriter(const Guid &guid) override;
-
-private:
-  ddsReaderCallback_fp m_callback = nullptr;
-  void *m_callee = nullptr;
+  void removeWriterOfParticipant(const GuidPrefix_t &guidPrefix) override;
 };
 
 } // namespace rtps
@@ -29,8 +29,9 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/common/types.h"
 #include "rtps/config.h"
 #include "rtps/entities/Writer.h"
-#include "rtps/storages/MemoryPool.h"
+#include "rtps/storages/ProxyTable.h"
 #include "rtps/storages/SimpleHistoryCache.h"
+#include "rtps/utils/FlowController.h"
 
 namespace rtps {
 
@@ -44,12 +45,19 @@ public:
 
   bool addNewMatchedReader(const ReaderProxy &newProxy) override;
   void removeReader(const Guid &guid) override;
+  void removeReaderOfParticipant(const GuidPrefix_t &guidPrefix) override;
   void progress() override;
   const CacheChange *newChange(ChangeKind_t kind, const uint8_t *data,
                                DataSize_t size) override;
+  uint32_t newChanges(ChangeKind_t kind, const Sample *samples,
+                      uint32_t count) override;
   void setAllChangesToUnsent() override;
   void onNewAckNack(const SubmessageAckNack &msg,
                     const GuidPrefix_t &sourceGuidPrefix) override;
+  void onNewNackFrag(const SubmessageNackFrag &msg,
+                     const GuidPrefix_t &sourceGuidPrefix) override;
+  void setFlowControl(uint32_t bytesPerPeriod, uint32_t periodMs,
+                      uint32_t maxBurst) override;
 
 private:
   sys_mutex_t m_mutex;
@@ -61,9 +69,19 @@ private:
   TopicKind_t m_topicKind = TopicKind_t::NO_KEY;
   SequenceNumber_t m_nextSequenceNumberToSend = {0, 1};
   SimpleHistoryCache m_history;
-
-  MemoryPool<ReaderProxy, Config::NUM_READER_PROXIES_PER_WRITER> m_proxies;
-
+  FlowController m_flowController;
+
+  ProxyTable<ReaderProxy, Config::NUM_READER_PROXIES_PER_WRITER> m_proxies;
+
+  bool sendData(const ReaderProxy &reader, const SequenceNumber_t &sn);
+  //! Builds the message of sendData() without sending it
+  bool createData(const Locator &locator, const EntityId_t &readerId,
+                  const SequenceNumber_t &sn, PacketInfo &info);
+  //! Sets waitMs if the flow controller stopped the burst
+  bool sendReplayBurst(uint32_t &waitMs);
+  //! Takes size bytes from the flow controller. Returns 0 if they may be sent
+  //! now, otherwise the time until they are available. Requires m_mutex.
+  uint32_t consumeTokens(uint32_t size);
   bool isIrrelevant(ChangeKind_t kind) const;
 };
 
@@ -32,6 +32,8 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/utils/Log.h"
 #include "rtps/utils/udpUtils.h"
 
+#include <array>
+
 using rtps::CacheChange;
 using rtps::SequenceNumber_t;
 using rtps::StatelessWriterT;
@@ -63,9 +65,13 @@ bool StatelessWriterT<NetworkDriver>::init(TopicData attributes,
 
   m_attributes = attributes;
   m_packetInfo.srcPort = attributes.unicastLocator.port;
+  m_packetInfo.conn = driver.createUdpConnection(m_packetInfo.srcPort);
   m_topicKind = topicKind;
   mp_threadPool = threadPool;
   m_transport = &driver;
+  m_flowController.configure(Config::FLOW_CONTROL_BYTES_PER_PERIOD,
+                             Config::FLOW_CONTROL_PERIOD_MS,
+                             Config::FLOW_CONTROL_MAX_BURST);
 
   m_is_initialized_ = true;
   return true;
@@ -80,7 +86,28 @@ bool StatelessWriterT<NetworkDriver>::addNewMatchedReader(
   printGuid(newProxy.remoteReaderGuid);
   printf("\n");
 #endif
-  return m_proxies.add(newProxy);
+  if (m_attributes.durabilityKind < DurabilityKind_t::TRANSIENT_LOCAL ||
+      newProxy.durabilityKind < DurabilityKind_t::TRANSIENT_LOCAL) {
+    return m_proxies.add(newProxy);
+  }
+
+  // Only the late joiner gets the retained history, everything from
+  // m_nextSequenceNumberToSend on reaches it through the regular path.
+  ReaderProxy proxy = newProxy;
+  {
+    Lock lock(m_mutex);
+    if (m_history.getSeqNumMin() != SEQUENCENUMBER_UNKNOWN) {
+      proxy.replayNextSN = m_history.getSeqNumMin();
+      proxy.replayEndSN = m_nextSequenceNumberToSend;
+    }
+    if (!m_proxies.add(proxy)) {
+      return false;
+    }
+  }
+  if (proxy.hasPendingReplay() && mp_threadPool != nullptr) {
+    mp_threadPool->addWorkload(this);
+  }
+  return true;
 }
 
 template <class NetworkDriver>
@@ -95,6 +122,20 @@ void StatelessWriterT<NetworkDriver>::removeReader(const Guid &guid) {
   m_proxies.remove(thunk, &isElementToRemove);
 }
 
+template <typename NetworkDriver>
+void StatelessWriterT<NetworkDriver>::removeReaderOfParticipant(
+    const GuidPrefix_t &guidPrefix) {
+  auto isElementToRemove = [&](const ReaderProxy &proxy) {
+    return proxy.remoteReaderGuid.prefix == guidPrefix;
+  };
+  auto thunk = [](void *arg, const ReaderProxy &value) {
+    return (*static_cast<decltype(isElementToRemove) *>(arg))(value);
+  };
+
+  while (m_proxies.remove(thunk, &isElementToRemove)) {
+  }
+}
+
 template <typename NetworkDriver>
 const CacheChange *StatelessWriterT<NetworkDriver>::newChange(
     rtps::ChangeKind_t kind, const uint8_t *data, DataSize_t size) {
@@ -123,6 +164,30 @@ const CacheChange *StatelessWriterT<NetworkDriver>::newChange(
   return result;
 }
 
+template <typename NetworkDriver>
+uint32_t StatelessWriterT<NetworkDriver>::newChanges(rtps::ChangeKind_t kind,
+                                                     const Sample *samples,
+                                                     uint32_t count) {
+  if (isIrrelevant(kind)) {
+    return 0;
+  }
+  uint32_t added = 0;
+  {
+    Lock lock(m_mutex);
+    for (; added < count; ++added) {
+      if (m_history.isFull() &&
+          !(m_history.getSeqNumMin() < m_nextSequenceNumberToSend)) {
+        break; // Would drop a change before it was sent
+      }
+      m_history.addChange(samples[added].data, samples[added].size);
+    }
+  }
+  if (added != 0 && mp_threadPool != nullptr) {
+    mp_threadPool->addWorkload(this);
+  }
+  return added;
+}
+
 template <typename NetworkDriver>
 void StatelessWriterT<NetworkDriver>::setAllChangesToUnsent() {
   Lock lock(m_mutex);
@@ -140,6 +205,29 @@ void StatelessWriterT<NetworkDriver>::onNewAckNack(
   // Too lazy to respond
 }
 
+template <typename NetworkDriver>
+void StatelessWriterT<NetworkDriver>::onNewNackFrag(
+    const SubmessageNackFrag & /*msg*/,
+    const GuidPrefix_t & /*sourceGuidPrefix*/) {
+  // Best effort, nothing to repair
+}
+
+template <typename NetworkDriver>
+void StatelessWriterT<NetworkDriver>::setFlowControl(uint32_t bytesPerPeriod,
+                                                     uint32_t periodMs,
+                                                     uint32_t maxBurst) {
+  Lock lock(m_mutex);
+  m_flowController.configure(bytesPerPeriod, periodMs, maxBurst);
+}
+
+template <typename NetworkDriver>
+uint32_t StatelessWriterT<NetworkDriver>::consumeTokens(uint32_t size) {
+  if (m_flowController.tryConsume(size)) {
+    return 0;
+  }
+  return m_flowController.getWaitMs(size);
+}
+
 template <typename NetworkDriver>
 bool StatelessWriterT<NetworkDriver>::isIrrelevant(ChangeKind_t kind) const {
   // Right now we only allow alive changes
@@ -154,60 +242,191 @@ void StatelessWriterT<NetworkDriver>::progress() {
   // adjusting values Reusing the pbuf is not possible. See
   // https://www.nongnu.org/lwip/2_1_x/raw_api.html (Zero-Copy MACs)
 
-  for (const auto &proxy : m_proxies) {
-
 #if SLW_VERBOSE
-    printf("StatelessWriter[%s]: Progess.\n", this->m_attributes.topicName);
+  printf("StatelessWriter[%s]: Progess.\n", this->m_attributes.topicName);
 #endif
 
-    PacketInfo info;
-    info.srcPort = m_packetInfo.srcPort;
-
-    MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
-    //MessageFactory::addSubMessageTimeStamp(info.buffer);
-
+  // Throttled sends are requeued rather than waited for, the worker thread is
+  // shared with the other writers
+  uint32_t waitMs = 0;
+  const bool replayPending = sendReplayBurst(waitMs);
+
+  // Send everything that is not sent yet, a batch is scheduled only once.
+  // Stopping at the last change present now and advancing after sending
+  // absorbs a setAllChangesToUnsent() meanwhile, e.g. SPDP answering an
+  // already known participant.
+  SequenceNumber_t lastSN;
+  {
+    Lock lock(m_mutex);
+    lastSN = m_history.getSeqNumMax();
+  }
+  while (waitMs == 0) {
+    SequenceNumber_t snToSend;
+    auto proxies = m_proxies.read();
+    Locator group;
     {
       Lock lock(m_mutex);
-      const CacheChange *next =
-          m_history.getChangeBySN(m_nextSequenceNumberToSend);
-      if (next == nullptr) {
+      snToSend = m_nextSequenceNumberToSend;
+      const CacheChange *change = m_history.getChangeBySN(snToSend);
+      if (change == nullptr) {
 #if SLW_VERBOSE
         printf("StatelessWriter[%s]: Couldn't get a new CacheChange with SN "
                "(%i,%i)\n",
-               &m_attributes.topicName[0], m_nextSequenceNumberToSend.high,
-               m_nextSequenceNumberToSend.low);
-#endif
-        return;
-      } else {
-#if SLW_VERBOSE
-        printf("StatelessWriter[%s]: Sending change with SN (%i,%i)\n",
-               &m_attributes.topicName[0], m_nextSequenceNumberToSend.high,
-               m_nextSequenceNumberToSend.low);
+               &m_attributes.topicName[0], snToSend.high, snToSend.low);
 #endif
+        break;
+      }
+      group = getSharedMulticastLocator(proxies);
+      uint32_t numDatagrams = group.isValid() ? 1 : 0;
+      for (const auto &proxy : proxies) {
+        const bool isMember =
+            group.isValid() && proxy.multicastLocator == group;
+        numDatagrams += isMember ? 0 : 1;
+      }
+      // A sample goes out to all readers or waits for the flow controller
+      waitMs = consumeTokens(numDatagrams * (SubmessageData::getRawSize() +
+                                             change->data.spaceUsed()));
+      if (waitMs != 0) {
+        break;
+      }
+    }
+    // One multicast message for the readers sharing a group and one message
+    // per remaining reader, all sent under one tcpip core lock
+    std::array<PacketInfo, Config::NUM_READER_PROXIES_PER_WRITER> packets;
+    uint8_t numPackets = 0;
+    if (group.isValid()) {
+      PacketInfo info;
+      if (createData(group, ENTITYID_UNKNOWN, snToSend, info)) {
+        packets[numPackets++] = std::move(info);
       }
-      //TODO: these should be called only when the message data is published.
-      char hoge[2];
-      pbuf_copy_partial(next->data.firstElement, &hoge, 2,0);
-      if(hoge[0] != 0 || hoge[1] != 3) {
-        MessageFactory::addSubMessageDestination(info.buffer);
-        //next->data = next->data[1];
-        //next->size - next->size - 1;
+    }
+    for (const auto &proxy : proxies) {
+      if (group.isValid() && proxy.multicastLocator == group) {
+        continue;
+      }
+      PacketInfo info;
+      if (createData(proxy.remoteLocator, proxy.remoteReaderGuid.entityId,
+                     snToSend, info)) {
+        packets[numPackets++] = std::move(info);
       }
-      MessageFactory::addSubMessageTimeStamp(info.buffer);
-      MessageFactory::addSubMessageData(
-          info.buffer, next->data, false, next->sequenceNumber,
-          m_attributes.endpointGuid.entityId,
-          proxy.remoteReaderGuid.entityId); // TODO
     }
+    m_transport->sendPackets(packets.data(), numPackets);
+    Lock lock(m_mutex);
+    ++m_nextSequenceNumberToSend;
+    if (!(snToSend < lastSN)) {
+      break;
+    }
+  }
 
-    // Just usable for IPv4
-    const Locator &locator = proxy.remoteLocator;
+  if (mp_threadPool == nullptr) {
+    return;
+  }
+  if (waitMs != 0) {
+    if (!mp_threadPool->addWorkload(this, waitMs)) {
+      mp_threadPool->addWorkload(this);
+    }
+  } else if (replayPending) {
+    // Give other writers a turn before the next replay burst
+    mp_threadPool->addWorkload(this);
+  }
+}
 
-    info.destAddr = locator.getIp4Address();
-    info.destPort = (Ip4Port_t)locator.port;
+template <typename NetworkDriver>
+bool StatelessWriterT<NetworkDriver>::sendReplayBurst(uint32_t &waitMs) {
+  bool pending = false;
+  for (auto &proxy : m_proxies.read()) {
+    for (uint8_t i = 0; waitMs == 0 && i < Config::DURABILITY_REPLAY_BURST_SIZE;
+         ++i) {
+      SequenceNumber_t sn;
+      {
+        Lock lock(m_mutex);
+        // Skip whatever was evicted since the reader matched
+        const SequenceNumber_t minSN = m_history.getSeqNumMin();
+        if (minSN == SEQUENCENUMBER_UNKNOWN) {
+          proxy.replayNextSN = proxy.replayEndSN;
+        } else if (proxy.replayNextSN < minSN) {
+          proxy.replayNextSN = minSN;
+        }
+        if (!proxy.hasPendingReplay()) {
+          break;
+        }
+        const CacheChange *change = m_history.getChangeBySN(proxy.replayNextSN);
+        if (change != nullptr) {
+          waitMs = consumeTokens(SubmessageData::getRawSize() +
+                                 change->data.spaceUsed());
+          if (waitMs != 0) {
+            break;
+          }
+        }
+        sn = proxy.replayNextSN;
+        ++proxy.replayNextSN;
+      }
+      sendData(proxy, sn);
+    }
+    Lock lock(m_mutex);
+    pending = pending || proxy.hasPendingReplay();
+  }
+  return pending;
+}
 
-    m_transport->sendPacket(info);
+template <typename NetworkDriver>
+bool StatelessWriterT<NetworkDriver>::sendData(const ReaderProxy &reader,
+                                               const SequenceNumber_t &sn) {
+  PacketInfo info;
+  if (!createData(reader.remoteLocator, reader.remoteReaderGuid.entityId, sn,
+                  info)) {
+    return false;
   }
 
-  ++m_nextSequenceNumberToSend;
+  // The message holds a reference to the payload, so eviction meanwhile does
+  // no harm
+  m_transport->sendPacket(info);
+  return true;
+}
+
+template <typename NetworkDriver>
+bool StatelessWriterT<NetworkDriver>::createData(const Locator &locator,
+                                                 const EntityId_t &readerId,
+                                                 const SequenceNumber_t &sn,
+                                                 PacketInfo &info) {
+  info.srcPort = m_packetInfo.srcPort;
+  info.conn = m_packetInfo.conn;
+
+  MessageFactory::addHeader(info.buffer, m_attributes.endpointGuid.prefix);
+  //MessageFactory::addSubMessageTimeStamp(info.buffer);
+
+  {
+    Lock lock(m_mutex);
+    const CacheChange *next = m_history.getChangeBySN(sn);
+    if (next == nullptr) {
+#if SLW_VERBOSE
+      printf("StatelessWriter[%s]: Couldn't get a CacheChange with SN "
+             "(%i,%i)\n",
+             &m_attributes.topicName[0], sn.high, sn.low);
+#endif
+      return false;
+    }
+#if SLW_VERBOSE
+    printf("StatelessWriter[%s]: Sending change with SN (%i,%i)\n",
+           &m_attributes.topicName[0], sn.high, sn.low);
+#endif
+    //TODO: these should be called only when the message data is published.
+    char hoge[2];
+    pbuf_copy_partial(next->data.firstElement, &hoge, 2,0);
+    if(hoge[0] != 0 || hoge[1] != 3) {
+      MessageFactory::addSubMessageDestination(info.buffer);
+      //next->data = next->data[1];
+      //next->size - next->size - 1;
+    }
+    MessageFactory::addSubMessageTimeStamp(info.buffer);
+    MessageFactory::addSubMessageData(
+        info.buffer, next->data, false, next->sequenceNumber,
+        m_attributes.endpointGuid.entityId,
+        readerId); // TODO
+  }
+
+  // Just usable for IPv4
+  info.destAddr = locator.getIp4Address();
+  info.destPort = (Ip4Port_t)locator.port;
+  return true;
 }
@@ -33,20 +33,39 @@ Author: i11 - Embedded Software, RWTH Aachen University
 
 namespace rtps {
 
+//! One sample of a batch passed to Writer::newChanges
+struct Sample {
+  const uint8_t *data;
+  DataSize_t size;
+};
+
 class Writer {
 public:
   TopicData m_attributes;
   virtual bool addNewMatchedReader(const ReaderProxy &newProxy) = 0;
   virtual void removeReader(const Guid &guid) = 0;
+  //! Removes all readers of the given remote participant
+  virtual void removeReaderOfParticipant(const GuidPrefix_t &guidPrefix) = 0;
 
   //! Executes required steps like sending packets. Intended to be called by
   //! worker threads
   virtual void progress() = 0;
   virtual const CacheChange *newChange(ChangeKind_t kind, const uint8_t *data,
                                        DataSize_t size) = 0;
+  //! Adds all samples under one lock and schedules sending once. Stops before
+  //! evicting a change that was not sent yet. Returns the number of samples
+  //! taken.
+  virtual uint32_t newChanges(ChangeKind_t kind, const Sample *samples,
+                              uint32_t count) = 0;
   virtual void setAllChangesToUnsent() = 0;
   virtual void onNewAckNack(const SubmessageAckNack &msg,
                             const GuidPrefix_t &sourceGuidPrefix) = 0;
+  virtual void onNewNackFrag(const SubmessageNackFrag &msg,
+                             const GuidPrefix_t &sourceGuidPrefix) = 0;
+  //! Limits the bytes sent per period, bytesPerPeriod 0 disables it.
+  //! Data above the rate is deferred, not dropped.
+  virtual void setFlowControl(uint32_t bytesPerPeriod, uint32_t periodMs,
+                              uint32_t maxBurst) = 0;
 
   bool isInitialized() { return m_is_initialized_; }
 
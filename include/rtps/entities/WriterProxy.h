@@ -27,43 +27,137 @@ Author: i11 - Embedded Software, RWTH Aachen University
 
 #include "rtps/common/Locator.h"
 #include "rtps/common/types.h"
+#include "rtps/config.h"
+#include "rtps/storages/PBufWrapper.h"
 
 namespace rtps {
+//! Change received ahead of expectedSN. Keeps a reference to its packet.
+struct BufferedChange {
+  SequenceNumber_t sn{0, 0};
+  ChangeKind_t kind = ChangeKind_t::INVALID;
+  PBufWrapper packet;
+  const uint8_t *data = nullptr;
+  DataSize_t size = 0;
+};
+
 struct WriterProxy {
   Guid remoteWriterGuid;
   SequenceNumber_t expectedSN;
-  Count_t ackNackCount;
   Count_t hbCount;
   Locator remoteLocator;
 
+  // Reorder window covering expectedSN + 1 ... expectedSN + window size. The
+  // slot of a change is sn % window size, the bitmap marks occupied slots.
+  std::array<BufferedChange, Config::SF_READER_REORDER_WINDOW_SIZE>
+      reorderSlots{};
+  uint32_t reorderBitMap = 0;
+  static_assert(Config::SF_READER_REORDER_WINDOW_SIZE <= 32,
+                "Reorder bitmap too small for window");
+
   WriterProxy() = default;
 
   WriterProxy(const Guid &guid, const Locator &loc)
       : remoteWriterGuid(guid),
-        expectedSN(SequenceNumber_t{0, 1}), ackNackCount{1}, hbCount{0},
+        expectedSN(SequenceNumber_t{0, 1}), hbCount{0},
         remoteLocator(loc) {}
 
-  // For now, we don't store any packets, so we just request all starting from
-  // the next expected
-  SequenceNumberSet getMissing(const SequenceNumber_t & /*firstAvail*/,
+  //! Requests every change in [max(expectedSN, firstAvail), lastAvail] that
+  //! is neither received nor buffered. Only as many as the reorder window can
+  //! take are requested, anything beyond would be dropped on arrival.
+  SequenceNumberSet getMissing(const SequenceNumber_t &firstAvail,
                                const SequenceNumber_t &lastAvail) {
+    static_assert(Config::SF_READER_REORDER_WINDOW_SIZE < SNS_NUM_BITS,
+                  "Reorder window exceeds a SequenceNumberSet");
+    constexpr uint32_t maxBits = Config::SF_READER_REORDER_WINDOW_SIZE + 1;
+
     SequenceNumberSet set;
-    if (lastAvail < expectedSN) {
-      set.base = expectedSN;
+    set.base = expectedSN < firstAvail ? firstAvail : expectedSN;
+    if (lastAvail < set.base) {
       set.numBits = 0;
-    } else {
-      set.numBits = 1;
-      set.base = expectedSN;
-      set.bitMap[0] = uint32_t{1} << 31;
+      return set;
+    }
+
+    const uint64_t available = toUint64(lastAvail) - toUint64(set.base) + 1;
+    set.numBits =
+        available < maxBits ? static_cast<uint32_t>(available) : maxBits;
+    SequenceNumber_t sn = set.base;
+    for (uint32_t bit = 0; bit < set.numBits; ++bit, ++sn) {
+      if (!isBuffered(sn)) {
+        set.set(bit);
+      }
     }
 
     return set;
   }
 
-  Count_t getNextAckNackCount() {
-    const Count_t tmp = ackNackCount;
-    ++ackNackCount.value;
-    return tmp;
+  bool isInReorderWindow(const SequenceNumber_t &sn) const {
+    return expectedSN < sn && toUint64(sn) - toUint64(expectedSN) <=
+                                  Config::SF_READER_REORDER_WINDOW_SIZE;
+  }
+
+  bool isBuffered(const SequenceNumber_t &sn) const {
+    const uint8_t slot = slotOf(sn);
+    return (reorderBitMap & (uint32_t{1} << slot)) != 0 &&
+           reorderSlots[slot].sn == sn;
+  }
+
+  //! Keeps a change ahead of expectedSN without copying it. Fails if it is
+  //! outside the window or data is not part of packet.
+  bool bufferChange(const SequenceNumber_t &sn, ChangeKind_t kind,
+                    pbuf *packet, const uint8_t *data, DataSize_t size) {
+    const uint8_t slot = slotOf(sn);
+    if (packet == nullptr || !isInReorderWindow(sn) ||
+        (reorderBitMap & (uint32_t{1} << slot)) != 0) {
+      return false;
+    }
+    BufferedChange &change = reorderSlots[slot];
+    pbuf_ref(packet);
+    change.packet = PBufWrapper(packet);
+    change.sn = sn;
+    change.kind = kind;
+    change.data = data;
+    change.size = size;
+    reorderBitMap |= uint32_t{1} << slot;
+    return true;
+  }
+
+  //! Returns the buffered change with expectedSN or nullptr. The slot stays
+  //! valid until releaseExpected() is called.
+  const BufferedChange *getBufferedExpected() const {
+    return isBuffered(expectedSN) ? &reorderSlots[slotOf(expectedSN)]
+                                  : nullptr;
+  }
+
+  void releaseExpected() { releaseSlot(slotOf(expectedSN)); }
+
+  //! Gives up on everything before sn, e.g. because the writer dropped it
+  void skipTo(const SequenceNumber_t &sn) {
+    if (!(expectedSN < sn)) {
+      return;
+    }
+    expectedSN = sn;
+    for (uint8_t slot = 0; slot < reorderSlots.size(); ++slot) {
+      if ((reorderBitMap & (uint32_t{1} << slot)) != 0 &&
+          reorderSlots[slot].sn < expectedSN) {
+        releaseSlot(slot);
+      }
+    }
+  }
+
+private:
+  static uint64_t toUint64(const SequenceNumber_t &sn) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(sn.high)) << 32) |
+           sn.low;
+  }
+
+  static uint8_t slotOf(const SequenceNumber_t &sn) {
+    return static_cast<uint8_t>(toUint64(sn) %
+                                Config::SF_READER_REORDER_WINDOW_SIZE);
+  }
+
+  void releaseSlot(uint8_t slot) {
+    reorderSlots[slot] = BufferedChange{};
+    reorderBitMap &= ~(uint32_t{1} << slot);
   }
 };
 } // namespace rtps
@@ -30,8 +30,11 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/messages/MessageTypes.h"
 #include "rtps/utils/sysFunctions.h"
 
+#include "lwip/pbuf.h"
+
 #include <array>
 #include <cstdint>
+#include <cstring>
 
 namespace rtps {
 namespace MessageFactory {
@@ -39,6 +42,44 @@ const std::array<uint8_t, 4> PROTOCOL_TYPE{'R', 'T', 'P', 'S'};
 const uint8_t numBytesUntilEndOfLength =
     4; // The first bytes incl. submessagelength don't count
 
+//! Zero bytes after a submessage body of length bytes so that the next
+//! submessage starts at a multiple of 4
+inline uint8_t getPadding(uint32_t length) {
+  return static_cast<uint8_t>((4 - length % 4) % 4);
+}
+
+template <class Buffer>
+void addPadding(Buffer &buffer, uint8_t padding) {
+  if (padding == 0) {
+    return;
+  }
+  const uint8_t zeros[3] = {0, 0, 0};
+  buffer.reserve(padding);
+  buffer.append(zeros, padding);
+}
+
+//! Copies payload and pads it. The padding is recorded in the encapsulation
+//! options as receivers can't tell it from the sample otherwise.
+template <class Buffer>
+void addPaddedPayload(Buffer &buffer, const Buffer &payload, uint8_t padding) {
+  const DataSize_t size = payload.spaceUsed();
+  std::array<uint8_t, SMElement::ENCAPSULATION_HEADER_SIZE> encapsulation{};
+  if (padding == 0 || size < encapsulation.size() ||
+      pbuf_copy_partial(payload.firstElement, encapsulation.data(),
+                        encapsulation.size(), 0) != encapsulation.size() ||
+      !SMElement::isEncapsulationHeader(encapsulation.data())) {
+    buffer.appendCopy(payload);
+  } else {
+    encapsulation[3] =
+        (encapsulation[3] & ~SMElement::ENCAPSULATION_PADDING_MASK) | padding;
+    buffer.reserve(encapsulation.size());
+    buffer.append(encapsulation.data(), encapsulation.size());
+    buffer.appendCopy(payload, encapsulation.size(),
+                      size - encapsulation.size());
+  }
+  addPadding(buffer, padding);
+}
+
 template <class Buffer>
 void addHeader(Buffer &buffer, const GuidPrefix_t &guidPrefix) {
 
@@ -101,7 +142,8 @@ void addSubMessageDestination(Buffer &buffer) {
 template <class Buffer>
 void addSubMessageData(Buffer &buffer, const Buffer &filledPayload,
                        bool containsInlineQos, const SequenceNumber_t &SN,
-                       const EntityId_t &writerID, const EntityId_t &readerID) {
+                       const EntityId_t &writerID, const EntityId_t &readerID,
+                       bool copyPayload = false) {
   SubmessageData msg;
   msg.header.submessageId = SubmessageKind::DATA;
 #if IS_LITTLE_ENDIAN
@@ -110,8 +152,12 @@ void addSubMessageData(Buffer &buffer, const Buffer &filledPayload,
   msg.header.flags = FLAG_BIG_ENDIAN;
 #endif
 
+  // The next submessage has to start aligned. A payload chained without copy
+  // always ends the message and needs no padding.
+  const uint8_t padding =
+      copyPayload ? getPadding(filledPayload.spaceUsed()) : 0;
   msg.header.submessageLength = SubmessageData::getRawSize() +
-                                filledPayload.spaceUsed() -
+                                filledPayload.spaceUsed() + padding -
                                 numBytesUntilEndOfLength;
 
   if (containsInlineQos) {
@@ -133,15 +179,67 @@ void addSubMessageData(Buffer &buffer, const Buffer &filledPayload,
   serializeMessage(buffer, msg);
 
   if (filledPayload.isValid()) {
-    Buffer shallowCopy = filledPayload;
-    buffer.append(std::move(shallowCopy));
+    // The payload is chained without copy, so nothing can follow it. Copy it
+    // if more submessages are added to the message.
+    if (copyPayload) {
+      addPaddedPayload(buffer, filledPayload, padding);
+    } else {
+      Buffer shallowCopy = filledPayload;
+      buffer.append(std::move(shallowCopy));
+    }
+  }
+}
+
+//! Adds the single fragment fragmentNum (starting at 1) of sample. The
+//! fragment is copied and padded, so more submessages can follow.
+template <class Buffer>
+void addSubMessageDataFrag(Buffer &buffer, const Buffer &sample,
+                           uint32_t fragmentNum, uint16_t fragmentSize,
+                           const SequenceNumber_t &SN,
+                           const EntityId_t &writerID,
+                           const EntityId_t &readerID) {
+  const DataSize_t sampleSize = sample.spaceUsed();
+  const uint32_t offset = (fragmentNum - 1) * fragmentSize;
+  if (offset >= sampleSize) {
+    return;
   }
+  const DataSize_t length = sampleSize - offset < fragmentSize
+                                ? static_cast<DataSize_t>(sampleSize - offset)
+                                : fragmentSize;
+
+  SubmessageDataFrag msg;
+  msg.header.submessageId = SubmessageKind::DATA_FRAG;
+#if IS_LITTLE_ENDIAN
+  msg.header.flags = FLAG_LITTLE_ENDIAN;
+#else
+  msg.header.flags = FLAG_BIG_ENDIAN;
+#endif
+  // Receivers take the fragment length from sampleSize, not from the padding
+  const uint8_t padding = getPadding(length);
+  msg.header.submessageLength = SubmessageDataFrag::getRawSize() + length +
+                                padding - numBytesUntilEndOfLength;
+
+  msg.extraFlags = 0;
+  constexpr uint16_t octetsToInlineQoS =
+      4 + 4 + 8 + 4 + 2 + 2 + 4; // EntityIds + SequenceNumber + Fragment info
+  msg.octetsToInlineQos = octetsToInlineQoS;
+  msg.readerId = readerID;
+  msg.writerId = writerID;
+  msg.writerSN = SN;
+  msg.fragmentStartingNum.value = fragmentNum;
+  msg.fragmentsInSubmessage = 1;
+  msg.fragmentSize = fragmentSize;
+  msg.sampleSize = sampleSize;
+
+  serializeMessage(buffer, msg);
+  buffer.appendCopy(sample, static_cast<DataSize_t>(offset), length);
+  addPadding(buffer, padding);
 }
 
 template <class Buffer>
 void addHeartbeat(Buffer &buffer, EntityId_t writerId, EntityId_t readerId,
                   SequenceNumber_t firstSN, SequenceNumber_t lastSN,
-                  Count_t count) {
+                  Count_t count, bool isFinal = false) {
   SubmessageHeartbeat subMsg;
   subMsg.header.submessageId = SubmessageKind::HEARTBEAT;
   subMsg.header.submessageLength =
@@ -151,7 +249,11 @@ void addHeartbeat(Buffer &buffer, EntityId_t writerId, EntityId_t readerId,
 #else
   subMsg.header.flags = FLAG_BIG_ENDIAN;
 #endif
-  // Force response by not setting final flag.
+  // Without the final flag the reader has to respond, even if nothing is
+  // missing
+  if (isFinal) {
+    subMsg.header.flags |= FLAG_FINAL;
+  }
 
   subMsg.writerId = writerId;
   subMsg.readerId = readerId;
@@ -183,6 +285,51 @@ void addAckNack(Buffer &buffer, EntityId_t writerId, EntityId_t readerId,
 
   serializeMessage(buffer, subMsg);
 }
+
+template <class Buffer>
+void addNackFrag(Buffer &buffer, EntityId_t writerId, EntityId_t readerId,
+                 SequenceNumber_t writerSN,
+                 FragmentNumberSet fragmentNumberState, Count_t count) {
+  SubmessageNackFrag subMsg;
+  subMsg.header.submessageId = SubmessageKind::NACK_FRAG;
+#if IS_LITTLE_ENDIAN
+  subMsg.header.flags = FLAG_LITTLE_ENDIAN;
+#else
+  subMsg.header.flags = FLAG_BIG_ENDIAN;
+#endif
+  subMsg.header.submessageLength =
+      SubmessageNackFrag::getRawSize(fragmentNumberState) -
+      numBytesUntilEndOfLength;
+
+  subMsg.writerId = writerId;
+  subMsg.readerId = readerId;
+  subMsg.writerSN = writerSN;
+  subMsg.fragmentNumberState = fragmentNumberState;
+  subMsg.count = count;
+
+  serializeMessage(buffer, subMsg);
+}
+
+template <class Buffer>
+void addGap(Buffer &buffer, EntityId_t writerId, EntityId_t readerId,
+            SequenceNumber_t gapStart, SequenceNumberSet gapList) {
+  SubmessageGap subMsg;
+  subMsg.header.submessageId = SubmessageKind::GAP;
+#if IS_LITTLE_ENDIAN
+  subMsg.header.flags = FLAG_LITTLE_ENDIAN;
+#else
+  subMsg.header.flags = FLAG_BIG_ENDIAN;
+#endif
+  subMsg.header.submessageLength =
+      SubmessageGap::getRawSize(gapList) - numBytesUntilEndOfLength;
+
+  subMsg.writerId = writerId;
+  subMsg.readerId = readerId;
+  subMsg.gapStart = gapStart;
+  subMsg.gapList = gapList;
+
+  serializeMessage(buffer, subMsg);
+}
 } // namespace MessageFactory
 } // namespace rtps
 
@@ -0,0 +1,87 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_MESSAGEINDEX_H
+#define RTPS_MESSAGEINDEX_H
+
+#include "rtps/common/types.h"
+#include "rtps/config.h"
+#include "rtps/messages/MessageTypes.h"
+
+struct pbuf;
+
+namespace rtps {
+
+struct SubmessageIndexEntry {
+  SubmessageHeader header;
+  //! Offset of the submessage header within the message
+  DataSize_t offset;
+  //! Reader of DATA, DATA_FRAG, HEARTBEAT and GAP, writer of ACKNACK and
+  //! NACK_FRAG. ENTITYID_UNKNOWN for all others.
+  EntityId_t targetId;
+};
+
+/**
+ * Result of walking through an RTPS message once: the header and where each
+ * submessage is, of which kind it is and for which endpoint it is meant. Every
+ * local participant can decide on this what to deserialize instead of parsing
+ * the whole message again.
+ * Messages with more than Config::MAX_SUBMESSAGES_PER_MESSAGE submessages are
+ * indexed in several rounds, see parseNext().
+ */
+class MessageIndex {
+public:
+  MessageIndex(const uint8_t *data, DataSize_t size,
+               pbuf *packetBuffer = nullptr)
+      : data(data), size(size), packetBuffer(packetBuffer) {}
+
+  const uint8_t *const data;
+  const DataSize_t size;
+  pbuf *const packetBuffer;
+  Header header;
+
+  //! Checks and reads the header
+  bool parseHeader();
+  //! Indexes the next submessages. Returns false if there are none left.
+  bool parseNext();
+
+  //! True if the current entries start right behind the header
+  bool isFirstRound() const { return m_roundStart == Header::getRawSize(); }
+  uint8_t getNumEntries() const { return m_numEntries; }
+  const SubmessageIndexEntry &getEntry(uint8_t i) const { return m_entries[i]; }
+
+private:
+  std::array<SubmessageIndexEntry, Config::MAX_SUBMESSAGES_PER_MESSAGE>
+      m_entries;
+  uint8_t m_numEntries = 0;
+  DataSize_t m_roundStart = 0;
+  DataSize_t m_nextPos = 0;
+
+  EntityId_t readEntityId(DataSize_t offset) const;
+};
+
+} // namespace rtps
+
+#endif // RTPS_MESSAGEINDEX_H
@@ -30,42 +30,76 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/discovery/BuiltInEndpoints.h"
 #include <cstdint>
 
+struct pbuf;
+
 namespace rtps {
 class Reader;
 class Writer;
 class Participant;
 class MessageProcessingInfo;
+class MessageIndex;
+struct SubmessageIndexEntry;
 
-class MessageReceiver {
-public:
+//! State a message sets up for its submessages, e.g. through INFO_SRC or
+//! INFO_TS. Lives as long as one message is processed, so several threads can
+//! process messages for the same participant at the same time.
+struct ReceiverState {
   GuidPrefix_t sourceGuidPrefix = GUIDPREFIX_UNKNOWN;
   ProtocolVersion_t sourceVersion = PROTOCOLVERSION;
   VendorId_t sourceVendor = VENDOR_UNKNOWN;
   bool haveTimeStamp = false;
+  Time_t timestamp = TIME_INVALID;
+  //! Participant the following submessages are meant for. Others are skipped
+  //! without being parsed.
+  GuidPrefix_t destGuidPrefix = GUIDPREFIX_UNKNOWN;
+};
 
+//! Stateless apart from the participant, all per-message state is passed in
+class MessageReceiver {
+public:
   explicit MessageReceiver(Participant *part);
 
-  bool processMessage(const uint8_t *data, DataSize_t size);
+  bool processMessage(const uint8_t *data, DataSize_t size,
+                      pbuf *packetBuffer = nullptr) const;
+  //! Processes the current round of an index that was built once for all
+  //! participants receiving the message. state has to be kept for all rounds
+  //! of the message.
+  bool processIndex(const MessageIndex &index, ReceiverState &state) const;
 
 private:
   Participant *mp_part;
 
-  void resetState();
-
-  // TODO make msgInfo a member
-  // This probably make processing faster, as no parameter needs to be passed
-  // around However, we need to make sure data is set to nullptr after
-  // processMsg to make sure we don't access it again afterwards.
-  /**
-   * Check header for validity, modifies the state of the receiver and
-   * adjusts the position of msgInfo accordingly
-   */
-  bool processHeader(MessageProcessingInfo &msgInfo);
+  //! Drops our own messages and sets up state at the first round
+  bool processHeader(const MessageIndex &index, ReceiverState &state) const;
   bool processSubmessage(MessageProcessingInfo &msgInfo,
-                         const SubmessageHeader &submsgHeader);
-  bool processDataSubmessage(MessageProcessingInfo &msgInfo);
-  bool processHeartbeatSubmessage(MessageProcessingInfo &msgInfo);
-  bool processAckNackSubmessage(MessageProcessingInfo &msgInfo);
+                         const SubmessageIndexEntry &entry,
+                         ReceiverState &state) const;
+  //! DATA to ENTITYID_UNKNOWN goes to all readers matched with the writer
+  bool processDataSubmessage(MessageProcessingInfo &msgInfo,
+                             const EntityId_t &readerId,
+                             const ReceiverState &state) const;
+  bool processDataFragSubmessage(MessageProcessingInfo &msgInfo,
+                                 Reader &reader,
+                                 const ReceiverState &state) const;
+  bool processHeartbeatSubmessage(MessageProcessingInfo &msgInfo,
+                                  Reader &reader,
+                                  const ReceiverState &state) const;
+  bool processAckNackSubmessage(MessageProcessingInfo &msgInfo,
+                                Writer &writer,
+                                const ReceiverState &state) const;
+  bool processNackFragSubmessage(MessageProcessingInfo &msgInfo,
+                                 Writer &writer,
+                                 const ReceiverState &state) const;
+  bool processGapSubmessage(MessageProcessingInfo &msgInfo, Reader &reader,
+                            const ReceiverState &state) const;
+  bool processInfoDstSubmessage(MessageProcessingInfo &msgInfo,
+                                ReceiverState &state) const;
+  bool processInfoSrcSubmessage(MessageProcessingInfo &msgInfo,
+                                ReceiverState &state) const;
+  bool processInfoTsSubmessage(MessageProcessingInfo &msgInfo,
+                               ReceiverState &state) const;
+  //! True for submessages that only change the state of the receiver
+  static bool isInterpreterSubmessage(SubmessageKind kind);
 };
 } // namespace rtps
 
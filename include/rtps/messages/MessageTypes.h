@@ -29,6 +29,8 @@ Author: i11 - Embedded Software, RWTH Aachen University
 
 #include <array>
 
+struct pbuf;
+
 namespace rtps {
 
 namespace SMElement {
@@ -112,6 +114,15 @@ enum BuildInEndpointSet : uint32_t {
 const std::array<uint8_t, 2> SCHEME_CDR_LE{0x00, 0x01};
 const std::array<uint8_t, 2> SCHEME_PL_CDR_LE{0x00, 0x03};
 
+// Serialized payloads start with a representation identifier (0x0000 to
+// 0x000b) and two bytes of options. The low two bits of the options count the
+// padding bytes at the end of the payload.
+const uint8_t ENCAPSULATION_HEADER_SIZE = 4;
+const uint8_t ENCAPSULATION_PADDING_MASK = 0x03;
+inline bool isEncapsulationHeader(const uint8_t *header) {
+  return header[0] == 0x00 && header[1] <= 0x0b;
+}
+
 struct ParameterList_t {
   ParameterId pid;
   uint16_t length;
@@ -202,10 +213,7 @@ struct SubmessageAckNack {
   SequenceNumberSet readerSNState;
   Count_t count;
   static uint16_t getRawSize(const SequenceNumberSet &set) {
-    uint16_t bitMapSize = 0;
-    if (set.numBits != 0) {
-      bitMapSize = 4 * ((set.numBits / 32) + 1);
-    }
+    const uint16_t bitMapSize = 4 * set.getNumWords();
     return getRawSizeWithoutSNSet() + sizeof(SequenceNumber_t) +
            sizeof(uint32_t) + bitMapSize; // SequenceNumberSet
   }
@@ -215,6 +223,89 @@ struct SubmessageAckNack {
   }
 };
 
+struct SubmessageDataFrag {
+  SubmessageHeader header;
+  uint16_t extraFlags;
+  uint16_t octetsToInlineQos;
+  EntityId_t readerId;
+  EntityId_t writerId;
+  SequenceNumber_t writerSN;
+  FragmentNumber_t fragmentStartingNum; // Starts at 1
+  uint16_t fragmentsInSubmessage;
+  uint16_t fragmentSize;
+  uint32_t sampleSize;
+  static constexpr uint16_t getRawSize() {
+    return SubmessageHeader::getRawSize() + sizeof(uint16_t) +
+           sizeof(uint16_t) + (2 * 3 + 2 * 1) // EntityID
+           + sizeof(SequenceNumber_t) + sizeof(FragmentNumber_t) +
+           sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint32_t);
+  }
+};
+
+struct SubmessageNackFrag {
+  SubmessageHeader header;
+  EntityId_t readerId;
+  EntityId_t writerId;
+  SequenceNumber_t writerSN;
+  FragmentNumberSet fragmentNumberState;
+  Count_t count;
+  static uint16_t getRawSize(const FragmentNumberSet &set) {
+    const uint16_t bitMapSize = 4 * set.getNumWords();
+    return getRawSizeWithoutFNSet() + sizeof(FragmentNumber_t) +
+           sizeof(uint32_t) + bitMapSize; // FragmentNumberSet
+  }
+  static uint16_t getRawSizeWithoutFNSet() {
+    return SubmessageHeader::getRawSize() + (2 * 3 + 2 * 1) // EntityID
+           + sizeof(SequenceNumber_t) + sizeof(Count_t);
+  }
+};
+
+struct SubmessageGap {
+  SubmessageHeader header;
+  EntityId_t readerId;
+  EntityId_t writerId;
+  // Irrelevant are [gapStart, gapList.base) and the ones set in gapList
+  SequenceNumber_t gapStart;
+  SequenceNumberSet gapList;
+  static uint16_t getRawSize(const SequenceNumberSet &set) {
+    const uint16_t bitMapSize = 4 * set.getNumWords();
+    return getRawSizeWithoutSNSet() + sizeof(SequenceNumber_t) +
+           sizeof(uint32_t) + bitMapSize; // SequenceNumberSet
+  }
+  static uint16_t getRawSizeWithoutSNSet() {
+    return SubmessageHeader::getRawSize() + (2 * 3 + 2 * 1) // EntityID
+           + sizeof(SequenceNumber_t);
+  }
+};
+
+struct SubmessageInfoDst {
+  SubmessageHeader header;
+  GuidPrefix_t guidPrefix;
+  static constexpr uint16_t getRawSize() {
+    return SubmessageHeader::getRawSize() + sizeof(GuidPrefix_t);
+  }
+};
+
+struct SubmessageInfoSrc {
+  SubmessageHeader header;
+  ProtocolVersion_t protocolVersion;
+  VendorId_t vendorId;
+  GuidPrefix_t guidPrefix;
+  static constexpr uint16_t getRawSize() {
+    return SubmessageHeader::getRawSize() + sizeof(uint32_t) // unused
+           + sizeof(ProtocolVersion_t) + sizeof(VendorId_t) +
+           sizeof(GuidPrefix_t);
+  }
+};
+
+struct SubmessageInfoTs {
+  SubmessageHeader header;
+  Time_t timestamp; // Only if FLAG_INVALIDATE is not set
+  static constexpr uint16_t getRawSize() {
+    return SubmessageHeader::getRawSize() + sizeof(int32_t) + sizeof(uint32_t);
+  }
+};
+
 template <typename Buffer>
 bool serializeMessage(Buffer &buffer, Header &header) {
   if (!buffer.reserve(Header::getRawSize())) {
@@ -317,18 +408,118 @@ bool serializeMessage(Buffer &buffer, SubmessageAckNack &msg) {
                 sizeof(uint32_t));
   if (msg.readerSNState.numBits != 0) {
     buffer.append(reinterpret_cast<uint8_t *>(msg.readerSNState.bitMap.data()),
-                  4 * ((msg.readerSNState.numBits / 32) + 1));
+                  4 * msg.readerSNState.getNumWords());
   }
   buffer.append(reinterpret_cast<uint8_t *>(&msg.count.value),
                 sizeof(msg.count.value));
   return true;
 }
 
+template <typename Buffer>
+bool serializeMessage(Buffer &buffer, SubmessageDataFrag &msg) {
+  if (!buffer.reserve(SubmessageDataFrag::getRawSize())) {
+    return false;
+  }
+
+  serializeMessage(buffer, msg.header);
+
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.extraFlags), sizeof(uint16_t));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.octetsToInlineQos),
+                sizeof(uint16_t));
+  buffer.append(msg.readerId.entityKey.data(), msg.readerId.entityKey.size());
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.readerId.entityKind),
+                sizeof(EntityKind_t));
+  buffer.append(msg.writerId.entityKey.data(), msg.writerId.entityKey.size());
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerId.entityKind),
+                sizeof(EntityKind_t));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerSN.high),
+                sizeof(msg.writerSN.high));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerSN.low),
+                sizeof(msg.writerSN.low));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.fragmentStartingNum.value),
+                sizeof(msg.fragmentStartingNum.value));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.fragmentsInSubmessage),
+                sizeof(uint16_t));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.fragmentSize),
+                sizeof(uint16_t));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.sampleSize),
+                sizeof(uint32_t));
+  return true;
+}
+
+template <typename Buffer>
+bool serializeMessage(Buffer &buffer, SubmessageNackFrag &msg) {
+  if (!buffer.reserve(
+          SubmessageNackFrag::getRawSize(msg.fragmentNumberState))) {
+    return false;
+  }
+
+  serializeMessage(buffer, msg.header);
+
+  buffer.append(msg.readerId.entityKey.data(), msg.readerId.entityKey.size());
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.readerId.entityKind),
+                sizeof(EntityKind_t));
+  buffer.append(msg.writerId.entityKey.data(), msg.writerId.entityKey.size());
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerId.entityKind),
+                sizeof(EntityKind_t));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerSN.high),
+                sizeof(msg.writerSN.high));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerSN.low),
+                sizeof(msg.writerSN.low));
+  buffer.append(
+      reinterpret_cast<uint8_t *>(&msg.fragmentNumberState.base.value),
+      sizeof(msg.fragmentNumberState.base.value));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.fragmentNumberState.numBits),
+                sizeof(uint32_t));
+  if (msg.fragmentNumberState.numBits != 0) {
+    buffer.append(
+        reinterpret_cast<uint8_t *>(msg.fragmentNumberState.bitMap.data()),
+        4 * msg.fragmentNumberState.getNumWords());
+  }
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.count.value),
+                sizeof(msg.count.value));
+  return true;
+}
+
+template <typename Buffer>
+bool serializeMessage(Buffer &buffer, SubmessageGap &msg) {
+  if (!buffer.reserve(SubmessageGap::getRawSize(msg.gapList))) {
+    return false;
+  }
+
+  serializeMessage(buffer, msg.header);
+
+  buffer.append(msg.readerId.entityKey.data(), msg.readerId.entityKey.size());
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.readerId.entityKind),
+                sizeof(EntityKind_t));
+  buffer.append(msg.writerId.entityKey.data(), msg.writerId.entityKey.size());
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.writerId.entityKind),
+                sizeof(EntityKind_t));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.gapStart.high),
+                sizeof(msg.gapStart.high));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.gapStart.low),
+                sizeof(msg.gapStart.low));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.gapList.base.high),
+                sizeof(msg.gapList.base.high));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.gapList.base.low),
+                sizeof(msg.gapList.base.low));
+  buffer.append(reinterpret_cast<uint8_t *>(&msg.gapList.numBits),
+                sizeof(uint32_t));
+  if (msg.gapList.numBits != 0) {
+    buffer.append(reinterpret_cast<uint8_t *>(msg.gapList.bitMap.data()),
+                  4 * msg.gapList.getNumWords());
+  }
+  return true;
+}
+
 struct MessageProcessingInfo {
-  MessageProcessingInfo(const uint8_t *data, DataSize_t size)
-      : data(data), size(size) {}
+  MessageProcessingInfo(const uint8_t *data, DataSize_t size,
+                        pbuf *packetBuffer = nullptr)
+      : data(data), size(size), packetBuffer(packetBuffer) {}
   const uint8_t *data;
   const DataSize_t size;
+  //! pbuf holding data, if any. Allows referencing the data beyond processing
+  pbuf *const packetBuffer;
 
   //! Offset to the next unprocessed byte
   DataSize_t nextPos = 0;
@@ -354,6 +545,23 @@ bool deserializeMessage(const MessageProcessingInfo &info,
 bool deserializeMessage(const MessageProcessingInfo &info,
                         SubmessageAckNack &msg);
 
+bool deserializeMessage(const MessageProcessingInfo &info, SubmessageGap &msg);
+
+bool deserializeMessage(const MessageProcessingInfo &info,
+                        SubmessageDataFrag &msg);
+
+bool deserializeMessage(const MessageProcessingInfo &info,
+                        SubmessageNackFrag &msg);
+
+bool deserializeMessage(const MessageProcessingInfo &info,
+                        SubmessageInfoDst &msg);
+
+bool deserializeMessage(const MessageProcessingInfo &info,
+                        SubmessageInfoSrc &msg);
+
+bool deserializeMessage(const MessageProcessingInfo &info,
+                        SubmessageInfoTs &msg);
+
 } // namespace rtps
 
 #endif // RTPS_MESSAGES_H
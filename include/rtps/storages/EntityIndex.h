@@ -0,0 +1,123 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_ENTITYINDEX_H
+#define RTPS_ENTITYINDEX_H
+
+#include "rtps/common/types.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace rtps {
+
+/**
+ * Fixed-capacity hash index from EntityId to endpoint. Open addressing with
+ * linear probing over a power-of-two table of at least twice the number of
+ * entries, so a lookup is a hash and usually a single compare. Key and value
+ * share a slot, a probe touches one cache line.
+ *
+ * Same threading contract as the endpoint arrays of the participant: add is
+ * not thread-safe, find may run concurrently with it. A slot is published by
+ * storing its value last with release order, find acquires it before it
+ * compares the key.
+ */
+template <class TYPE, uint32_t SIZE> class EntityIndex {
+public:
+  bool add(const EntityId_t &id, TYPE *value) {
+    if (value == nullptr || m_numEntries == SIZE) {
+      return false;
+    }
+    const uint32_t key = toKey(id);
+    for (uint32_t slot = hash(key);; slot = (slot + 1) & MASK) {
+      Slot &entry = m_slots[slot];
+      if (entry.value.load(std::memory_order_relaxed) == nullptr) {
+        entry.key = key;
+        entry.value.store(value, std::memory_order_release);
+        ++m_numEntries;
+        return true;
+      }
+      if (entry.key == key) {
+        return false;
+      }
+    }
+  }
+
+  TYPE *find(const EntityId_t &id) const {
+    const uint32_t key = toKey(id);
+    // Terminates because the table is never more than half full
+    for (uint32_t slot = hash(key);; slot = (slot + 1) & MASK) {
+      const Slot &entry = m_slots[slot];
+      TYPE *value = entry.value.load(std::memory_order_acquire);
+      if (value == nullptr) {
+        return nullptr;
+      }
+      if (entry.key == key) {
+        return value;
+      }
+    }
+  }
+
+  uint32_t getNumEntries() const { return m_numEntries; }
+
+private:
+  struct Slot {
+    //! Written once before value is published, never changed afterwards
+    uint32_t key;
+    std::atomic<TYPE *> value;
+  };
+
+  static constexpr uint32_t capacityFor(uint32_t minimum,
+                                        uint32_t capacity = 1) {
+    return capacity >= minimum ? capacity : capacityFor(minimum, capacity * 2);
+  }
+
+  static constexpr uint32_t CAPACITY = capacityFor(2 * SIZE);
+  static constexpr uint32_t MASK = CAPACITY - 1;
+
+  Slot m_slots[CAPACITY]{};
+  uint32_t m_numEntries = 0;
+
+  static uint32_t toKey(const EntityId_t &id) {
+    return static_cast<uint32_t>(id.entityKey[0]) << 24 |
+           static_cast<uint32_t>(id.entityKey[1]) << 16 |
+           static_cast<uint32_t>(id.entityKey[2]) << 8 |
+           static_cast<uint32_t>(id.entityKind);
+  }
+
+  // Fibonacci hashing, the top bits mix the key and the kind alike
+  static uint32_t hash(uint32_t key) {
+    return static_cast<uint32_t>(key * UINT32_C(2654435769)) >>
+           (32 - log2(CAPACITY));
+  }
+
+  static constexpr uint32_t log2(uint32_t value) {
+    return value <= 1 ? 0 : 1 + log2(value / 2);
+  }
+};
+
+} // namespace rtps
+
+#endif // RTPS_ENTITYINDEX_H
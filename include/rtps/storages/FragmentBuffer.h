@@ -0,0 +1,89 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_FRAGMENTBUFFER_H
+#define RTPS_FRAGMENTBUFFER_H
+
+#include "lwip/pbuf.h"
+#include "rtps/common/types.h"
+#include "rtps/config.h"
+
+namespace rtps {
+
+/**
+ * Reassembles one sample received as DATA_FRAG. The sample lives in a single
+ * contiguous pbuf, so it can be handed out like an unfragmented DATA and kept
+ * by reference in a reorder window.
+ */
+class FragmentBuffer {
+public:
+  FragmentBuffer() = default;
+  ~FragmentBuffer();
+  FragmentBuffer(const FragmentBuffer &) = delete;
+  FragmentBuffer &operator=(const FragmentBuffer &) = delete;
+
+  //! Drops whatever was collected and prepares for a new sample
+  bool start(const Guid &writerGuid, const SequenceNumber_t &sn,
+             uint32_t sampleSize, uint16_t fragmentSize);
+  void reset();
+
+  bool isInUse() const { return m_pbuf != nullptr; }
+  bool isFor(const Guid &writerGuid, const SequenceNumber_t &sn) const {
+    return isInUse() && m_writerGuid == writerGuid && m_sn == sn;
+  }
+
+  //! Copies numFragments fragments starting with firstFragment (starts at 1)
+  bool add(uint32_t firstFragment, uint16_t numFragments, uint16_t fragmentSize,
+           const uint8_t *data, DataSize_t size);
+  bool isComplete() const {
+    return isInUse() && m_numReceived == m_numFragments;
+  }
+  //! Fragments still missing, to be requested with NACK_FRAG
+  FragmentNumberSet getMissing() const;
+
+  const Guid &getWriterGuid() const { return m_writerGuid; }
+  const SequenceNumber_t &getSequenceNumber() const { return m_sn; }
+  const uint8_t *getData() const;
+  DataSize_t getSampleSize() const { return m_sampleSize; }
+  pbuf *getPbuf() const { return m_pbuf; }
+
+private:
+  Guid m_writerGuid{GUIDPREFIX_UNKNOWN, ENTITYID_UNKNOWN};
+  SequenceNumber_t m_sn{0, 0};
+  pbuf *m_pbuf = nullptr;
+  DataSize_t m_sampleSize = 0;
+  uint16_t m_fragmentSize = 0;
+  uint16_t m_numFragments = 0;
+  uint16_t m_numReceived = 0;
+  std::array<uint32_t, FNS_NUM_BITS / 32> m_received{};
+
+  bool isReceived(uint32_t index) const {
+    return (m_received[index / 32] & (uint32_t{1} << (index % 32))) != 0;
+  }
+};
+
+} // namespace rtps
+
+#endif // RTPS_FRAGMENTBUFFER_H
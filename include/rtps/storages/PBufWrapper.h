@@ -58,6 +58,13 @@ struct PBufWrapper {
   /// append(uint8_t*[...]) will continue behind the appended wrapper
   void append(PBufWrapper &&other);
 
+  /// Copies the used part of other. Unlike append(PBufWrapper&&), other can be
+  /// followed by more data as its pbuf chain is left untouched.
+  bool appendCopy(const PBufWrapper &other);
+  /// Copies length bytes of other starting at offset, e.g. one fragment
+  bool appendCopy(const PBufWrapper &other, DataSize_t offset,
+                  DataSize_t length);
+
   bool reserve(DataSize_t length);
 
   /// After calling this function, data is added starting from the beginning
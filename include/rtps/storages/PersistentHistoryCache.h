@@ -0,0 +1,128 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_PERSISTENTHISTORYCACHE_H
+#define RTPS_PERSISTENTHISTORYCACHE_H
+
+#if defined(unix) || defined(__unix__)
+
+#include "rtps/config.h"
+#include "rtps/storages/CacheChange.h"
+
+namespace rtps {
+
+/**
+ * History cache of PERSISTENT writers on the host port. Changes live in a
+ * memory-mapped file made of a small header and a ring of HISTORY_SIZE
+ * fixed-size records. The record of a sequence number is sn % HISTORY_SIZE and
+ * is overwritten in place when the ring wraps around, so adding a change only
+ * writes one record and reopening the file is a single scan over the record
+ * headers. The file header keeps the last assigned sequence number, which
+ * survives even if every change was removed. Payloads are never deserialized;
+ * CacheChanges reference them in place through PBUF_REF pbufs.
+ *
+ * Offers the same interface as SimpleHistoryCache to be used as history of
+ * StatefulWriterT. A slot is reused in place once the history is full, while
+ * a message may still reference the old payload until it is sent. Writers
+ * therefore copy these payloads into their messages, which also leaves no
+ * reference into the mapping behind on close().
+ */
+class PersistentHistoryCache {
+public:
+  //! Payloads are overwritten in place, they must be copied, not chained
+  static constexpr bool PAYLOADS_IN_PLACE = true;
+
+  PersistentHistoryCache() = default;
+  ~PersistentHistoryCache();
+
+  PersistentHistoryCache(const PersistentHistoryCache &) = delete;
+  PersistentHistoryCache &operator=(const PersistentHistoryCache &) = delete;
+
+  //! Maps the file at path, creating it if required, and recovers its content
+  bool open(const char *path);
+  void close();
+  bool isOpen() const;
+
+  bool isFull() const;
+  const CacheChange *addChange(const uint8_t *data, DataSize_t size);
+  void dropOldest();
+  void removeUntilIncl(SequenceNumber_t sn);
+  const CacheChange *getChangeBySN(SequenceNumber_t sn) const;
+
+  const SequenceNumber_t &getSeqNumMin() const;
+  const SequenceNumber_t &getSeqNumMax() const;
+  //! Last sequence number ever assigned, {0, 0} for a new file
+  const SequenceNumber_t &getLastUsedSequenceNumber() const;
+
+private:
+  static constexpr uint32_t FILE_MAGIC = 0x52545048; // "RTPH"
+  static constexpr uint16_t FILE_VERSION = 1;
+  static constexpr uint16_t NUM_RECORDS = Config::HISTORY_SIZE;
+
+  struct FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numRecords;
+    uint32_t recordSize;
+    uint32_t reserved;
+    SequenceNumber_t lastUsedSequenceNumber;
+  };
+
+  struct RecordHeader {
+    SequenceNumber_t sequenceNumber;
+    DataSize_t size;
+    ChangeKind_t kind;
+    uint8_t reserved;
+  };
+
+  static constexpr uint32_t RECORD_SIZE =
+      (sizeof(RecordHeader) + Config::PERSISTENT_HISTORY_MAX_SAMPLE_SIZE + 7) &
+      ~uint32_t{7};
+  static constexpr size_t FILE_SIZE =
+      sizeof(FileHeader) + NUM_RECORDS * RECORD_SIZE;
+
+  int m_fd = -1;
+  uint8_t *mp_mapping = nullptr;
+
+  std::array<CacheChange, NUM_RECORDS> m_changes{};
+  uint16_t m_numChanges = 0;
+  SequenceNumber_t m_minSequenceNumber{0, 0};
+  SequenceNumber_t m_lastUsedSequenceNumber{0, 0};
+
+  FileHeader &fileHeader() const;
+  RecordHeader &recordHeader(uint16_t slot) const;
+  uint8_t *recordPayload(uint16_t slot) const;
+  static uint16_t slotOf(const SequenceNumber_t &sn);
+
+  bool formatFile();
+  void recover();
+  bool referencePayload(uint16_t slot);
+  void invalidateOldest();
+};
+} // namespace rtps
+
+#endif // unix
+
+#endif // RTPS_PERSISTENTHISTORYCACHE_H
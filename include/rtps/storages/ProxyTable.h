@@ -0,0 +1,234 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#ifndef RTPS_PROXYTABLE_H
+#define RTPS_PROXYTABLE_H
+
+#include "lwip/sys.h"
+#include "rtps/utils/Lock.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace rtps {
+
+/**
+ * Fixed-size table for the proxies of an endpoint. Send loops iterate a View,
+ * which pins the current epoch instead of holding a lock. Updates take the
+ * table's mutex only briefly. A removed element stays readable until every
+ * view that might still see it is gone, only then its slot is reused.
+ *
+ * The table protects its structure, not the fields of the elements. Fields
+ * that change after add are guarded by the owning endpoint.
+ */
+template <class TYPE, uint32_t SIZE> class ProxyTable {
+public:
+  class Iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = TYPE;
+    using difference_type = uint8_t;
+    using pointer = TYPE *;
+    using reference = TYPE &;
+
+    Iterator(ProxyTable<TYPE, SIZE> &table, const uint8_t *liveMap,
+             uint32_t slot)
+        : m_table(table), m_liveMap(liveMap), m_slot(slot) {
+      skipFree();
+    }
+
+    bool operator!=(const Iterator &other) const {
+      return m_slot != other.m_slot;
+    }
+
+    reference operator*() const { return m_table.m_data[m_slot]; }
+
+    Iterator &operator++() {
+      ++m_slot;
+      skipFree();
+      return *this;
+    }
+
+  private:
+    ProxyTable<TYPE, SIZE> &m_table;
+    const uint8_t *m_liveMap;
+    uint32_t m_slot;
+
+    void skipFree() {
+      while (m_slot < SIZE && !isBitSet(m_liveMap, m_slot)) {
+        ++m_slot;
+      }
+    }
+  };
+
+  //! Consistent snapshot of the table. Elements reached through it stay valid
+  //! while the view exists, even if they are removed meanwhile.
+  class View {
+  public:
+    explicit View(ProxyTable<TYPE, SIZE> &table) : mp_table(&table) {
+      Lock lock(table.m_mutex);
+      m_epoch = table.m_epoch;
+      ++table.m_readers[m_epoch % 2];
+      memcpy(m_liveMap, table.m_liveMap, sizeof(m_liveMap));
+    }
+
+    View(View &&other) : mp_table(other.mp_table), m_epoch(other.m_epoch) {
+      memcpy(m_liveMap, other.m_liveMap, sizeof(m_liveMap));
+      other.mp_table = nullptr;
+    }
+
+    View(const View &) = delete;
+    View &operator=(const View &) = delete;
+    View &operator=(View &&) = delete;
+
+    ~View() {
+      if (mp_table == nullptr) {
+        return;
+      }
+      Lock lock(mp_table->m_mutex);
+      --mp_table->m_readers[m_epoch % 2];
+      mp_table->reclaim();
+    }
+
+    Iterator begin() { return Iterator(*mp_table, m_liveMap, 0); }
+    Iterator end() { return Iterator(*mp_table, m_liveMap, SIZE); }
+
+  private:
+    ProxyTable<TYPE, SIZE> *mp_table;
+    uint32_t m_epoch;
+    uint8_t m_liveMap[SIZE / 8 + 1];
+  };
+
+  ProxyTable() { sys_mutex_new(&m_mutex); }
+  ~ProxyTable() { sys_mutex_free(&m_mutex); }
+  ProxyTable(const ProxyTable &) = delete;
+  ProxyTable &operator=(const ProxyTable &) = delete;
+
+  //! Use as for (auto &proxy : table.read()) or keep the view while using an
+  //! element found through it
+  View read() { return View(*this); }
+
+  uint32_t getSize() const { return SIZE; }
+
+  bool isEmpty() {
+    Lock lock(m_mutex);
+    return m_numElements == 0;
+  }
+
+  uint32_t getNumElements() {
+    Lock lock(m_mutex);
+    return m_numElements;
+  }
+
+  bool add(const TYPE &data) {
+    Lock lock(m_mutex);
+    reclaim();
+    for (uint32_t slot = 0; slot < SIZE; ++slot) {
+      if (!isBitSet(m_liveMap, slot) && !isBitSet(m_retiredMap, slot)) {
+        // Published by the mutex, views copy the live map under it
+        m_data[slot] = data;
+        setBit(m_liveMap, slot);
+        ++m_numElements;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Same usage as MemoryPool::remove. The slot is retired, not freed, so views
+   * taken earlier keep a valid element.
+   */
+  bool remove(bool (*jumppad)(void *, const TYPE &data),
+              void *isCorrectElement) {
+    Lock lock(m_mutex);
+    for (uint32_t slot = 0; slot < SIZE; ++slot) {
+      if (isBitSet(m_liveMap, slot) &&
+          jumppad(isCorrectElement, m_data[slot])) {
+        clearBit(m_liveMap, slot);
+        setBit(m_retiredMap, slot);
+        m_retiredEpoch[slot] = m_epoch;
+        ++m_numRetired;
+        --m_numElements;
+        reclaim();
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  sys_mutex_t m_mutex;
+  TYPE m_data[SIZE];
+  uint8_t m_liveMap[SIZE / 8 + 1]{};
+  uint8_t m_retiredMap[SIZE / 8 + 1]{};
+  uint32_t m_retiredEpoch[SIZE]{};
+  uint32_t m_numElements = 0;
+  uint32_t m_numRetired = 0;
+  // Views register in the counter of their epoch's parity. The epoch only
+  // advances once the other parity is drained, so two advances after a
+  // removal no view from before the removal is left.
+  uint32_t m_epoch = 0;
+  uint32_t m_readers[2]{};
+
+  static bool isBitSet(const uint8_t *map, uint32_t slot) {
+    return (map[slot / 8] & (1 << (slot % 8))) != 0;
+  }
+  static void setBit(uint8_t *map, uint32_t slot) {
+    map[slot / 8] |= static_cast<uint8_t>(1 << (slot % 8));
+  }
+  static void clearBit(uint8_t *map, uint32_t slot) {
+    map[slot / 8] &= static_cast<uint8_t>(~(1 << (slot % 8)));
+  }
+
+  //! Requires m_mutex
+  void reclaim() {
+    if (m_numRetired == 0) {
+      return;
+    }
+    while (m_readers[(m_epoch + 1) % 2] == 0) {
+      ++m_epoch;
+      bool pending = false;
+      for (uint32_t slot = 0; slot < SIZE; ++slot) {
+        if (!isBitSet(m_retiredMap, slot)) {
+          continue;
+        }
+        if (m_epoch - m_retiredEpoch[slot] >= 2) {
+          clearBit(m_retiredMap, slot);
+          --m_numRetired;
+        } else {
+          pending = true;
+        }
+      }
+      if (!pending) {
+        return;
+      }
+    }
+  }
+};
+
+} // namespace rtps
+
+#endif // RTPS_PROXYTABLE_H
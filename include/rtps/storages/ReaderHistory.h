@@ -0,0 +1,97 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_READERHISTORY_H
+#define RTPS_READERHISTORY_H
+
+#include "lwip/sys.h"
+#include "rtps/common/types.h"
+#include "rtps/config.h"
+#include "rtps/storages/PBufWrapper.h"
+
+namespace rtps {
+
+//! Sample handed out by take()/read(). Holds a reference to the packet it
+//! was received in, so data stays valid as long as the sample exists.
+struct ReaderSample {
+  ChangeKind_t kind = ChangeKind_t::INVALID;
+  Guid writerGuid{GUIDPREFIX_UNKNOWN, ENTITYID_UNKNOWN};
+  SequenceNumber_t sn{0, 0};
+  PBufWrapper packet;
+  const uint8_t *data = nullptr;
+  DataSize_t size = 0;
+
+  const uint8_t *getData() const { return data; }
+  DataSize_t getDataSize() const { return size; }
+};
+
+/**
+ * Bounded receive history of a reader. The reader thread adds samples, the
+ * application drains them with take() or read() on its own thread. Samples
+ * are kept by reference to their pbuf instead of being copied.
+ */
+class ReaderHistory {
+public:
+  ReaderHistory() = default;
+  ~ReaderHistory();
+  ReaderHistory(const ReaderHistory &) = delete;
+  ReaderHistory &operator=(const ReaderHistory &) = delete;
+
+  //! depth has to be in [1, Config::READER_HISTORY_SIZE]
+  bool init(HistoryKind_t kind, uint8_t depth);
+  bool isEnabled() const { return m_depth != 0; }
+
+  //! KEEP_LAST drops the oldest sample if the history is full, KEEP_ALL
+  //! rejects the new one and returns false.
+  bool add(ChangeKind_t kind, const Guid &writerGuid,
+           const SequenceNumber_t &sn, pbuf *packet, const uint8_t *data,
+           DataSize_t size);
+
+  //! Moves up to maxSamples of the oldest samples into samples
+  uint32_t take(ReaderSample *samples, uint32_t maxSamples);
+  //! Like take() but the samples stay in the history
+  uint32_t read(ReaderSample *samples, uint32_t maxSamples);
+  uint32_t getNumSamples();
+  //! True once after a sample was added to the empty history, i.e. whoever
+  //! drains it has to be woken up
+  bool takeWakeup();
+
+private:
+  sys_mutex_t m_mutex;
+  HistoryKind_t m_kind = HistoryKind_t::KEEP_LAST;
+  uint8_t m_depth = 0;
+  uint8_t m_head = 0;
+  uint8_t m_numSamples = 0;
+  bool m_wakeup = false;
+  std::array<ReaderSample, Config::READER_HISTORY_SIZE> m_samples{};
+
+  uint8_t slotOf(uint8_t index) const {
+    return static_cast<uint8_t>((m_head + index) % m_depth);
+  }
+};
+
+} // namespace rtps
+
+#endif // RTPS_READERHISTORY_H
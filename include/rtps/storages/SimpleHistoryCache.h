@@ -40,6 +40,9 @@ namespace rtps {
 
 class SimpleHistoryCache {
 public:
+  //! Every change owns its pbufs, messages may chain them without copy
+  static constexpr bool PAYLOADS_IN_PLACE = false;
+
   SimpleHistoryCache() = default;
 
   bool isFull() const;
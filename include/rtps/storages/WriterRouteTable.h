@@ -0,0 +1,79 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#ifndef RTPS_WRITERROUTETABLE_H
+#define RTPS_WRITERROUTETABLE_H
+
+#include "lwip/sys.h"
+#include "rtps/common/types.h"
+#include "rtps/config.h"
+
+#include <array>
+
+namespace rtps {
+
+class Reader;
+
+/**
+ * Maps a remote writer to the local readers it was matched with. DATA that a
+ * writer sends to ENTITYID_UNKNOWN is delivered to all of them. Routes are
+ * dropped with the remote participant, SEDP does not unmatch single writers.
+ *
+ * Matching runs on the discovery thread while the receive threads look up
+ * routes, so both take the table's mutex. Readers are never removed from a
+ * participant, the pointers handed out stay valid.
+ */
+class WriterRouteTable {
+public:
+  using ReaderList =
+      std::array<Reader *, Config::NUM_READERS_PER_PARTICIPANT>;
+
+  WriterRouteTable();
+  ~WriterRouteTable();
+  WriterRouteTable(const WriterRouteTable &) = delete;
+  WriterRouteTable &operator=(const WriterRouteTable &) = delete;
+
+  //! Adding a reader twice is not an error
+  bool add(const Guid &writerGuid, Reader *reader);
+  //! Copies the readers matched with writerGuid and returns their number
+  uint8_t find(const Guid &writerGuid, ReaderList &readers);
+  void removeParticipant(const GuidPrefix_t &prefix);
+
+private:
+  struct Route {
+    Guid writerGuid{GUIDPREFIX_UNKNOWN, ENTITYID_UNKNOWN};
+    ReaderList readers{};
+    uint8_t numReaders = 0;
+  };
+
+  sys_mutex_t m_mutex;
+  std::array<Route, Config::NUM_WRITER_ROUTES_PER_PARTICIPANT> m_routes{};
+
+  Route *findRoute(const Guid &writerGuid);
+};
+
+} // namespace rtps
+
+#endif // RTPS_WRITERROUTETABLE_H
@@ -0,0 +1,111 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#ifndef RTPS_FLOWCONTROLLER_H
+#define RTPS_FLOWCONTROLLER_H
+
+#include "lwip/sys.h"
+
+#include <cstdint>
+
+namespace rtps {
+
+/**
+ * Token bucket limiting the bytes a writer puts on the wire. The bucket
+ * refills by bytesPerPeriod every periodMs and holds at most maxBurst bytes.
+ * Not thread-safe, the owning writer guards it with its mutex.
+ */
+class FlowController {
+public:
+  //! bytesPerPeriod 0 disables flow control
+  void configure(uint32_t bytesPerPeriod, uint32_t periodMs,
+                 uint32_t maxBurst) {
+    m_bytesPerPeriod = bytesPerPeriod;
+    m_periodMs = periodMs != 0 ? periodMs : 1;
+    m_maxBurst = maxBurst;
+    m_tokens = static_cast<int32_t>(maxBurst);
+    m_lastRefillMs = sys_now();
+  }
+
+  bool isEnabled() const { return m_bytesPerPeriod != 0; }
+
+  //! Takes size bytes from the bucket if they may be sent now. Samples larger
+  //! than maxBurst go out on a full bucket and leave it in debt.
+  bool tryConsume(uint32_t size) {
+    if (!isEnabled()) {
+      return true;
+    }
+    refill();
+    if (m_tokens < getNeeded(size)) {
+      return false;
+    }
+    m_tokens -= static_cast<int32_t>(size);
+    return true;
+  }
+
+  //! Time until tryConsume(size) succeeds, at least 1 ms while throttled
+  uint32_t getWaitMs(uint32_t size) {
+    if (!isEnabled()) {
+      return 0;
+    }
+    refill();
+    const int32_t needed = getNeeded(size);
+    if (needed <= m_tokens) {
+      return 0;
+    }
+    const uint64_t missing = static_cast<uint64_t>(needed - m_tokens);
+    return static_cast<uint32_t>(
+        (missing * m_periodMs + m_bytesPerPeriod - 1) / m_bytesPerPeriod);
+  }
+
+private:
+  uint32_t m_bytesPerPeriod = 0;
+  uint32_t m_periodMs = 1;
+  uint32_t m_maxBurst = 0;
+  int32_t m_tokens = 0;
+  uint32_t m_lastRefillMs = 0;
+
+  int32_t getNeeded(uint32_t size) const {
+    return static_cast<int32_t>(size < m_maxBurst ? size : m_maxBurst);
+  }
+
+  void refill() {
+    const uint32_t nowMs = sys_now();
+    const uint64_t credit = static_cast<uint64_t>(nowMs - m_lastRefillMs) *
+                            m_bytesPerPeriod / m_periodMs;
+    if (credit == 0) {
+      return; // Keep accumulating time for slow rates
+    }
+    m_lastRefillMs = nowMs;
+    const int64_t filled = static_cast<int64_t>(m_tokens) +
+                           static_cast<int64_t>(credit);
+    m_tokens = filled > static_cast<int64_t>(m_maxBurst)
+                   ? static_cast<int32_t>(m_maxBurst)
+                   : static_cast<int32_t>(filled);
+  }
+};
+
+} // namespace rtps
+
+#endif // RTPS_FLOWCONTROLLER_H
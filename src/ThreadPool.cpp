@@ -25,25 +25,36 @@ Author: i11 - Embedded Software, RWTH Aachen University
 #include "rtps/ThreadPool.h"
 
 #include "lwip/tcpip.h"
+#include "rtps/entities/Reader.h"
 #include "rtps/entities/Writer.h"
+#include "rtps/utils/Lock.h"
 #include "rtps/utils/udpUtils.h"
 
 using rtps::ThreadPool;
 
 #define THREAD_POOL_VERBOSE 0
 
-ThreadPool::ThreadPool(receiveJumppad_fp receiveCallback, void *callee)
-    : m_receiveJumppad(receiveCallback), m_callee(callee) {
+ThreadPool::ThreadPool(receiveJumppad_fp receiveCallback, void *callee,
+                       dropFilter_fp dropFilter, flushJumppad_fp flushCallback)
+    : m_receiveJumppad(receiveCallback), m_dropFilter(dropFilter),
+      m_flushJumppad(flushCallback), m_callee(callee) {
 
-  if (!m_queueOutgoing.init() || !m_queueIncoming.init()) {
+  if (!m_queueOutgoing.init() || !m_queueIncoming.init() ||
+      !m_queueCallbacks.init() ||
+      sys_mutex_new(&m_delayedMutex) != ERR_OK) {
     return;
   }
-  err_t inputErr = sys_sem_new(&m_readerNotificationSem, 0);
-  err_t outputErr = sys_sem_new(&m_writerNotificationSem, 0);
+  // startThreads() refuses to start without all semaphores
+  const bool semsCreated =
+      sys_sem_new(&m_readerNotificationSem, 0) == ERR_OK &&
+      sys_sem_new(&m_writerNotificationSem, 0) == ERR_OK &&
+      sys_sem_new(&m_callbackNotificationSem, 0) == ERR_OK;
 #if THREAD_POOL_VERBOSE
-  if (inputErr != ERR_OK || outputErr != ERR_OK) {
+  if (!semsCreated) {
     printf("ThreadPool: Failed to create Semaphores.\n");
   }
+#else
+  (void)semsCreated;
 #endif
 }
 
@@ -59,6 +70,12 @@ ThreadPool::~ThreadPool() {
   if (sys_sem_valid(&m_writerNotificationSem)) {
     sys_sem_free(&m_writerNotificationSem);
   }
+  if (sys_sem_valid(&m_callbackNotificationSem)) {
+    sys_sem_free(&m_callbackNotificationSem);
+  }
+  if (sys_mutex_valid(&m_delayedMutex)) {
+    sys_mutex_free(&m_delayedMutex);
+  }
 }
 
 bool ThreadPool::startThreads() {
@@ -66,7 +83,8 @@ bool ThreadPool::startThreads() {
     return true;
   }
   if (!sys_sem_valid(&m_readerNotificationSem) ||
-      !sys_sem_valid(&m_writerNotificationSem)) {
+      !sys_sem_valid(&m_writerNotificationSem) ||
+      !sys_sem_valid(&m_callbackNotificationSem)) {
     return false;
   }
 
@@ -96,6 +114,18 @@ bool ThreadPool::startThreads() {
                             Config::THREAD_POOL_READER_PRIO);
     #endif
   }
+
+  for (auto &thread : m_callbackThreads) {
+    #ifdef MROS2_USE_EMBEDDEDRTPS
+    thread = sys_thread_new("CallbackThread", callCallbackThreadFunction, this,
+                            Config::THREAD_POOL_CALLBACK_STACKSIZE,
+                            Config::THREAD_POOL_CALLBACK_PRIO);
+    #else
+    thread = sys_thread_new("CallbackThread", callbackThreadFunction, this,
+                            Config::THREAD_POOL_CALLBACK_STACKSIZE,
+                            Config::THREAD_POOL_CALLBACK_PRIO);
+    #endif
+  }
   return true;
 }
 
@@ -109,6 +139,7 @@ void ThreadPool::stopThreads() {
 void ThreadPool::clearQueues() {
   m_queueOutgoing.clear();
   m_queueIncoming.clear();
+  m_queueCallbacks.clear();
 }
 
 bool ThreadPool::addWorkload(Writer *workload) {
@@ -120,6 +151,59 @@ bool ThreadPool::addWorkload(Writer *workload) {
   return res;
 }
 
+bool ThreadPool::addWorkload(Writer *workload, uint32_t delayMs) {
+  const uint32_t dueMs = sys_now() + delayMs;
+  {
+    Lock lock(m_delayedMutex);
+    DelayedWorkload *freeSlot = nullptr;
+    for (auto &delayed : m_delayed) {
+      if (delayed.workload == workload) {
+        if (static_cast<int32_t>(dueMs - delayed.dueMs) < 0) {
+          delayed.dueMs = dueMs;
+        }
+        freeSlot = &delayed;
+        break;
+      }
+      if (delayed.workload == nullptr && freeSlot == nullptr) {
+        freeSlot = &delayed;
+      }
+    }
+    if (freeSlot == nullptr) {
+      return false;
+    }
+    if (freeSlot->workload == nullptr) {
+      freeSlot->workload = workload;
+      freeSlot->dueMs = dueMs;
+    }
+  }
+  // A waiting writer thread recomputes its timeout
+  sys_sem_signal(&m_writerNotificationSem);
+  return true;
+}
+
+uint32_t ThreadPool::queueDueWorkloads() {
+  Lock lock(m_delayedMutex);
+  const uint32_t nowMs = sys_now();
+  uint32_t nextDueMs = 0;
+  for (auto &delayed : m_delayed) {
+    if (delayed.workload == nullptr) {
+      continue;
+    }
+    const auto remainingMs = static_cast<int32_t>(delayed.dueMs - nowMs);
+    if (remainingMs <= 0 && addWorkload(delayed.workload)) {
+      delayed.workload = nullptr;
+      continue;
+    }
+    // Retried shortly if the queue was full
+    const uint32_t waitMs =
+        remainingMs <= 0 ? 1 : static_cast<uint32_t>(remainingMs);
+    if (nextDueMs == 0 || waitMs < nextDueMs) {
+      nextDueMs = waitMs;
+    }
+  }
+  return nextDueMs;
+}
+
 bool ThreadPool::addNewPacket(PacketInfo &&packet) {
   bool res = m_queueIncoming.moveElementIntoBuffer(std::move(packet));
   if (res) {
@@ -128,6 +212,17 @@ bool ThreadPool::addNewPacket(PacketInfo &&packet) {
   return res;
 }
 
+bool ThreadPool::addCallbackWork(Reader *reader) {
+  if (!hasCallbackThreads()) {
+    return false;
+  }
+  bool res = m_queueCallbacks.moveElementIntoBuffer(std::move(reader));
+  if (res) {
+    sys_sem_signal(&m_callbackNotificationSem);
+  }
+  return res;
+}
+
 void ThreadPool::writerThreadFunction(void *arg) {
   auto pool = static_cast<ThreadPool *>(arg);
   if (pool == nullptr) {
@@ -142,10 +237,20 @@ void ThreadPool::writerThreadFunction(void *arg) {
 
 void ThreadPool::doWriterWork() {
   while (m_running) {
+    const uint32_t nextDelayedMs = queueDueWorkloads();
     Writer *workload;
     auto isWorkToDo = m_queueOutgoing.moveFirstInto(workload);
     if (!isWorkToDo) {
-      sys_sem_wait(&m_writerNotificationSem);
+      uint32_t waitMs =
+          m_flushJumppad != nullptr ? m_flushJumppad(m_callee) : 0;
+      if (nextDelayedMs != 0 && (waitMs == 0 || nextDelayedMs < waitMs)) {
+        waitMs = nextDelayedMs;
+      }
+      if (waitMs == 0) {
+        sys_sem_wait(&m_writerNotificationSem);
+      } else {
+        sys_arch_sem_wait(&m_writerNotificationSem, waitMs);
+      }
       continue;
     }
 
@@ -157,6 +262,13 @@ void ThreadPool::readCallback(void *args, udp_pcb *target, pbuf *pbuf,
                               const ip_addr_t * /*addr*/, Ip4Port_t port) {
   auto &pool = *static_cast<ThreadPool *>(args);
 
+  // Checked before the packet takes a queue slot and wakes up a reader
+  if (pool.m_dropFilter != nullptr &&
+      pool.m_dropFilter(pool.m_callee, target->local_port, pbuf)) {
+    pbuf_free(pbuf);
+    return;
+  }
+
   PacketInfo packet;
   packet.destAddr = {0}; // not relevant
   packet.destPort = target->local_port;
@@ -169,6 +281,11 @@ void ThreadPool::readCallback(void *args, udp_pcb *target, pbuf *pbuf,
   }
 }
 
+void ThreadPool::flushRequestCallback(void *arg) {
+  auto &pool = *static_cast<ThreadPool *>(arg);
+  sys_sem_signal(&pool.m_writerNotificationSem);
+}
+
 void ThreadPool::readerThreadFunction(void *arg) {
   auto pool = static_cast<ThreadPool *>(arg);
   if (pool == nullptr) {
@@ -194,6 +311,30 @@ void ThreadPool::doReaderWork() {
   }
 }
 
+void ThreadPool::callbackThreadFunction(void *arg) {
+  auto pool = static_cast<ThreadPool *>(arg);
+  if (pool == nullptr) {
+#if THREAD_POOL_VERBOSE
+    printf("nullptr passed to callback function\n");
+#endif
+    return;
+  }
+  pool->doCallbackWork();
+}
+
+void ThreadPool::doCallbackWork() {
+  while (m_running) {
+    Reader *reader;
+    auto isWorkToDo = m_queueCallbacks.moveFirstInto(reader);
+    if (!isWorkToDo) {
+      sys_sem_wait(&m_callbackNotificationSem);
+      continue;
+    }
+
+    reader->executeCallbacks();
+  }
+}
+
 void callWriterThreadFunction(void *arg){
 	ThreadPool::writerThreadFunction(arg);
 }
@@ -202,4 +343,8 @@ void callReaderThreadFunction(void *arg){
 	ThreadPool::readerThreadFunction(arg);
 }
 
+void callCallbackThreadFunction(void *arg){
+	ThreadPool::callbackThreadFunction(arg);
+}
+
 #undef THREAD_POOL_VERBOSE
@@ -0,0 +1,293 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#include "rtps/communication/MessageAggregator.h"
+#include "rtps/messages/MessageFactory.h"
+#include "rtps/messages/MessageTypes.h"
+#include "rtps/utils/Lock.h"
+
+using rtps::MessageAggregator;
+
+#define AGGREGATOR_VERBOSE 0
+
+#if AGGREGATOR_VERBOSE
+#include "rtps/utils/printutils.h"
+#endif
+
+MessageAggregator::MessageAggregator(send_fp send, void *callee)
+    : m_send(send), m_callee(callee) {
+  if (sys_mutex_new(&m_mutex) != ERR_OK) {
+#if AGGREGATOR_VERBOSE
+    printf("MessageAggregator: Failed to create mutex\n");
+#endif
+  }
+}
+
+MessageAggregator::~MessageAggregator() { sys_mutex_free(&m_mutex); }
+
+bool MessageAggregator::add(PacketInfo &packet) {
+  constexpr uint16_t prefixPos = Header::getRawSize() - sizeof(GuidPrefix_t);
+  GuidPrefix_t prefix;
+  if (packet.buffer.spaceUsed() <= Header::getRawSize() ||
+      pbuf_copy_partial(packet.buffer.firstElement, prefix.id.data(),
+                        prefix.id.size(), prefixPos) != prefix.id.size()) {
+    send(packet);
+    return false;
+  }
+
+  // Sent ahead of packet, so one destination sees the messages in order
+  PacketInfo full;
+  bool isStarted = false;
+  bool isQueued = false;
+  {
+    Lock lock{m_mutex};
+    Batch *batch = findBatch(packet, prefix);
+    if (batch != nullptr && !append(*batch, packet)) {
+      full = std::move(batch->packet);
+      batch->isUsed = false;
+      batch = nullptr;
+    }
+    if (batch != nullptr) {
+      isQueued = true;
+    } else if (packet.buffer.spaceUsed() <
+               Config::SEND_AGGREGATION_MAX_MESSAGE_SIZE) {
+      batch = findFreeBatch();
+      if (batch != nullptr) {
+        batch->packet.copyTriviallyCopyable(packet);
+        batch->packet.buffer = PBufWrapper{};
+        if (batch->packet.buffer.appendCopy(packet.buffer)) {
+          batch->prefix = prefix;
+          batch->startMs = sys_now();
+          batch->isUsed = true;
+          batch->isClosed =
+              !alignEnd(batch->packet.buffer, Header::getRawSize());
+          isStarted = isQueued = true;
+        }
+      }
+    }
+  }
+
+  if (full.buffer.isValid()) {
+    send(full);
+  }
+  if (!isQueued) {
+#if AGGREGATOR_VERBOSE
+    printf("MessageAggregator: Sending message of %u bytes on its own\n",
+           packet.buffer.spaceUsed());
+#endif
+    send(packet);
+  }
+  return isStarted;
+}
+
+void MessageAggregator::flush() {
+  std::array<PacketInfo, Config::SEND_AGGREGATION_NUM_DESTINATIONS> ready;
+  {
+    Lock lock{m_mutex};
+    for (uint8_t i = 0; i < m_batches.size(); ++i) {
+      if (m_batches[i].isUsed) {
+        ready[i] = std::move(m_batches[i].packet);
+        m_batches[i].isUsed = false;
+      }
+    }
+  }
+  for (auto &packet : ready) {
+    if (packet.buffer.isValid()) {
+      send(packet);
+    }
+  }
+}
+
+uint32_t MessageAggregator::flushDue() {
+  std::array<PacketInfo, Config::SEND_AGGREGATION_NUM_DESTINATIONS> ready;
+  uint32_t nextDueMs = 0;
+  {
+    Lock lock{m_mutex};
+    const uint32_t now = sys_now();
+    for (uint8_t i = 0; i < m_batches.size(); ++i) {
+      Batch &batch = m_batches[i];
+      if (!batch.isUsed) {
+        continue;
+      }
+      const uint32_t waitedMs = now - batch.startMs;
+      if (waitedMs >= Config::SEND_AGGREGATION_LATENCY_MS) {
+        ready[i] = std::move(batch.packet);
+        batch.isUsed = false;
+      } else {
+        const uint32_t dueMs = Config::SEND_AGGREGATION_LATENCY_MS - waitedMs;
+        if (nextDueMs == 0 || dueMs < nextDueMs) {
+          nextDueMs = dueMs;
+        }
+      }
+    }
+  }
+  for (auto &packet : ready) {
+    if (packet.buffer.isValid()) {
+      send(packet);
+    }
+  }
+  return nextDueMs;
+}
+
+MessageAggregator::Batch *
+MessageAggregator::findBatch(const PacketInfo &packet,
+                             const GuidPrefix_t &prefix) {
+  for (auto &batch : m_batches) {
+    if (batch.isUsed && batch.packet.srcPort == packet.srcPort &&
+        batch.packet.destPort == packet.destPort &&
+        ip4_addr_cmp(&batch.packet.destAddr, &packet.destAddr) &&
+        batch.prefix == prefix) {
+      return &batch;
+    }
+  }
+  return nullptr;
+}
+
+MessageAggregator::Batch *MessageAggregator::findFreeBatch() {
+  for (auto &batch : m_batches) {
+    if (!batch.isUsed) {
+      return &batch;
+    }
+  }
+  return nullptr;
+}
+
+bool MessageAggregator::append(Batch &batch, const PacketInfo &packet) {
+  if (batch.isClosed) {
+    return false;
+  }
+  const DataSize_t submessagesSize =
+      packet.buffer.spaceUsed() - Header::getRawSize();
+  uint8_t firstKind = 0;
+  pbuf_copy_partial(packet.buffer.firstElement, &firstKind, 1,
+                    Header::getRawSize());
+  // INFO_DST of an earlier message would still apply, reset it to everyone
+  const bool needsDestination =
+      firstKind != static_cast<uint8_t>(SubmessageKind::INFO_DST);
+  const uint32_t addedSize =
+      submessagesSize +
+      (needsDestination ? SubmessageInfoDst::getRawSize() : 0) +
+      MessageFactory::getPadding(submessagesSize);
+  if (batch.packet.buffer.spaceUsed() + addedSize >
+      Config::SEND_AGGREGATION_MAX_MESSAGE_SIZE) {
+    return false;
+  }
+
+  if (needsDestination) {
+    MessageFactory::addSubMessageDestination(batch.packet.buffer);
+  }
+  const DataSize_t start = batch.packet.buffer.spaceUsed();
+  if (!batch.packet.buffer.appendCopy(packet.buffer, Header::getRawSize(),
+                                      submessagesSize)) {
+    return false;
+  }
+  batch.isClosed = !alignEnd(batch.packet.buffer, start);
+  return true;
+}
+
+namespace {
+uint16_t readUint16(const pbuf *p, uint16_t offset, bool isLittleEndian) {
+  uint8_t bytes[2] = {0, 0};
+  pbuf_copy_partial(p, bytes, sizeof(bytes), offset);
+  return isLittleEndian ? (bytes[0] | bytes[1] << 8)
+                        : (bytes[0] << 8 | bytes[1]);
+}
+
+void writeUint16(pbuf *p, uint16_t offset, uint16_t value,
+                 bool isLittleEndian) {
+  const uint8_t low = static_cast<uint8_t>(value);
+  const uint8_t high = static_cast<uint8_t>(value >> 8);
+  const uint8_t bytes[2] = {isLittleEndian ? low : high,
+                            isLittleEndian ? high : low};
+  pbuf_take_at(p, bytes, sizeof(bytes), offset);
+}
+} // namespace
+
+bool MessageAggregator::alignEnd(PBufWrapper &buffer, DataSize_t start) {
+  const DataSize_t end = buffer.spaceUsed();
+  constexpr uint16_t headerSize = SubmessageHeader::getRawSize();
+
+  // Find the last submessage
+  DataSize_t last = start;
+  std::array<uint8_t, headerSize> header{};
+  for (DataSize_t pos = start; pos + headerSize <= end;) {
+    pbuf_copy_partial(buffer.firstElement, header.data(), headerSize, pos);
+    const uint16_t length = readUint16(buffer.firstElement, pos + 2,
+                                       (header[1] & FLAG_LITTLE_ENDIAN) != 0);
+    last = pos;
+    if (length == 0 &&
+        header[0] != static_cast<uint8_t>(SubmessageKind::PAD) &&
+        header[0] != static_cast<uint8_t>(SubmessageKind::INFO_TS)) {
+      break; // Extends to the end of the message
+    }
+    pos += headerSize + length;
+  }
+  if (last + headerSize > end) {
+    return true; // Nothing copied
+  }
+  pbuf_copy_partial(buffer.firstElement, header.data(), headerSize, last);
+  const bool isLittleEndian = (header[1] & FLAG_LITTLE_ENDIAN) != 0;
+  const uint16_t length = readUint16(buffer.firstElement, last + 2,
+                                     isLittleEndian);
+  const DataSize_t bodySize = end - last - headerSize;
+  const uint8_t padding = MessageFactory::getPadding(end);
+  if (padding == 0 && length == bodySize) {
+    return true;
+  }
+
+  if (padding != 0 &&
+      header[0] == static_cast<uint8_t>(SubmessageKind::DATA) &&
+      (header[1] & FLAG_DATA_PAYLOAD) != 0) {
+    // Padding is only stripped from a sample if its encapsulation records it
+    if ((header[1] & FLAG_INLINE_QOS) != 0) {
+      return false;
+    }
+    const DataSize_t payloadPos =
+        last + headerSize + 4 +
+        readUint16(buffer.firstElement, last + headerSize + 2, isLittleEndian);
+    std::array<uint8_t, SMElement::ENCAPSULATION_HEADER_SIZE> encapsulation{};
+    if (payloadPos + encapsulation.size() > end ||
+        pbuf_copy_partial(buffer.firstElement, encapsulation.data(),
+                          encapsulation.size(),
+                          payloadPos) != encapsulation.size() ||
+        !SMElement::isEncapsulationHeader(encapsulation.data()) ||
+        (encapsulation[3] & SMElement::ENCAPSULATION_PADDING_MASK) != 0) {
+      return false;
+    }
+    encapsulation[3] |= padding;
+    pbuf_take_at(buffer.firstElement, &encapsulation[3], 1, payloadPos + 3);
+  }
+  // Other submessages, DATA_FRAG included, know where their content ends
+
+  MessageFactory::addPadding(buffer, padding);
+  if (buffer.spaceUsed() != end + padding) {
+    return false;
+  }
+  writeUint16(buffer.firstElement, last + 2, bodySize + padding,
+              isLittleEndian);
+  return true;
+}
+
+#undef AGGREGATOR_VERBOSE
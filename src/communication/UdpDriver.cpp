@@ -32,8 +32,10 @@ using rtps::UdpDriver;
 
 #define UDP_DRIVER_VERBOSE 0
 
-UdpDriver::UdpDriver(rtps::UdpDriver::udpRxFunc_fp callback, void *args)
-    : m_rxCallback(callback), m_callbackArgs(args) {}
+UdpDriver::UdpDriver(rtps::UdpDriver::udpRxFunc_fp callback, void *args,
+                     flushRequest_fp flushRequest)
+    : m_rxCallback(callback), m_callbackArgs(args),
+      m_flushRequest(flushRequest), m_aggregator(sendJumppad, this) {}
 
 const rtps::UdpConnection *
 UdpDriver::createUdpConnection(Ip4Port_t receivePort) {
@@ -95,35 +97,79 @@ bool UdpDriver::joinMultiCastGroup(ip4_addr_t addr) const {
   return true;
 }
 
-bool UdpDriver::sendPacket(const UdpConnection &conn, ip4_addr_t &destAddr,
-                           Ip4Port_t destPort, pbuf &buffer) {
-  err_t err;
-  {
-    TcpipCoreLock lock;
-    err = udp_sendto(conn.pcb, &buffer, &destAddr, destPort);
-  }
+bool UdpDriver::sendLocked(const UdpConnection &conn, PacketInfo &packet) {
+  err_t err = udp_sendto(conn.pcb, packet.buffer.firstElement,
+                         &packet.destAddr, packet.destPort);
 
   if (err != ERR_OK) {
     ;
 #if UDP_DRIVER_VERBOSE
     printf("UDP TRANSMIT NOT SUCCESSFUL %s:%u size: %u err: %i\n",
-           ipaddr_ntoa(&destAddr), destPort, buffer.tot_len, err);
+           ipaddr_ntoa(&packet.destAddr), packet.destPort,
+           packet.buffer.firstElement->tot_len, err);
 #endif
     return false;
   }
   return true;
 }
 
-void UdpDriver::sendPacket(PacketInfo &packet) {
-  auto p_conn = createUdpConnection(packet.srcPort);
-  if (p_conn == nullptr) {
-    ;
+const rtps::UdpConnection *UdpDriver::resolveConnection(PacketInfo &packet) {
+  if (packet.conn == nullptr) {
+    packet.conn = createUdpConnection(packet.srcPort);
+  }
 #if UDP_DRIVER_VERBOSE
+  if (packet.conn == nullptr) {
     printf("Failed to create connection on port %u \n", packet.srcPort);
+  }
 #endif
+  return packet.conn;
+}
+
+void UdpDriver::sendPacket(PacketInfo &packet) {
+  if (!MessageAggregator::isEnabled()) {
+    sendPacketNow(packet);
     return;
   }
+  if (m_aggregator.add(packet) && m_flushRequest != nullptr) {
+    m_flushRequest(m_callbackArgs);
+  }
+}
+
+void UdpDriver::flush() { m_aggregator.flush(); }
 
-  sendPacket(*p_conn, packet.destAddr, packet.destPort,
-             *packet.buffer.firstElement);
+uint32_t UdpDriver::flushDue() { return m_aggregator.flushDue(); }
+
+void UdpDriver::sendJumppad(void *callee, PacketInfo &packet) {
+  static_cast<UdpDriver *>(callee)->sendPacketNow(packet);
+}
+
+void UdpDriver::sendPacketNow(PacketInfo &packet) {
+  auto p_conn = resolveConnection(packet);
+  if (p_conn == nullptr) {
+    return;
+  }
+
+  TcpipCoreLock lock;
+  sendLocked(*p_conn, packet);
+}
+
+void UdpDriver::sendPackets(PacketInfo *packets, uint8_t numPackets) {
+  if (MessageAggregator::isEnabled()) {
+    for (uint8_t i = 0; i < numPackets; ++i) {
+      sendPacket(packets[i]);
+    }
+    return;
+  }
+
+  // Creating a connection takes the core lock itself
+  for (uint8_t i = 0; i < numPackets; ++i) {
+    resolveConnection(packets[i]);
+  }
+
+  TcpipCoreLock lock;
+  for (uint8_t i = 0; i < numPackets; ++i) {
+    if (packets[i].conn != nullptr) {
+      sendLocked(*packets[i].conn, packets[i]);
+    }
+  }
 }
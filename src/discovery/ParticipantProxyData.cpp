@@ -32,6 +32,7 @@ void ParticipantProxyData::reset() {
   m_guid = Guid{GUIDPREFIX_UNKNOWN, ENTITYID_UNKNOWN};
   m_manualLivelinessCount = Count_t{1};
   m_expectsInlineQos = false;
+  m_leaseDuration = Config::SPDP_LEASE_DURATION;
   for (int i = 0; i < Config::SPDP_MAX_NUM_LOCATORS; ++i) {
     m_metatrafficUnicastLocatorList[i].setInvalid();
     m_metatrafficMulticastLocatorList[i].setInvalid();
@@ -40,6 +41,18 @@ void ParticipantProxyData::reset() {
   }
 }
 
+bool ParticipantProxyData::isLeaseExpired(uint32_t nowMs) const {
+  constexpr int32_t infiniteSeconds = 0x7fffffff;
+  if (m_leaseDuration.seconds == infiniteSeconds) {
+    return false;
+  }
+  const uint64_t seconds =
+      m_leaseDuration.seconds < 0 ? 0 : uint64_t(m_leaseDuration.seconds);
+  const uint64_t leaseMs =
+      seconds * 1000 + ((uint64_t(m_leaseDuration.fraction) * 1000) >> 32);
+  return nowMs - m_lastAnnouncementMs > leaseMs;
+}
+
 bool ParticipantProxyData::readFromUcdrBuffer(ucdrBuffer &buffer) {
   reset();
   SMElement::ParameterId pid;
@@ -124,8 +124,9 @@ void SEDPAgent::onNewPublisher(const TopicData &writerData) {
 #if SEDP_VERBOSE
   SEDP_LOG("PUB T/D %s/%s", writerData.topicName, writerData.typeName);
 #endif
-  Reader *reader = m_part->getMatchingReader(writerData);
-  if (reader == nullptr) {
+  WriterRouteTable::ReaderList readers;
+  const uint8_t numReaders = m_part->getMatchingReaders(writerData, readers);
+  if (numReaders == 0) {
 #if SEDP_VERBOSE
     SEDP_LOG("SEDPAgent: Couldn't find reader for new Publisher[%s, %s]\n",
              writerData.topicName, writerData.typeName);
@@ -140,10 +141,25 @@ void SEDPAgent::onNewPublisher(const TopicData &writerData) {
   } else {
     SEDP_LOG("best-effort ");
   }
-  SEDP_LOG("publisher\n");
+  SEDP_LOG("publisher for %u readers\n", numReaders);
 #endif
-  reader->addNewMatchedWriter(
-      WriterProxy{writerData.endpointGuid, writerData.unicastLocator});
+  for (uint8_t i = 0; i < numReaders; ++i) {
+#if SEDP_VERBOSE
+    if (writerData.durabilityKind < readers[i]->m_attributes.durabilityKind) {
+      SEDP_LOG("SEDPAgent: Durability mismatch for publisher[%s]\n",
+               writerData.topicName);
+    }
+#endif
+    readers[i]->addNewMatchedWriter(
+        WriterProxy{writerData.endpointGuid, writerData.unicastLocator});
+    if (!m_part->addWriterRoute(writerData.endpointGuid, *readers[i])) {
+#if SEDP_VERBOSE
+      SEDP_LOG("SEDPAgent: No route left for publisher[%s], its multicast "
+               "data is dropped\n",
+               writerData.topicName);
+#endif
+    }
+  }
   if (mfp_onNewPublisherCallback != nullptr) {
     mfp_onNewPublisherCallback(m_onNewPublisherArgs);
   }
@@ -195,9 +211,14 @@ void SEDPAgent::onNewSubscriber(const TopicData &readerData) {
     SEDP_LOG("best-effort ");
   }
   SEDP_LOG("Subscriber\n");
+  if (writer->m_attributes.durabilityKind < readerData.durabilityKind) {
+    SEDP_LOG("SEDPAgent: Durability mismatch for subscriber[%s]\n",
+             readerData.topicName);
+  }
 #endif
   writer->addNewMatchedReader(
-      ReaderProxy{readerData.endpointGuid, readerData.unicastLocator});
+      ReaderProxy{readerData.endpointGuid, readerData.unicastLocator,
+                  readerData.multicastLocator, readerData.durabilityKind});
   if (mfp_onNewSubscriberCallback != nullptr) {
     mfp_onNewSubscriberCallback(m_onNewSubscriberArgs);
   }
@@ -89,6 +89,8 @@ void SPDPAgent::runBroadcast(void *args) {
   while (agent.m_running) {
     sys_msleep(Config::SPDP_RESEND_PERIOD_MS);
     agent.m_buildInEndpoints.spdpWriter->setAllChangesToUnsent();
+    Lock lock{agent.m_mutex};
+    agent.mp_participant->removeExpiredRemoteParticipants(sys_now());
   }
 }
 
@@ -154,9 +156,15 @@ void SPDPAgent::processProxyData() {
     return; // Our own packet
   }
 
-  if (mp_participant->findRemoteParticipant(m_proxyDataBuffer.m_guid.prefix) !=
-      nullptr) {
-    m_buildInEndpoints.spdpWriter->setAllChangesToUnsent();
+  const uint32_t now = sys_now();
+  if (mp_participant->renewRemoteParticipantLease(
+          m_proxyDataBuffer.m_guid.prefix, now)) {
+    // Two participants answering each other would keep going as soon as
+    // sending takes longer than receiving, e.g. with send aggregation
+    if (now - m_lastAnswerMs >= Config::SPDP_RESEND_PERIOD_MS / 10) {
+      m_lastAnswerMs = now;
+      m_buildInEndpoints.spdpWriter->setAllChangesToUnsent();
+    }
     return; // Already in our list
   }
 
@@ -165,6 +173,7 @@ void SPDPAgent::processProxyData() {
   //	return;
   //}
 
+  m_proxyDataBuffer.m_lastAnnouncementMs = now;
   if (mp_participant->addNewRemoteParticipant(m_proxyDataBuffer)) {
     addProxiesForBuiltInEndpoints();
     m_buildInEndpoints.spdpWriter->setAllChangesToUnsent();
@@ -217,14 +226,18 @@ bool SPDPAgent::addProxiesForBuiltInEndpoints() {
   if (m_proxyDataBuffer.hasPublicationReader()) {
     const ReaderProxy proxy{{m_proxyDataBuffer.m_guid.prefix,
                              ENTITYID_SEDP_BUILTIN_PUBLICATIONS_READER},
-                            *locator};
+                            *locator,
+                            Locator(),
+                            DurabilityKind_t::TRANSIENT_LOCAL};
     m_buildInEndpoints.sedpPubWriter->addNewMatchedReader(proxy);
   }
 
   if (m_proxyDataBuffer.hasSubscriptionReader()) {
     const ReaderProxy proxy{{m_proxyDataBuffer.m_guid.prefix,
                              ENTITYID_SEDP_BUILTIN_SUBSCRIPTIONS_READER},
-                            *locator};
+                            *locator,
+                            Locator(),
+                            DurabilityKind_t::TRANSIENT_LOCAL};
     m_buildInEndpoints.sedpSubWriter->addNewMatchedReader(proxy);
   }
 
@@ -62,6 +62,10 @@ bool TopicData::readFromUcdrBuffer(ucdrBuffer &buffer) {
       buffer.iterator += 8;
       // TODO Skip 8 bytes. don't know what they are yet
       break;
+    case ParameterId::PID_DURABILITY:
+      ucdr_deserialize_uint32_t(&buffer,
+                                reinterpret_cast<uint32_t *>(&durabilityKind));
+      break;
     case ParameterId::PID_SENTINEL:
       return true;
     case ParameterId::PID_TOPIC_NAME:
@@ -81,6 +85,12 @@ bool TopicData::readFromUcdrBuffer(ucdrBuffer &buffer) {
         unicastLocator = uLoc;
       }
       break;
+    case ParameterId::PID_MULTICAST_LOCATOR:
+      uLoc.readFromUcdrBuffer(buffer);
+      if (uLoc.isMulticast()) {
+        multicastLocator = uLoc;
+      }
+      break;
     default:
       buffer.iterator += length;
       buffer.last_data_size = 1;
@@ -103,6 +113,14 @@ bool TopicData::serializeIntoUcdrBuffer(ucdrBuffer &buffer) const {
       &buffer, reinterpret_cast<const uint8_t *>(&unicastLocator),
       sizeof(Locator));
 
+  if (multicastLocator.isValid()) {
+    ucdr_serialize_uint16_t(&buffer, ParameterId::PID_MULTICAST_LOCATOR);
+    ucdr_serialize_uint16_t(&buffer, sizeof(Locator));
+    ucdr_serialize_array_uint8_t(
+        &buffer, reinterpret_cast<const uint8_t *>(&multicastLocator),
+        sizeof(Locator));
+  }
+
   // It's a 32 bit instead of 16 because it seems like the field is padded.
   const auto lenTopicName =
       static_cast<uint32_t>(strlen(topicName) + 1); // + \0
@@ -155,6 +173,10 @@ bool TopicData::serializeIntoUcdrBuffer(ucdrBuffer &buffer) const {
                                endpointGuid.entityId.entityKey.size());
   ucdr_serialize_uint8_t(
       &buffer, static_cast<uint8_t>(endpointGuid.entityId.entityKind));
+
+  ucdr_serialize_uint16_t(&buffer, ParameterId::PID_DURABILITY);
+  ucdr_serialize_uint16_t(&buffer, sizeof(DurabilityKind_t));
+  ucdr_serialize_uint32_t(&buffer, static_cast<uint32_t>(durabilityKind));
 /*
   //TODO: check the max length
   //added: qos maxlength param
@@ -162,11 +184,6 @@ bool TopicData::serializeIntoUcdrBuffer(ucdrBuffer &buffer) const {
   ucdr_serialize_uint16_t(&buffer, 4);
   ucdr_serialize_uint32_t(&buffer, 84);
 
-  //added: qos durability param
-  ucdr_serialize_uint16_t(&buffer, ParameterId::PID_DURABILITY);
-  ucdr_serialize_uint16_t(&buffer, 4);
-  ucdr_serialize_uint32_t(&buffer, 0);
-
   //added: qos deadline param
   ucdr_serialize_uint16_t(&buffer, ParameterId::PID_DEADLINE);
   ucdr_serialize_uint16_t(&buffer, 8);
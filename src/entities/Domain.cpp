@@ -23,16 +23,21 @@ Author: i11 - Embedded Software, RWTH Aachen University
 */
 
 #include "rtps/entities/Domain.h"
+#include "rtps/messages/MessageIndex.h"
 #include "rtps/utils/Log.h"
 #include "rtps/utils/udpUtils.h"
 
+#include <cstdio>
+#include <cstring>
+
 #define DOMAIN_VERBOSE 0
 
 using rtps::Domain;
 
 Domain::Domain()
-    : m_threadPool(receiveJumppad, this),
-      m_transport(ThreadPool::readCallback, &m_threadPool) {
+    : m_threadPool(receiveJumppad, this, isOwnPacketJumppad, flushJumppad),
+      m_transport(ThreadPool::readCallback, &m_threadPool,
+                  ThreadPool::flushRequestCallback) {
   m_transport.createUdpConnection(getUserMulticastPort());
   m_transport.createUdpConnection(getBuiltInMulticastPort());
   m_transport.joinMultiCastGroup(transformIP4ToU32(239, 255, 0, 1));
@@ -48,13 +53,55 @@ bool Domain::completeInit() {
   return m_initComplete;
 }
 
-void Domain::stop() { m_threadPool.stopThreads(); }
+void Domain::stop() {
+  m_threadPool.stopThreads();
+  m_transport.flush();
+}
+
+void Domain::flush() { m_transport.flush(); }
 
 void Domain::receiveJumppad(void *callee, const PacketInfo &packet) {
   auto domain = static_cast<Domain *>(callee);
   domain->receiveCallback(packet);
 }
 
+uint32_t Domain::flushJumppad(void *callee) {
+  auto domain = static_cast<Domain *>(callee);
+  return domain->m_transport.flushDue();
+}
+
+bool Domain::isOwnPacketJumppad(void *callee, Ip4Port_t destPort,
+                                const pbuf *packet) {
+  auto domain = static_cast<const Domain *>(callee);
+  return domain->isOwnPacket(destPort, packet);
+}
+
+bool Domain::isOwnPacket(Ip4Port_t destPort, const pbuf *packet) const {
+  // Offset of the guid prefix in the RTPS header
+  constexpr uint16_t prefixPos = Header::getRawSize() - sizeof(GuidPrefix_t);
+  if (packet->len < Header::getRawSize()) {
+    return false;
+  }
+  const uint8_t *prefix = static_cast<const uint8_t *>(packet->payload) +
+                          prefixPos;
+
+  const auto numParticipants = m_nextParticipantId - PARTICIPANT_START_ID;
+  for (auto i = 0; i < numParticipants; ++i) {
+    const Participant &sender = m_participants[i];
+    if (memcmp(prefix, sender.m_guidPrefix.id.data(),
+               sender.m_guidPrefix.id.size()) != 0) {
+      continue;
+    }
+    if (isMultiCastPort(destPort)) {
+      // Other local participants still need it
+      return numParticipants == 1;
+    }
+    return getParticipantIdFromUnicastPort(destPort, isUserPort(destPort)) ==
+           sender.m_participantId;
+  }
+  return false;
+}
+
 void Domain::receiveCallback(const PacketInfo &packet) {
   if (packet.buffer.firstElement->next != nullptr) {
 #if DOMAIN_VERBOSE
@@ -64,14 +111,21 @@ void Domain::receiveCallback(const PacketInfo &packet) {
   }
 
   if (isMultiCastPort(packet.destPort)) {
-    // Pass to all
+    // Pass to all. The message is only walked through once for all of them.
 #if DOMAIN_VERBOSE
     printf("Domain: Multicast to port %u\n", packet.destPort);
 #endif
-    for (auto i = 0; i < m_nextParticipantId - PARTICIPANT_START_ID; ++i) {
-      m_participants[i].newMessage(
-          static_cast<uint8_t *>(packet.buffer.firstElement->payload),
-          packet.buffer.firstElement->len);
+    MessageIndex index(
+        static_cast<uint8_t *>(packet.buffer.firstElement->payload),
+        packet.buffer.firstElement->len, packet.buffer.firstElement);
+    if (!index.parseHeader()) {
+      return;
+    }
+    std::array<ReceiverState, Config::MAX_NUM_PARTICIPANTS> states;
+    while (index.parseNext()) {
+      for (auto i = 0; i < m_nextParticipantId - PARTICIPANT_START_ID; ++i) {
+        m_participants[i].newMessage(index, states[i]);
+      }
     }
   } else {
     // Pass to addressed one only
@@ -84,7 +138,7 @@ void Domain::receiveCallback(const PacketInfo &packet) {
       if (id < m_nextParticipantId) {
         m_participants[id - PARTICIPANT_START_ID].newMessage(
             static_cast<uint8_t *>(packet.buffer.firstElement->payload),
-            packet.buffer.firstElement->len);
+            packet.buffer.firstElement->len, packet.buffer.firstElement);
       } else {
 #if DOMAIN_VERBOSE
         printf("Domain: Participant id too high.\n");
@@ -163,6 +217,8 @@ void Domain::createBuiltinWritersAndReaders(Participant &part) {
   sedpSubReader.init(sedpAttributes, m_transport);
 
   // WRITER
+  // Endpoint announcements have to reach participants discovered later on
+  sedpAttributes.durabilityKind = DurabilityKind_t::TRANSIENT_LOCAL;
   sedpAttributes.endpointGuid.entityId =
       ENTITYID_SEDP_BUILTIN_PUBLICATIONS_WRITER;
   sedpPubWriter.init(sedpAttributes, TopicKind_t::NO_KEY, &m_threadPool,
@@ -258,6 +314,17 @@ rtps::Writer *Domain::writerExists(Participant &part, const char *topicName,
         return &m_statefulWriters[i];
       }
     }
+#if defined(unix) || defined(__unix__)
+    for (unsigned int i = 0; i < m_numPersistentWriters; i++) {
+      if (m_persistentWriters[i].isInitialized() &&
+          strncmp(m_persistentWriters[i].m_attributes.topicName, topicName,
+                  Config::MAX_TOPICNAME_LENGTH) == 0 &&
+          strncmp(m_persistentWriters[i].m_attributes.typeName, typeName,
+                  Config::MAX_TYPENAME_LENGTH) == 0) {
+        return &m_persistentWriters[i];
+      }
+    }
+#endif
   } else {
     for (unsigned int i = 0; i < m_numStatelessWriters; i++) {
       if (m_statelessWriters[i].isInitialized()) {
@@ -283,13 +350,28 @@ rtps::Writer *Domain::writerExists(Participant &part, const char *topicName,
 }
 
 rtps::Writer *Domain::createWriter(Participant &part, const char *topicName,
-                                   const char *typeName, bool reliable) {
+                                   const char *typeName, bool reliable,
+                                   DurabilityKind_t durability) {
 #if DOMAIN_VERBOSE
   printf("Creating writer[%s, %s]\n", topicName, typeName);
 #endif
 
+  // Persistent histories need a file system and are always reliable
+  const bool persistent = durability == DurabilityKind_t::PERSISTENT;
+#if defined(unix) || defined(__unix__)
+  if (persistent &&
+      (!reliable || m_persistentWriters.size() <= m_numPersistentWriters)) {
+    return nullptr;
+  }
+#else
+  if (persistent) {
+    return nullptr;
+  }
+#endif
+
   // Check if there is enough capacity for more writers
-  if ((reliable && m_statefulWriters.size() <= m_numStatefulWriters) ||
+  if ((reliable && !persistent &&
+       m_statefulWriters.size() <= m_numStatefulWriters) ||
       (!reliable && m_statelessWriters.size() <= m_numStatelessWriters) ||
       part.isWritersFull()) {
     return nullptr;
@@ -309,6 +391,7 @@ rtps::Writer *Domain::createWriter(Participant &part, const char *topicName,
       part.getNextUserEntityKey(),
       EntityKind_t::USER_DEFINED_WRITER_WITHOUT_KEY};
   attributes.unicastLocator = getUserUnicastLocator(part.m_participantId);
+  attributes.durabilityKind = durability;
 
 #if DOMAIN_VERBOSE
   printf("Creating writer[%s, %s]\n", topicName, typeName);
@@ -316,10 +399,43 @@ rtps::Writer *Domain::createWriter(Participant &part, const char *topicName,
   if (reliable) {
     attributes.reliabilityKind = ReliabilityKind_t::RELIABLE;
 
+#if defined(unix) || defined(__unix__)
+    if (persistent) {
+      PersistentStatefulWriter &writer =
+          m_persistentWriters[m_numPersistentWriters];
+      char path[256];
+      int length = snprintf(path, sizeof(path), "%s/%s_%u.hist",
+                            Config::PERSISTENT_HISTORY_DIR, topicName,
+                            static_cast<unsigned int>(part.m_participantId));
+      if (length < 0 || sizeof(path) <= static_cast<size_t>(length)) {
+        return nullptr;
+      }
+      // Topic names like "rt/chatter" must not create directories
+      for (char *c = path + strlen(Config::PERSISTENT_HISTORY_DIR) + 1;
+           *c != '\0'; ++c) {
+        if (*c == '/') {
+          *c = '_';
+        }
+      }
+      if (!writer.openHistory(path)) {
+        return nullptr;
+      }
+      ++m_numPersistentWriters;
+      writer.init(attributes, TopicKind_t::NO_KEY, &m_threadPool, m_transport);
+
+      if (!part.addWriter(&writer)) {
+        return nullptr;
+      }
+      return &writer;
+    }
+#endif
+
     StatefulWriter &writer = m_statefulWriters[m_numStatefulWriters++];
     writer.init(attributes, TopicKind_t::NO_KEY, &m_threadPool, m_transport);
 
-    part.addWriter(&writer);
+    if (!part.addWriter(&writer)) {
+      return nullptr;
+    }
     return &writer;
   } else {
     attributes.reliabilityKind = ReliabilityKind_t::BEST_EFFORT;
@@ -327,13 +443,16 @@ rtps::Writer *Domain::createWriter(Participant &part, const char *topicName,
     StatelessWriter &writer = m_statelessWriters[m_numStatelessWriters++];
     writer.init(attributes, TopicKind_t::NO_KEY, &m_threadPool, m_transport);
 
-    part.addWriter(&writer);
+    if (!part.addWriter(&writer)) {
+      return nullptr;
+    }
     return &writer;
   }
 }
 
 rtps::Reader *Domain::createReader(Participant &part, const char *topicName,
-                                   const char *typeName, bool reliable) {
+                                   const char *typeName, bool reliable,
+                                   DurabilityKind_t durability) {
 #if DOMAIN_VERBOSE
   printf("Creating reader[%s, %s]\n", topicName, typeName);
 #endif
@@ -357,6 +476,10 @@ rtps::Reader *Domain::createReader(Participant &part, const char *topicName,
       part.getNextUserEntityKey(),
       EntityKind_t::USER_DEFINED_READER_WITHOUT_KEY};
   attributes.unicastLocator = getUserUnicastLocator(part.m_participantId);
+  if (Config::MULTICAST_MIN_READERS != 0) {
+    attributes.multicastLocator = getUserMulticastLocator();
+  }
+  attributes.durabilityKind = durability;
 
 #if DOMAIN_VERBOSE
   printf("Creating reader[%s, %s]\n", topicName, typeName);
@@ -393,6 +516,10 @@ rtps::Reader *Domain::createReader(Participant &part, const char *topicName,
   }
 }
 
+bool Domain::useCallbackExecutor(Reader &reader) {
+  return reader.setCallbackExecutor(&m_threadPool);
+}
+
 rtps::GuidPrefix_t Domain::generateGuidPrefix(ParticipantId_t id) const {
   GuidPrefix_t prefix = Config::BASE_GUID_PREFIX;
   prefix.id[prefix.id.size() - 1] = *reinterpret_cast<uint8_t *>(&id);
@@ -84,7 +84,8 @@ bool Participant::registerOnNewSubscriberMatchedCallback(
 }
 
 rtps::Writer *Participant::addWriter(Writer *pWriter) {
-  if (pWriter != nullptr && m_numWriters != m_writers.size()) {
+  if (pWriter != nullptr && m_numWriters != m_writers.size() &&
+      m_writerIndex.add(pWriter->m_attributes.endpointGuid.entityId, pWriter)) {
     m_writers[m_numWriters++] = pWriter;
     if (m_hasBuilInEndpoints) {
       m_sedpAgent.addWriter(*pWriter);
@@ -98,7 +99,8 @@ rtps::Writer *Participant::addWriter(Writer *pWriter) {
 bool Participant::isWritersFull() { return m_numWriters == m_writers.size(); }
 
 rtps::Reader *Participant::addReader(Reader *pReader) {
-  if (pReader != nullptr && m_numReaders != m_readers.size()) {
+  if (pReader != nullptr && m_numReaders != m_readers.size() &&
+      m_readerIndex.add(pReader->m_attributes.endpointGuid.entityId, pReader)) {
     m_readers[m_numReaders++] = pReader;
     if (m_hasBuilInEndpoints) {
       m_sedpAgent.addReader(*pReader);
@@ -112,21 +114,11 @@ rtps::Reader *Participant::addReader(Reader *pReader) {
 bool Participant::isReadersFull() { return m_numReaders == m_readers.size(); }
 
 rtps::Writer *Participant::getWriter(EntityId_t id) const {
-  for (uint8_t i = 0; i < m_numWriters; ++i) {
-    if (m_writers[i]->m_attributes.endpointGuid.entityId == id) {
-      return m_writers[i];
-    }
-  }
-  return nullptr;
+  return m_writerIndex.find(id);
 }
 
 rtps::Reader *Participant::getReader(EntityId_t id) const {
-  for (uint8_t i = 0; i < m_numReaders; ++i) {
-    if (m_readers[i]->m_attributes.endpointGuid.entityId == id) {
-      return m_readers[i];
-    }
-  }
-  return nullptr;
+  return m_readerIndex.find(id);
 }
 
 rtps::Writer *
@@ -142,17 +134,33 @@ Participant::getMatchingWriter(const TopicData &readerTopicData) const {
   return nullptr;
 }
 
-rtps::Reader *
-Participant::getMatchingReader(const TopicData &writerTopicData) const {
+uint8_t
+Participant::getMatchingReaders(const TopicData &writerTopicData,
+                                WriterRouteTable::ReaderList &readers) const {
+  uint8_t numMatches = 0;
   for (uint8_t i = 0; i < m_numReaders; ++i) {
-    if (m_readers[i]->m_attributes.matchesTopicOf(writerTopicData) &&
-            (writerTopicData.reliabilityKind == ReliabilityKind_t::RELIABLE ||
-              m_readers[i]->m_attributes.reliabilityKind ==
-                  ReliabilityKind_t::BEST_EFFORT)) {
-      return m_readers[i];
+    if (isMatchingReader(*m_readers[i], writerTopicData)) {
+      readers[numMatches++] = m_readers[i];
     }
   }
-  return nullptr;
+  return numMatches;
+}
+
+bool Participant::isMatchingReader(Reader &reader,
+                                   const TopicData &writerTopicData) {
+  return reader.m_attributes.matchesTopicOf(writerTopicData) &&
+         (writerTopicData.reliabilityKind == ReliabilityKind_t::RELIABLE ||
+          reader.m_attributes.reliabilityKind ==
+              ReliabilityKind_t::BEST_EFFORT);
+}
+
+bool Participant::addWriterRoute(const Guid &writerGuid, Reader &reader) {
+  return m_writerRoutes.add(writerGuid, &reader);
+}
+
+uint8_t Participant::getRoutedReaders(const Guid &writerGuid,
+                                      WriterRouteTable::ReaderList &readers) {
+  return m_writerRoutes.find(writerGuid, readers);
 }
 
 bool Participant::addNewRemoteParticipant(
@@ -168,9 +176,43 @@ bool Participant::removeRemoteParticipant(const GuidPrefix_t &prefix) {
     return (*static_cast<decltype(isElementToRemove) *>(arg))(value);
   };
 
+  for (uint8_t i = 0; i < m_numWriters; ++i) {
+    m_writers[i]->removeReaderOfParticipant(prefix);
+  }
+  for (uint8_t i = 0; i < m_numReaders; ++i) {
+    m_readers[i]->removeWriterOfParticipant(prefix);
+  }
+  m_writerRoutes.removeParticipant(prefix);
   return m_remoteParticipants.remove(thunk, &isElementToRemove);
 }
 
+void Participant::removeExpiredRemoteParticipants(uint32_t nowMs) {
+  while (true) {
+    const ParticipantProxyData *expired = nullptr;
+    for (const auto &remotePart : m_remoteParticipants) {
+      if (remotePart.isLeaseExpired(nowMs)) {
+        expired = &remotePart;
+        break;
+      }
+    }
+    if (expired == nullptr) {
+      return;
+    }
+    removeRemoteParticipant(expired->m_guid.prefix);
+  }
+}
+
+bool Participant::renewRemoteParticipantLease(const GuidPrefix_t &prefix,
+                                              uint32_t nowMs) {
+  for (auto &remotePart : m_remoteParticipants) {
+    if (remotePart.m_guid.prefix == prefix) {
+      remotePart.m_lastAnnouncementMs = nowMs;
+      return true;
+    }
+  }
+  return false;
+}
+
 const rtps::ParticipantProxyData *
 Participant::findRemoteParticipant(const GuidPrefix_t &prefix) {
   auto isElementToFind = [&](const ParticipantProxyData &proxy) {
@@ -205,6 +247,12 @@ void Participant::addBuiltInEndpoints(BuiltInEndpoints &endpoints) {
   m_spdpAgent.start();
 }
 
-void Participant::newMessage(const uint8_t *data, DataSize_t size) {
-  m_receiver.processMessage(data, size);
+void Participant::newMessage(const uint8_t *data, DataSize_t size,
+                             pbuf *packetBuffer) {
+  m_receiver.processMessage(data, size, packetBuffer);
+}
+
+void Participant::newMessage(const MessageIndex &index,
+                             ReceiverState &state) {
+  m_receiver.processIndex(index, state);
 }
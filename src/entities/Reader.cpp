@@ -0,0 +1,107 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#include "rtps/entities/Reader.h"
+#include "rtps/ThreadPool.h"
+#include "rtps/utils/Lock.h"
+
+using rtps::Reader;
+
+#define READER_VERBOSE 0
+
+#if READER_VERBOSE
+#include "rtps/utils/printutils.h"
+#endif
+
+Reader::~Reader() {
+  if (m_callback != nullptr) {
+    sys_mutex_free(&m_dispatchMutex);
+  }
+}
+
+void Reader::registerCallback(ddsReaderCallback_fp cb, void *callee) {
+  if (cb == nullptr) {
+#if READER_VERBOSE
+    printf("Reader[%s]: Passed callback is nullptr\n",
+           &m_attributes.topicName[0]);
+#endif
+    return;
+  }
+  if (m_callback == nullptr) {
+    if (!m_history.isEnabled() &&
+        !m_history.init(HistoryKind_t::KEEP_ALL,
+                        Config::READER_HISTORY_SIZE)) {
+      return;
+    }
+    if (sys_mutex_new(&m_dispatchMutex) != ERR_OK) {
+#if READER_VERBOSE
+      printf("Reader[%s]: Failed to create mutex\n",
+             &m_attributes.topicName[0]);
+#endif
+      return;
+    }
+  }
+  m_callee = callee; // It's okay if this is null
+  m_callback = cb;
+}
+
+bool Reader::setCallbackExecutor(ThreadPool *pool) {
+  if (pool != nullptr && !pool->hasCallbackThreads()) {
+    return false;
+  }
+  m_executor = pool;
+  return true;
+}
+
+void Reader::dispatchCallbacks() {
+  if (m_callback == nullptr) {
+    return;
+  }
+  if (m_executor != nullptr) {
+    // The executor drains the history until it is empty, so it only needs to
+    // be told once samples arrive at an empty history again
+    if (!m_history.takeWakeup() || m_executor->addCallbackWork(this)) {
+      return;
+    }
+  }
+  // No executor or its queue is full
+  executeCallbacks();
+}
+
+void Reader::executeCallbacks() {
+  if (m_callback == nullptr) {
+    return;
+  }
+  Lock lock{m_dispatchMutex};
+  ReaderSample sample;
+  while (m_history.take(&sample, 1) == 1) {
+    ReaderCacheChange change{sample.kind, sample.writerGuid, sample.sn,
+                             sample.data, sample.size,
+                             sample.packet.firstElement};
+    m_callback(m_callee, change);
+  }
+}
+
+#undef READER_VERBOSE
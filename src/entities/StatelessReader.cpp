@@ -34,21 +34,13 @@ void StatelessReader::init(const TopicData &attributes) {
 }
 
 void StatelessReader::newChange(const ReaderCacheChange &cacheChange) {
-  if (m_callback != nullptr) {
-    m_callback(m_callee, cacheChange);
-  }
-}
-
-void StatelessReader::registerCallback(ddsReaderCallback_fp cb, void *callee) {
-  if (cb != nullptr) {
-    m_callback = cb;
-    m_callee = callee; // It's okay if this is null
-  } else {
-#if SLR_VERBOSE
-    printf("StatelessReader[%s]: Passed callback is nullptr\n",
-           &m_attributes.topicName[0]);
-#endif
+  if (!m_history.isEnabled()) {
+    return;
   }
+  // Best effort, a full KEEP_ALL history just loses the sample
+  m_history.add(cacheChange.kind, cacheChange.writerGuid, cacheChange.sn,
+                cacheChange.packetBuffer, cacheChange.data, cacheChange.size);
+  dispatchCallbacks();
 }
 
 bool StatelessReader::addNewMatchedWriter(const WriterProxy & /*newProxy*/) {
@@ -60,10 +52,26 @@ void StatelessReader::removeWriter(const Guid & /*guid*/) {
   // Nothing to do
 }
 
+void StatelessReader::removeWriterOfParticipant(
+    const GuidPrefix_t & /*guidPrefix*/) {
+  // Nothing to do
+}
+
 bool StatelessReader::onNewHeartbeat(const SubmessageHeartbeat &,
                                      const GuidPrefix_t &) {
   // nothing to do
   return true;
 }
 
+bool StatelessReader::onNewGap(const SubmessageGap &, const GuidPrefix_t &) {
+  // nothing to do
+  return true;
+}
+
+void StatelessReader::onNewDataFrag(const SubmessageDataFrag &,
+                                    const GuidPrefix_t &, const uint8_t *,
+                                    DataSize_t) {
+  // Reassembly needs repair of single fragments, which is reliable only
+}
+
 #undef SLR_VERBOSE
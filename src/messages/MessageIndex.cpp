@@ -0,0 +1,98 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#include "rtps/messages/MessageIndex.h"
+#include <cstring>
+
+using rtps::MessageIndex;
+
+bool MessageIndex::parseHeader() {
+  MessageProcessingInfo info(data, size, packetBuffer);
+  if (!deserializeMessage(info, header)) {
+    return false;
+  }
+  if (header.protocolName != RTPS_PROTOCOL_NAME ||
+      header.protocolVersion.major != PROTOCOLVERSION.major) {
+    return false;
+  }
+  m_nextPos = Header::getRawSize();
+  return true;
+}
+
+bool MessageIndex::parseNext() {
+  m_numEntries = 0;
+  m_roundStart = m_nextPos;
+  MessageProcessingInfo info(data, size, packetBuffer);
+  while (m_nextPos < size && m_numEntries < m_entries.size()) {
+    info.nextPos = m_nextPos;
+    SubmessageIndexEntry &entry = m_entries[m_numEntries];
+    if (!deserializeMessage(info, entry.header)) {
+      m_nextPos = size; // Don't look at the rest
+      break;
+    }
+    entry.offset = m_nextPos;
+
+    const DataSize_t bodyPos = m_nextPos + SubmessageHeader::getRawSize();
+    switch (entry.header.submessageId) {
+    case SubmessageKind::DATA:
+    case SubmessageKind::DATA_FRAG:
+      // Behind extraFlags and octetsToInlineQos
+      entry.targetId = readEntityId(bodyPos + 4);
+      break;
+    case SubmessageKind::HEARTBEAT:
+    case SubmessageKind::GAP:
+      entry.targetId = readEntityId(bodyPos);
+      break;
+    case SubmessageKind::ACKNACK:
+    case SubmessageKind::NACK_FRAG:
+      entry.targetId = readEntityId(bodyPos + 4);
+      break;
+    default:
+      entry.targetId = ENTITYID_UNKNOWN;
+    }
+
+    if (entry.header.submessageLength == 0 &&
+        entry.header.submessageId != SubmessageKind::INFO_TS &&
+        entry.header.submessageId != SubmessageKind::PAD) {
+      // Extends to the end of the message
+      m_nextPos = size;
+    } else {
+      const uint32_t next = static_cast<uint32_t>(bodyPos) +
+                            entry.header.submessageLength;
+      m_nextPos = next < size ? static_cast<DataSize_t>(next) : size;
+    }
+    ++m_numEntries;
+  }
+  return m_numEntries != 0;
+}
+
+rtps::EntityId_t MessageIndex::readEntityId(DataSize_t offset) const {
+  EntityId_t id = ENTITYID_UNKNOWN;
+  if (static_cast<uint32_t>(offset) + 4 <= size) {
+    memcpy(id.entityKey.data(), &data[offset], id.entityKey.size());
+    id.entityKind = static_cast<EntityKind_t>(data[offset + 3]);
+  }
+  return id;
+}
@@ -27,6 +27,7 @@ Author: i11 - Embedded Software, RWTH Aachen University
 
 #include "rtps/entities/Reader.h"
 #include "rtps/entities/Writer.h"
+#include "rtps/messages/MessageIndex.h"
 #include "rtps/messages/MessageTypes.h"
 
 using rtps::MessageReceiver;
@@ -39,165 +40,336 @@ using rtps::MessageReceiver;
 
 MessageReceiver::MessageReceiver(Participant *part) : mp_part(part) {}
 
-void MessageReceiver::resetState() {
-  sourceGuidPrefix = GUIDPREFIX_UNKNOWN;
-  sourceVersion = PROTOCOLVERSION;
-  sourceVendor = VENDOR_UNKNOWN;
-  haveTimeStamp = false;
-}
-
-bool MessageReceiver::processMessage(const uint8_t *data, DataSize_t size) {
-  resetState();
-  MessageProcessingInfo msgInfo(data, size);
-
-  if (!processHeader(msgInfo)) {
+bool MessageReceiver::processMessage(const uint8_t *data, DataSize_t size,
+                                     pbuf *packetBuffer) const {
+  MessageIndex index(data, size, packetBuffer);
+  if (!index.parseHeader()) {
     return false;
   }
-  SubmessageHeader submsgHeader;
-  while (msgInfo.nextPos < msgInfo.size) {
-    if (!deserializeMessage(msgInfo, submsgHeader)) {
+  ReceiverState state;
+  while (index.parseNext()) {
+    if (!processIndex(index, state)) {
       return false;
     }
-    processSubmessage(msgInfo, submsgHeader);
   }
-
   return true;
 }
 
-bool MessageReceiver::processHeader(MessageProcessingInfo &msgInfo) {
-  Header header;
-  if (!deserializeMessage(msgInfo, header)) {
+bool MessageReceiver::processIndex(const MessageIndex &index,
+                                   ReceiverState &state) const {
+  if (!processHeader(index, state)) {
     return false;
   }
 
-  if (header.guidPrefix.id == mp_part->m_guidPrefix.id) {
+  MessageProcessingInfo msgInfo(index.data, index.size, index.packetBuffer);
+  for (uint8_t i = 0; i < index.getNumEntries(); ++i) {
+    processSubmessage(msgInfo, index.getEntry(i), state);
+  }
+  return true;
+}
+
+bool MessageReceiver::processHeader(const MessageIndex &index,
+                                    ReceiverState &state) const {
+  if (index.header.guidPrefix.id == mp_part->m_guidPrefix.id) {
 #if RECV_VERBOSE
     printf("[MessageReceiver]: Received own message.\n");
 #endif
     return false; // Don't process our own packet
   }
 
-  if (header.protocolName != RTPS_PROTOCOL_NAME ||
-      header.protocolVersion.major != PROTOCOLVERSION.major) {
-    return false;
+  if (index.isFirstRound()) {
+    state = ReceiverState{};
+    state.sourceGuidPrefix = index.header.guidPrefix;
+    state.sourceVendor = index.header.vendorId;
+    state.sourceVersion = index.header.protocolVersion;
+    state.destGuidPrefix = mp_part->m_guidPrefix;
   }
-
-  sourceGuidPrefix = header.guidPrefix;
-  sourceVendor = header.vendorId;
-  sourceVersion = header.protocolVersion;
-
-  msgInfo.nextPos += Header::getRawSize();
   return true;
 }
 
 bool MessageReceiver::processSubmessage(MessageProcessingInfo &msgInfo,
-                                        const SubmessageHeader &submsgHeader) {
-  bool success = false;
+                                        const SubmessageIndexEntry &entry,
+                                        ReceiverState &state) const {
+  const SubmessageKind kind = entry.header.submessageId;
+  if (!(state.destGuidPrefix == mp_part->m_guidPrefix) &&
+      !isInterpreterSubmessage(kind)) {
+#if RECV_VERBOSE
+    printf("Skipping submessage for another participant\n");
+#endif
+    return true;
+  }
 
-  switch (submsgHeader.submessageId) {
+  // Only submessages for one of our endpoints get deserialized
+  msgInfo.nextPos = entry.offset;
+  Reader *reader = nullptr;
+  Writer *writer = nullptr;
+  bool success = false;
+  switch (kind) {
   case SubmessageKind::ACKNACK:
 #if RECV_VERBOSE
     printf("Processing AckNack submessage\n");
 #endif
-    success = processAckNackSubmessage(msgInfo);
+    writer = mp_part->getWriter(entry.targetId);
+    success = writer != nullptr &&
+              processAckNackSubmessage(msgInfo, *writer, state);
     break;
   case SubmessageKind::DATA:
 #if RECV_VERBOSE
     printf("Processing Data submessage\n");
 #endif
-    success = processDataSubmessage(msgInfo);
+    success = processDataSubmessage(msgInfo, entry.targetId, state);
     break;
   case SubmessageKind::HEARTBEAT:
 #if RECV_VERBOSE
     printf("Processing Heartbeat submessage\n");
 #endif
-    success = processHeartbeatSubmessage(msgInfo);
+    reader = mp_part->getReader(entry.targetId);
+    success = reader != nullptr &&
+              processHeartbeatSubmessage(msgInfo, *reader, state);
+    break;
+  case SubmessageKind::DATA_FRAG:
+#if RECV_VERBOSE
+    printf("Processing DataFrag submessage\n");
+#endif
+    reader = mp_part->getReader(entry.targetId);
+    success = reader != nullptr &&
+              processDataFragSubmessage(msgInfo, *reader, state);
+    break;
+  case SubmessageKind::NACK_FRAG:
+#if RECV_VERBOSE
+    printf("Processing NackFrag submessage\n");
+#endif
+    writer = mp_part->getWriter(entry.targetId);
+    success = writer != nullptr &&
+              processNackFragSubmessage(msgInfo, *writer, state);
+    break;
+  case SubmessageKind::GAP:
+#if RECV_VERBOSE
+    printf("Processing Gap submessage\n");
+#endif
+    reader = mp_part->getReader(entry.targetId);
+    success = reader != nullptr &&
+              processGapSubmessage(msgInfo, *reader, state);
     break;
   case SubmessageKind::INFO_DST:
 #if RECV_VERBOSE
-    printf("Info_DST submessage not relevant.\n");
+    printf("Processing Info_DST submessage\n");
+#endif
+    success = processInfoDstSubmessage(msgInfo, state);
+    break;
+  case SubmessageKind::INFO_SRC:
+#if RECV_VERBOSE
+    printf("Processing Info_SRC submessage\n");
 #endif
-    success = true; // Not relevant
+    success = processInfoSrcSubmessage(msgInfo, state);
     break;
   case SubmessageKind::INFO_TS:
 #if RECV_VERBOSE
-    printf("Info_TS submessage not relevant.\n");
+    printf("Processing Info_TS submessage\n");
 #endif
-    success = true; // Not relevant now
+    success = processInfoTsSubmessage(msgInfo, state);
     break;
   default:
 #if RECV_VERBOSE
     printf("Submessage of type %u currently not supported. Skipping..\n",
-           static_cast<uint8_t>(submsgHeader->submessageId));
+           static_cast<uint8_t>(kind));
 #endif
     success = false;
   }
-  msgInfo.nextPos +=
-      submsgHeader.submessageLength + SubmessageHeader::getRawSize();
   return success;
 }
 
-bool MessageReceiver::processDataSubmessage(MessageProcessingInfo &msgInfo) {
+bool MessageReceiver::isInterpreterSubmessage(SubmessageKind kind) {
+  switch (kind) {
+  case SubmessageKind::PAD:
+  case SubmessageKind::INFO_TS:
+  case SubmessageKind::INFO_SRC:
+  case SubmessageKind::INFO_REPLY_IP4:
+  case SubmessageKind::INFO_DST:
+  case SubmessageKind::INFO_REPLY:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool MessageReceiver::processDataSubmessage(MessageProcessingInfo &msgInfo,
+                                            const EntityId_t &readerId,
+                                            const ReceiverState &state) const {
+  // DATA for an unknown reader is dropped before it gets deserialized
+  Reader *reader = nullptr;
+  if (readerId != ENTITYID_UNKNOWN) {
+    reader = mp_part->getReader(readerId);
+    if (reader == nullptr) {
+      return false;
+    }
+  }
+
   SubmessageData dataSubmsg;
   if (!deserializeMessage(msgInfo, dataSubmsg)) {
     return false;
   }
 
+  // The payload ends with the submessage as others may follow in the same
+  // message, e.g. a piggybacked heartbeat.
+  const uint32_t payloadStart = msgInfo.nextPos + SubmessageData::getRawSize();
+  uint32_t payloadEnd = msgInfo.size;
+  if (dataSubmsg.header.submessageLength != 0) {
+    payloadEnd = msgInfo.nextPos + SubmessageHeader::getRawSize() +
+                 dataSubmsg.header.submessageLength;
+  }
+  if (payloadEnd > msgInfo.size || payloadEnd < payloadStart) {
+    return false;
+  }
   const uint8_t *serializedData =
       msgInfo.getPointerToCurrentPos() + SubmessageData::getRawSize();
-  const DataSize_t size =
-      msgInfo.size - (msgInfo.nextPos + SubmessageData::getRawSize());
-
-  // bool isLittleEndian = (submsgHeader->flags &
-  // SubMessageFlag::FLAG_ENDIANESS); bool hasInlineQos = (submsgHeader->flags &
-  // SubMessageFlag::FLAG_INLINE_QOS);
+  auto size = static_cast<DataSize_t>(payloadEnd - payloadStart);
+  // Padding that aligns the next submessage is not part of the sample
+  if (size >= SMElement::ENCAPSULATION_HEADER_SIZE &&
+      SMElement::isEncapsulationHeader(serializedData)) {
+    const uint8_t padding =
+        serializedData[3] & SMElement::ENCAPSULATION_PADDING_MASK;
+    if (size - SMElement::ENCAPSULATION_HEADER_SIZE >= padding) {
+      size -= padding;
+    }
+  }
 
-  Reader *reader = mp_part->getReader(dataSubmsg.readerId);
+  Guid writerGuid{state.sourceGuidPrefix, dataSubmsg.writerId};
+  ReaderCacheChange change{ChangeKind_t::ALIVE, writerGuid,
+                           dataSubmsg.writerSN, serializedData, size,
+                           msgInfo.packetBuffer};
   if (reader != nullptr) {
-    Guid writerGuid{sourceGuidPrefix, dataSubmsg.writerId};
-    ReaderCacheChange change{ChangeKind_t::ALIVE, writerGuid,
-                             dataSubmsg.writerSN, serializedData, size};
     reader->newChange(change);
-  } else {
+    return true;
+  }
+
+  // Every matched reader gets the same change. Readers that keep it take a
+  // reference to the packet, nothing is parsed or copied again.
+  WriterRouteTable::ReaderList readers;
+  const uint8_t numReaders = mp_part->getRoutedReaders(writerGuid, readers);
 #if RECV_VERBOSE
-    printf("Couldn't find a reader with id: ");
-    printEntityId(dataSubmsg->readerId);
-    printf("\n");
+  printf("Routing data to %u readers\n", numReaders);
 #endif
+  for (uint8_t i = 0; i < numReaders; ++i) {
+    readers[i]->newChange(change);
+  }
+  return numReaders != 0;
+}
+
+bool MessageReceiver::processDataFragSubmessage(
+    MessageProcessingInfo &msgInfo, Reader &reader,
+    const ReceiverState &state) const {
+  SubmessageDataFrag fragSubmsg;
+  if (!deserializeMessage(msgInfo, fragSubmsg)) {
+    return false;
+  }
+
+  const uint32_t payloadStart =
+      msgInfo.nextPos + SubmessageDataFrag::getRawSize();
+  uint32_t payloadEnd = msgInfo.size;
+  if (fragSubmsg.header.submessageLength != 0) {
+    payloadEnd = msgInfo.nextPos + SubmessageHeader::getRawSize() +
+                 fragSubmsg.header.submessageLength;
+  }
+  if (payloadEnd > msgInfo.size || payloadEnd < payloadStart) {
+    return false;
   }
 
+  reader.onNewDataFrag(
+      fragSubmsg, state.sourceGuidPrefix,
+      msgInfo.getPointerToCurrentPos() + SubmessageDataFrag::getRawSize(),
+      static_cast<DataSize_t>(payloadEnd - payloadStart));
   return true;
 }
 
 bool MessageReceiver::processHeartbeatSubmessage(
-    MessageProcessingInfo &msgInfo) {
+    MessageProcessingInfo &msgInfo, Reader &reader,
+    const ReceiverState &state) const {
   SubmessageHeartbeat submsgHB;
   if (!deserializeMessage(msgInfo, submsgHB)) {
     return false;
   }
 
-  Reader *reader = mp_part->getReader(submsgHB.readerId);
-  if (reader != nullptr) {
-    reader->onNewHeartbeat(submsgHB, sourceGuidPrefix);
-    return true;
-  } else {
-    return false;
-  }
+  reader.onNewHeartbeat(submsgHB, state.sourceGuidPrefix);
+  return true;
 }
 
-bool MessageReceiver::processAckNackSubmessage(MessageProcessingInfo &msgInfo) {
+bool MessageReceiver::processAckNackSubmessage(
+    MessageProcessingInfo &msgInfo, Writer &writer,
+    const ReceiverState &state) const {
   SubmessageAckNack submsgAckNack;
   if (!deserializeMessage(msgInfo, submsgAckNack)) {
     return false;
   }
 
-  Writer *writer = mp_part->getWriter(submsgAckNack.writerId);
-  if (writer != nullptr) {
-    writer->onNewAckNack(submsgAckNack, sourceGuidPrefix);
-    return true;
+  writer.onNewAckNack(submsgAckNack, state.sourceGuidPrefix);
+  return true;
+}
+
+bool MessageReceiver::processNackFragSubmessage(
+    MessageProcessingInfo &msgInfo, Writer &writer,
+    const ReceiverState &state) const {
+  SubmessageNackFrag submsgNackFrag;
+  if (!deserializeMessage(msgInfo, submsgNackFrag)) {
+    return false;
+  }
+
+  writer.onNewNackFrag(submsgNackFrag, state.sourceGuidPrefix);
+  return true;
+}
+
+bool MessageReceiver::processGapSubmessage(MessageProcessingInfo &msgInfo,
+                                           Reader &reader,
+                                           const ReceiverState &state) const {
+  SubmessageGap submsgGap;
+  if (!deserializeMessage(msgInfo, submsgGap)) {
+    return false;
+  }
+
+  reader.onNewGap(submsgGap, state.sourceGuidPrefix);
+  return true;
+}
+
+bool MessageReceiver::processInfoDstSubmessage(MessageProcessingInfo &msgInfo,
+                                               ReceiverState &state) const {
+  SubmessageInfoDst submsgInfoDst;
+  if (!deserializeMessage(msgInfo, submsgInfoDst)) {
+    return false;
+  }
+
+  if (submsgInfoDst.guidPrefix == GUIDPREFIX_UNKNOWN) {
+    state.destGuidPrefix = mp_part->m_guidPrefix;
   } else {
+    state.destGuidPrefix = submsgInfoDst.guidPrefix;
+  }
+  return true;
+}
+
+bool MessageReceiver::processInfoSrcSubmessage(MessageProcessingInfo &msgInfo,
+                                               ReceiverState &state) const {
+  SubmessageInfoSrc submsgInfoSrc;
+  if (!deserializeMessage(msgInfo, submsgInfoSrc)) {
+    return false;
+  }
+
+  state.sourceGuidPrefix = submsgInfoSrc.guidPrefix;
+  state.sourceVersion = submsgInfoSrc.protocolVersion;
+  state.sourceVendor = submsgInfoSrc.vendorId;
+  state.haveTimeStamp = false;
+  state.timestamp = TIME_INVALID;
+  return true;
+}
+
+bool MessageReceiver::processInfoTsSubmessage(MessageProcessingInfo &msgInfo,
+                                              ReceiverState &state) const {
+  SubmessageInfoTs submsgInfoTs;
+  if (!deserializeMessage(msgInfo, submsgInfoTs)) {
     return false;
   }
+
+  state.haveTimeStamp = (submsgInfoTs.header.flags & FLAG_INVALIDATE) == 0;
+  state.timestamp = submsgInfoTs.timestamp;
+  return true;
 }
 
 #undef RECV_VERBOSE
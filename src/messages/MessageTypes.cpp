@@ -23,6 +23,7 @@ Author: i11 - Embedded Software, RWTH Aachen University
 */
 
 #include "rtps/messages/MessageTypes.h"
+#include "rtps/config.h"
 #include <cstring>
 
 #include <stdio.h>
@@ -33,149 +34,382 @@ void doCopyAndMoveOn(uint8_t *dst, const uint8_t *&src, size_t size) {
   src += size;
 }
 
-bool rtps::deserializeMessage(const MessageProcessingInfo &info,
-                              Header &header) {
-  if (info.getRemainingSize() < Header::getRawSize()) {
+namespace {
+
+inline uint8_t byteSwap(uint8_t value) { return value; }
+
+inline uint16_t byteSwap(uint16_t value) {
+  return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+
+inline uint32_t byteSwap(uint32_t value) {
+  return (value >> 24) | ((value >> 8) & 0x0000FF00) |
+         ((value << 8) & 0x00FF0000) | (value << 24);
+}
+
+inline int32_t byteSwap(int32_t value) {
+  return static_cast<int32_t>(byteSwap(static_cast<uint32_t>(value)));
+}
+
+/**
+ * Reads the fields of a submessage in order. Whether the sender's byte order
+ * differs from ours is a template parameter, so the common case compiles to
+ * plain loads and only the other one swaps bytes.
+ */
+template <bool Swap> class WireReader {
+public:
+  explicit WireReader(const uint8_t *pos) : m_pos(pos) {}
+
+  template <typename T> void read(T &value) {
+    memcpy(&value, m_pos, sizeof(T));
+    m_pos += sizeof(T);
+    if (Swap) {
+      value = byteSwap(value);
+    }
+  }
+
+  void read(EntityId_t &id) {
+    doCopyAndMoveOn(id.entityKey.data(), m_pos, id.entityKey.size());
+    id.entityKind = static_cast<EntityKind_t>(*m_pos++);
+  }
+
+  void read(SequenceNumber_t &sn) {
+    read(sn.high);
+    read(sn.low);
+  }
+
+  void readWords(uint32_t *words, uint32_t numWords) {
+    for (uint32_t i = 0; i < numWords; ++i) {
+      read(words[i]);
+    }
+  }
+
+  void readBytes(uint8_t *dst, size_t size) {
+    doCopyAndMoveOn(dst, m_pos, size);
+  }
+
+  void skip(size_t size) { m_pos += size; }
+
+private:
+  const uint8_t *m_pos;
+};
+
+bool isNativeByteOrder(uint8_t flags) {
+#ifndef IS_LITTLE_ENDIAN
+#error "IS_LITTLE_ENDIAN has to be defined by the config"
+#endif
+#if IS_LITTLE_ENDIAN
+  return (flags & FLAG_ENDIANESS) == FLAG_LITTLE_ENDIAN;
+#else
+  return (flags & FLAG_ENDIANESS) == FLAG_BIG_ENDIAN;
+#endif
+}
+
+template <bool Swap>
+void readHeader(WireReader<Swap> &reader, SubmessageHeader &header) {
+  uint8_t id;
+  reader.read(id);
+  header.submessageId = static_cast<SubmessageKind>(id);
+  reader.read(header.flags);
+  reader.read(header.submessageLength);
+}
+
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info,
+                   SubmessageHeader &header) {
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, header);
+  return true;
+}
+
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info, SubmessageData &msg) {
+  if (info.getRemainingSize() < SubmessageData::getRawSize()) {
     return false;
   }
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
 
-  const uint8_t *currentPos = info.getPointerToCurrentPos();
-  doCopyAndMoveOn(header.protocolName.data(), currentPos,
-                  sizeof(std::array<uint8_t, 4>));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&header.protocolVersion),
-                  currentPos, sizeof(ProtocolVersion_t));
-  doCopyAndMoveOn(header.vendorId.vendorId.data(), currentPos,
-                  header.vendorId.vendorId.size());
-  doCopyAndMoveOn(header.guidPrefix.id.data(), currentPos,
-                  header.guidPrefix.id.size());
+  // Check for length including data
+  if (info.getRemainingSize() <
+      SubmessageHeader::getRawSize() + msg.header.submessageLength) {
+    return false;
+  }
+
+  reader.read(msg.extraFlags);
+  reader.read(msg.octetsToInlineQos);
+  reader.read(msg.readerId);
+  reader.read(msg.writerId);
+  reader.read(msg.writerSN);
   return true;
 }
 
-bool rtps::deserializeMessage(const MessageProcessingInfo &info,
-                              SubmessageHeader &header) {
-  if (info.getRemainingSize() < SubmessageHeader::getRawSize()) {
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info,
+                   SubmessageHeartbeat &msg) {
+  if (info.getRemainingSize() < SubmessageHeartbeat::getRawSize()) {
     return false;
   }
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  reader.read(msg.readerId);
+  reader.read(msg.writerId);
+  reader.read(msg.firstSN);
+  reader.read(msg.lastSN);
+  reader.read(msg.count.value);
+  return true;
+}
 
-  const uint8_t *currentPos = info.getPointerToCurrentPos();
-  header.submessageId = static_cast<SubmessageKind>(*currentPos++);
-  header.flags = *(currentPos++);
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&header.submessageLength),
-                  currentPos, sizeof(uint16_t));
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info, SubmessageAckNack &msg) {
+  const DataSize_t remainingSizeAtBeginning = info.getRemainingSize();
+  if (remainingSizeAtBeginning < SubmessageAckNack::getRawSizeWithoutSNSet() +
+                                     sizeof(SequenceNumber_t) +
+                                     sizeof(uint32_t)) { // Bitmap size unknown
+    return false;
+  }
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  reader.read(msg.readerId);
+  reader.read(msg.writerId);
+  reader.read(msg.readerSNState.base);
+  reader.read(msg.readerSNState.numBits);
+
+  if (msg.readerSNState.numBits > SNS_NUM_BITS) {
+    return false;
+  }
+
+  // Now we can check for full size
+  if (remainingSizeAtBeginning <
+      SubmessageAckNack::getRawSize(msg.readerSNState)) {
+    return false;
+  }
+
+  if (msg.readerSNState.numBits != 0) {
+    reader.readWords(msg.readerSNState.bitMap.data(),
+                     msg.readerSNState.getNumWords());
+  }
+  reader.read(msg.count.value);
   return true;
 }
 
-bool rtps::deserializeMessage(const MessageProcessingInfo &info,
-                              SubmessageData &msg) {
-  if (info.getRemainingSize() < SubmessageHeader::getRawSize()) {
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info, SubmessageGap &msg) {
+  const DataSize_t remainingSizeAtBeginning = info.getRemainingSize();
+  // The set needs its fixed part before numBits can be read
+  if (remainingSizeAtBeginning < SubmessageGap::getRawSizeWithoutSNSet() +
+                                     sizeof(SequenceNumber_t) +
+                                     sizeof(uint32_t)) {
     return false;
   }
-  if (!deserializeMessage(info, msg.header)) {
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  reader.read(msg.readerId);
+  reader.read(msg.writerId);
+  reader.read(msg.gapStart);
+  reader.read(msg.gapList.base);
+  reader.read(msg.gapList.numBits);
+
+  if (msg.gapList.numBits > SNS_NUM_BITS) {
     return false;
   }
 
+  // Now we can check for full size
+  if (remainingSizeAtBeginning < SubmessageGap::getRawSize(msg.gapList)) {
+    return false;
+  }
+
+  if (msg.gapList.numBits != 0) {
+    reader.readWords(msg.gapList.bitMap.data(), msg.gapList.getNumWords());
+  }
+  return true;
+}
+
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info,
+                   SubmessageDataFrag &msg) {
+  if (info.getRemainingSize() < SubmessageDataFrag::getRawSize()) {
+    return false;
+  }
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+
   // Check for length including data
   if (info.getRemainingSize() <
       SubmessageHeader::getRawSize() + msg.header.submessageLength) {
     return false;
   }
 
-  const uint8_t *currentPos =
-      info.getPointerToCurrentPos() + SubmessageHeader::getRawSize();
-
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.extraFlags), currentPos,
-                  sizeof(uint16_t));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.octetsToInlineQos),
-                  currentPos, sizeof(uint16_t));
-  doCopyAndMoveOn(msg.readerId.entityKey.data(), currentPos,
-                  msg.readerId.entityKey.size());
-  msg.readerId.entityKind = static_cast<EntityKind_t>(*currentPos++);
-  doCopyAndMoveOn(msg.writerId.entityKey.data(), currentPos,
-                  msg.writerId.entityKey.size());
-  msg.writerId.entityKind = static_cast<EntityKind_t>(*currentPos++);
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.writerSN.high), currentPos,
-                  sizeof(msg.writerSN.high));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.writerSN.low), currentPos,
-                  sizeof(msg.writerSN.low));
+  reader.read(msg.extraFlags);
+  reader.read(msg.octetsToInlineQos);
+  reader.read(msg.readerId);
+  reader.read(msg.writerId);
+  reader.read(msg.writerSN);
+  reader.read(msg.fragmentStartingNum.value);
+  reader.read(msg.fragmentsInSubmessage);
+  reader.read(msg.fragmentSize);
+  reader.read(msg.sampleSize);
   return true;
 }
 
-bool rtps::deserializeMessage(const MessageProcessingInfo &info,
-                              SubmessageHeartbeat &msg) {
-  if (info.getRemainingSize() < SubmessageHeartbeat::getRawSize()) {
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info,
+                   SubmessageNackFrag &msg) {
+  const DataSize_t remainingSizeAtBeginning = info.getRemainingSize();
+  if (remainingSizeAtBeginning <
+      SubmessageNackFrag::getRawSizeWithoutFNSet() + sizeof(FragmentNumber_t) +
+          sizeof(uint32_t)) { // Size of the bitmap unknown
     return false;
   }
-  if (!deserializeMessage(info, msg.header)) {
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  reader.read(msg.readerId);
+  reader.read(msg.writerId);
+  reader.read(msg.writerSN);
+  reader.read(msg.fragmentNumberState.base.value);
+  reader.read(msg.fragmentNumberState.numBits);
+
+  if (msg.fragmentNumberState.numBits > FNS_NUM_BITS) {
     return false;
   }
 
-  const uint8_t *currentPos =
-      info.getPointerToCurrentPos() + SubmessageHeader::getRawSize();
+  // Now we can check for full size
+  if (remainingSizeAtBeginning <
+      SubmessageNackFrag::getRawSize(msg.fragmentNumberState)) {
+    return false;
+  }
 
-  doCopyAndMoveOn(msg.readerId.entityKey.data(), currentPos,
-                  msg.readerId.entityKey.size());
-  msg.readerId.entityKind = static_cast<EntityKind_t>(*currentPos++);
-  doCopyAndMoveOn(msg.writerId.entityKey.data(), currentPos,
-                  msg.writerId.entityKey.size());
-  msg.writerId.entityKind = static_cast<EntityKind_t>(*currentPos++);
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.firstSN.high), currentPos,
-                  sizeof(msg.firstSN.high));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.firstSN.low), currentPos,
-                  sizeof(msg.firstSN.low));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.lastSN.high), currentPos,
-                  sizeof(msg.lastSN.high));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.lastSN.low), currentPos,
-                  sizeof(msg.lastSN.low));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.count.value), currentPos,
-                  sizeof(msg.count.value));
+  if (msg.fragmentNumberState.numBits != 0) {
+    reader.readWords(msg.fragmentNumberState.bitMap.data(),
+                     msg.fragmentNumberState.getNumWords());
+  }
+  reader.read(msg.count.value);
   return true;
 }
 
-bool rtps::deserializeMessage(const MessageProcessingInfo &info,
-                              SubmessageAckNack &msg) {
-  const DataSize_t remainingSizeAtBeginning = info.getRemainingSize();
-  if (remainingSizeAtBeginning <
-      SubmessageAckNack::
-          getRawSizeWithoutSNSet()) { // Size of SequenceNumberSet unknown
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info, SubmessageInfoDst &msg) {
+  if (info.getRemainingSize() < SubmessageInfoDst::getRawSize()) {
     return false;
   }
-  if (!deserializeMessage(info, msg.header)) {
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  reader.readBytes(msg.guidPrefix.id.data(), msg.guidPrefix.id.size());
+  return true;
+}
+
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info, SubmessageInfoSrc &msg) {
+  if (info.getRemainingSize() < SubmessageInfoSrc::getRawSize()) {
     return false;
   }
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  reader.skip(sizeof(uint32_t)); // unused
+  reader.readBytes(reinterpret_cast<uint8_t *>(&msg.protocolVersion),
+                   sizeof(ProtocolVersion_t));
+  reader.readBytes(msg.vendorId.vendorId.data(), msg.vendorId.vendorId.size());
+  reader.readBytes(msg.guidPrefix.id.data(), msg.guidPrefix.id.size());
+  return true;
+}
 
-  const uint8_t *currentPos =
-      info.getPointerToCurrentPos() + SubmessageHeader::getRawSize();
-
-  doCopyAndMoveOn(msg.readerId.entityKey.data(), currentPos,
-                  msg.readerId.entityKey.size());
-  msg.readerId.entityKind = static_cast<EntityKind_t>(*currentPos++);
-  doCopyAndMoveOn(msg.writerId.entityKey.data(), currentPos,
-                  msg.writerId.entityKey.size());
-  msg.writerId.entityKind = static_cast<EntityKind_t>(*currentPos++);
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.readerSNState.base.high),
-                  currentPos, sizeof(msg.readerSNState.base.high));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.readerSNState.base.low),
-                  currentPos, sizeof(msg.readerSNState.base.low));
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.readerSNState.numBits),
-                  currentPos, sizeof(uint32_t));
+template <bool Swap>
+bool deserializeAs(const MessageProcessingInfo &info, SubmessageInfoTs &msg) {
+  WireReader<Swap> reader(info.getPointerToCurrentPos());
+  readHeader(reader, msg.header);
+  if (msg.header.flags & FLAG_INVALIDATE) {
+    msg.timestamp = TIME_INVALID;
+    return true;
+  }
+  if (info.getRemainingSize() < SubmessageInfoTs::getRawSize()) {
+    return false;
+  }
+  reader.read(msg.timestamp.seconds);
+  reader.read(msg.timestamp.fraction);
+  return true;
+}
 
-  // Now we can check for full size
-  if (remainingSizeAtBeginning <
-      SubmessageAckNack::getRawSize(msg.readerSNState)) {
+//! Picks the variant matching the byte order flag of the submessage
+template <typename Submessage>
+bool deserializeSubmessage(const MessageProcessingInfo &info,
+                           Submessage &msg) {
+  if (info.getRemainingSize() < SubmessageHeader::getRawSize()) {
     return false;
   }
+  const uint8_t flags = info.getPointerToCurrentPos()[1];
+  if (isNativeByteOrder(flags)) {
+    return deserializeAs<false>(info, msg);
+  } else {
+    return deserializeAs<true>(info, msg);
+  }
+}
 
-  if (msg.readerSNState.numBits != 0) {
-    if (4 * ((msg.readerSNState.numBits / 32) + 1) >
-        msg.readerSNState.bitMap.size()) {
-      while (1)
-        ;
-    }
-    doCopyAndMoveOn(
-        reinterpret_cast<uint8_t *>(msg.readerSNState.bitMap.data()),
-        currentPos, 4 * ((msg.readerSNState.numBits / 32) + 1));
+} // namespace
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              Header &header) {
+  if (info.getRemainingSize() < Header::getRawSize()) {
+    return false;
   }
-  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&msg.count.value), currentPos,
-                  sizeof(msg.count.value));
+
+  const uint8_t *currentPos = info.getPointerToCurrentPos();
+  doCopyAndMoveOn(header.protocolName.data(), currentPos,
+                  sizeof(std::array<uint8_t, 4>));
+  doCopyAndMoveOn(reinterpret_cast<uint8_t *>(&header.protocolVersion),
+                  currentPos, sizeof(ProtocolVersion_t));
+  doCopyAndMoveOn(header.vendorId.vendorId.data(), currentPos,
+                  header.vendorId.vendorId.size());
+  doCopyAndMoveOn(header.guidPrefix.id.data(), currentPos,
+                  header.guidPrefix.id.size());
   return true;
 }
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageHeader &header) {
+  return deserializeSubmessage(info, header);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageData &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageHeartbeat &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageAckNack &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageGap &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageDataFrag &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageNackFrag &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageInfoDst &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageInfoSrc &msg) {
+  return deserializeSubmessage(info, msg);
+}
+
+bool rtps::deserializeMessage(const MessageProcessingInfo &info,
+                              SubmessageInfoTs &msg) {
+  return deserializeSubmessage(info, msg);
+}
@@ -0,0 +1,131 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#include "rtps/storages/FragmentBuffer.h"
+#include <cstring>
+
+using rtps::FragmentBuffer;
+
+#define FRAG_VERBOSE 0
+
+#if FRAG_VERBOSE
+#include "rtps/utils/printutils.h"
+#endif
+
+FragmentBuffer::~FragmentBuffer() { reset(); }
+
+bool FragmentBuffer::start(const Guid &writerGuid, const SequenceNumber_t &sn,
+                           uint32_t sampleSize, uint16_t fragmentSize) {
+  reset();
+  if (sampleSize == 0 || sampleSize > 0xFFFF || fragmentSize == 0) {
+    return false;
+  }
+  const uint32_t numFragments = (sampleSize + fragmentSize - 1) / fragmentSize;
+  if (numFragments > FNS_NUM_BITS) {
+#if FRAG_VERBOSE
+    printf("FragmentBuffer: Too many fragments (%u)\n", numFragments);
+#endif
+    return false;
+  }
+
+  // PBUF_RAM to get the sample in one piece
+  m_pbuf = pbuf_alloc(PBUF_RAW, static_cast<u16_t>(sampleSize), PBUF_RAM);
+  if (m_pbuf == nullptr) {
+#if FRAG_VERBOSE
+    printf("FragmentBuffer: No memory for %u bytes\n", sampleSize);
+#endif
+    return false;
+  }
+
+  m_writerGuid = writerGuid;
+  m_sn = sn;
+  m_sampleSize = static_cast<DataSize_t>(sampleSize);
+  m_fragmentSize = fragmentSize;
+  m_numFragments = static_cast<uint16_t>(numFragments);
+  return true;
+}
+
+void FragmentBuffer::reset() {
+  if (m_pbuf != nullptr) {
+    pbuf_free(m_pbuf);
+    m_pbuf = nullptr;
+  }
+  m_numReceived = 0;
+  m_received.fill(0);
+}
+
+bool FragmentBuffer::add(uint32_t firstFragment, uint16_t numFragments,
+                         uint16_t fragmentSize, const uint8_t *data,
+                         DataSize_t size) {
+  if (!isInUse() || fragmentSize != m_fragmentSize || firstFragment == 0 ||
+      firstFragment > m_numFragments) {
+    return false;
+  }
+
+  auto *sample = static_cast<uint8_t *>(m_pbuf->payload);
+  for (uint32_t i = 0; i < numFragments; ++i) {
+    const uint32_t index = firstFragment - 1 + i;
+    const uint32_t offset = index * m_fragmentSize;
+    if (index >= m_numFragments || static_cast<uint32_t>(i) * m_fragmentSize >=
+                                       size) {
+      break;
+    }
+    uint32_t length = m_sampleSize - offset < m_fragmentSize
+                          ? m_sampleSize - offset
+                          : m_fragmentSize;
+    if (i * m_fragmentSize + length > size) {
+      return false; // Truncated
+    }
+    if (isReceived(index)) {
+      continue;
+    }
+    memcpy(sample + offset, data + i * m_fragmentSize, length);
+    m_received[index / 32] |= uint32_t{1} << (index % 32);
+    ++m_numReceived;
+  }
+  return true;
+}
+
+rtps::FragmentNumberSet FragmentBuffer::getMissing() const {
+  FragmentNumberSet set;
+  uint32_t first = 0;
+  while (first < m_numFragments && isReceived(first)) {
+    ++first;
+  }
+  set.base.value = first + 1;
+  set.numBits = m_numFragments - first;
+  for (uint32_t bit = 0; bit < set.numBits; ++bit) {
+    if (!isReceived(first + bit)) {
+      set.set(bit);
+    }
+  }
+  return set;
+}
+
+const uint8_t *FragmentBuffer::getData() const {
+  return isInUse() ? static_cast<const uint8_t *>(m_pbuf->payload) : nullptr;
+}
+
+#undef FRAG_VERBOSE
@@ -143,6 +143,37 @@ void PBufWrapper::append(PBufWrapper &&other) {
   other.firstElement = nullptr;
 }
 
+bool PBufWrapper::appendCopy(const PBufWrapper &other) {
+  return appendCopy(other, 0, other.spaceUsed());
+}
+
+bool PBufWrapper::appendCopy(const PBufWrapper &other, DataSize_t offset,
+                             DataSize_t length) {
+  if (offset + length > other.spaceUsed() || !reserve(length)) {
+    return false;
+  }
+
+  DataSize_t copied = 0;
+  for (const pbuf *element = other.firstElement;
+       element != nullptr && copied < length; element = element->next) {
+    if (offset >= element->len) {
+      offset -= element->len;
+      continue;
+    }
+    DataSize_t chunk = length - copied;
+    if (element->len - offset < chunk) {
+      chunk = element->len - offset;
+    }
+    if (!append(static_cast<const uint8_t *>(element->payload) + offset,
+                chunk)) {
+      return false;
+    }
+    copied += chunk;
+    offset = 0;
+  }
+  return true;
+}
+
 bool PBufWrapper::reserve(DataSize_t length) {
   auto additionalAllocation = length - m_freeSpace;
   if (additionalAllocation <= 0) {
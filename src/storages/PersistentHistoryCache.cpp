@@ -0,0 +1,308 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#if defined(unix) || defined(__unix__)
+
+#include "rtps/storages/PersistentHistoryCache.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using rtps::PersistentHistoryCache;
+
+#define PHC_VERBOSE 0
+
+#if PHC_VERBOSE
+#include <cstdio>
+#endif
+
+namespace {
+rtps::SequenceNumber_t predecessor(rtps::SequenceNumber_t sn) {
+  if (sn.low == 0) {
+    --sn.high;
+  }
+  --sn.low;
+  return sn;
+}
+} // namespace
+
+PersistentHistoryCache::~PersistentHistoryCache() { close(); }
+
+bool PersistentHistoryCache::open(const char *path) {
+  close();
+
+  m_fd = ::open(path, O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0) {
+#if PHC_VERBOSE
+    printf("PersistentHistoryCache: Failed to open %s\n", path);
+#endif
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(m_fd, &fileStat) != 0) {
+    close();
+    return false;
+  }
+  const bool sizeMatches = static_cast<size_t>(fileStat.st_size) == FILE_SIZE;
+  if (!sizeMatches && ftruncate(m_fd, FILE_SIZE) != 0) {
+    close();
+    return false;
+  }
+
+  void *mapping =
+      mmap(nullptr, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (mapping == MAP_FAILED) {
+#if PHC_VERBOSE
+    printf("PersistentHistoryCache: Failed to map %s\n", path);
+#endif
+    close();
+    return false;
+  }
+  mp_mapping = static_cast<uint8_t *>(mapping);
+
+  const FileHeader &header = fileHeader();
+  if (!sizeMatches || header.magic != FILE_MAGIC ||
+      header.version != FILE_VERSION || header.numRecords != NUM_RECORDS ||
+      header.recordSize != RECORD_SIZE) {
+    return formatFile();
+  }
+
+  recover();
+  return true;
+}
+
+void PersistentHistoryCache::close() {
+  for (auto &change : m_changes) {
+    change = CacheChange{};
+  }
+  m_numChanges = 0;
+
+  if (mp_mapping != nullptr) {
+    msync(mp_mapping, FILE_SIZE, MS_SYNC);
+    munmap(mp_mapping, FILE_SIZE);
+    mp_mapping = nullptr;
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+bool PersistentHistoryCache::isOpen() const { return mp_mapping != nullptr; }
+
+bool PersistentHistoryCache::formatFile() {
+  memset(mp_mapping, 0, FILE_SIZE); // ChangeKind_t::INVALID is 0
+
+  FileHeader &header = fileHeader();
+  header.magic = FILE_MAGIC;
+  header.version = FILE_VERSION;
+  header.numRecords = NUM_RECORDS;
+  header.recordSize = RECORD_SIZE;
+  header.lastUsedSequenceNumber = {0, 0};
+
+  m_lastUsedSequenceNumber = {0, 0};
+  m_minSequenceNumber = {0, 0};
+  m_numChanges = 0;
+
+  return msync(mp_mapping, FILE_SIZE, MS_SYNC) == 0;
+}
+
+void PersistentHistoryCache::recover() {
+  // The record is written before the file header, so a crash in between
+  // leaves a record newer than the header
+  m_lastUsedSequenceNumber = fileHeader().lastUsedSequenceNumber;
+  for (uint16_t slot = 0; slot < NUM_RECORDS; ++slot) {
+    const RecordHeader &record = recordHeader(slot);
+    if (record.kind != ChangeKind_t::INVALID &&
+        slotOf(record.sequenceNumber) == slot &&
+        m_lastUsedSequenceNumber < record.sequenceNumber) {
+      m_lastUsedSequenceNumber = record.sequenceNumber;
+    }
+  }
+  fileHeader().lastUsedSequenceNumber = m_lastUsedSequenceNumber;
+
+  // Retained changes are the consecutive run ending at the last used number
+  m_numChanges = 0;
+  SequenceNumber_t sn = m_lastUsedSequenceNumber;
+  while (m_numChanges < NUM_RECORDS && SequenceNumber_t{0, 0} < sn) {
+    const uint16_t slot = slotOf(sn);
+    const RecordHeader &record = recordHeader(slot);
+    if (record.kind == ChangeKind_t::INVALID || record.sequenceNumber != sn ||
+        record.size > Config::PERSISTENT_HISTORY_MAX_SAMPLE_SIZE ||
+        !referencePayload(slot)) {
+      break;
+    }
+    m_minSequenceNumber = sn;
+    ++m_numChanges;
+    sn = predecessor(sn);
+  }
+
+#if PHC_VERBOSE
+  printf("PersistentHistoryCache: Recovered %u changes, last SN (%i,%u)\n",
+         m_numChanges, m_lastUsedSequenceNumber.high,
+         m_lastUsedSequenceNumber.low);
+#endif
+}
+
+bool PersistentHistoryCache::isFull() const {
+  return m_numChanges == NUM_RECORDS;
+}
+
+const rtps::SequenceNumber_t &PersistentHistoryCache::getSeqNumMin() const {
+  if (m_numChanges == 0) {
+    return SEQUENCENUMBER_UNKNOWN;
+  } else {
+    return m_minSequenceNumber;
+  }
+}
+
+const rtps::SequenceNumber_t &PersistentHistoryCache::getSeqNumMax() const {
+  if (m_numChanges == 0) {
+    return SEQUENCENUMBER_UNKNOWN;
+  } else {
+    return m_lastUsedSequenceNumber;
+  }
+}
+
+const rtps::SequenceNumber_t &
+PersistentHistoryCache::getLastUsedSequenceNumber() const {
+  return m_lastUsedSequenceNumber;
+}
+
+const rtps::CacheChange *
+PersistentHistoryCache::addChange(const uint8_t *data, DataSize_t size) {
+  if (!isOpen() || size > Config::PERSISTENT_HISTORY_MAX_SAMPLE_SIZE) {
+    return nullptr;
+  }
+
+  if (isFull()) {
+    invalidateOldest();
+  }
+
+  SequenceNumber_t sn = m_lastUsedSequenceNumber;
+  ++sn;
+  const uint16_t slot = slotOf(sn);
+  m_changes[slot] = CacheChange{};
+
+  RecordHeader &record = recordHeader(slot);
+  record.kind = ChangeKind_t::INVALID; // Torn records are not recovered
+  memcpy(recordPayload(slot), data, size);
+  record.sequenceNumber = sn;
+  record.size = size;
+  record.kind = ChangeKind_t::ALIVE;
+
+  m_lastUsedSequenceNumber = sn;
+  fileHeader().lastUsedSequenceNumber = sn;
+
+  if (m_numChanges == 0) {
+    m_minSequenceNumber = sn;
+  }
+  ++m_numChanges;
+
+  if (!referencePayload(slot)) {
+    // Keep the record but hand out nothing we cannot reference
+    return nullptr;
+  }
+  return &m_changes[slot];
+}
+
+void PersistentHistoryCache::dropOldest() { invalidateOldest(); }
+
+void PersistentHistoryCache::removeUntilIncl(SequenceNumber_t sn) {
+  while (m_numChanges != 0 && m_minSequenceNumber <= sn) {
+    invalidateOldest();
+  }
+}
+
+const rtps::CacheChange *
+PersistentHistoryCache::getChangeBySN(SequenceNumber_t sn) const {
+  if (m_numChanges == 0 || sn < m_minSequenceNumber ||
+      m_lastUsedSequenceNumber < sn) {
+    return nullptr;
+  }
+  const CacheChange &change = m_changes[slotOf(sn)];
+  if (!change.data.isValid()) {
+    return nullptr;
+  }
+  return &change;
+}
+
+void PersistentHistoryCache::invalidateOldest() {
+  if (m_numChanges == 0) {
+    return;
+  }
+  const uint16_t slot = slotOf(m_minSequenceNumber);
+  recordHeader(slot).kind = ChangeKind_t::INVALID;
+  m_changes[slot] = CacheChange{};
+  ++m_minSequenceNumber;
+  --m_numChanges;
+}
+
+bool PersistentHistoryCache::referencePayload(uint16_t slot) {
+  const RecordHeader &record = recordHeader(slot);
+  pbuf *reference = pbuf_alloc(PBUF_RAW, record.size, PBUF_REF);
+  if (reference == nullptr) {
+#if PHC_VERBOSE
+    printf("PersistentHistoryCache: Failed to allocate reference pbuf\n");
+#endif
+    return false;
+  }
+  reference->payload = recordPayload(slot);
+
+  CacheChange &change = m_changes[slot];
+  change.kind = record.kind;
+  change.sequenceNumber = record.sequenceNumber;
+  change.data = PBufWrapper(reference);
+  return true;
+}
+
+PersistentHistoryCache::FileHeader &PersistentHistoryCache::fileHeader() const {
+  return *reinterpret_cast<FileHeader *>(mp_mapping);
+}
+
+PersistentHistoryCache::RecordHeader &
+PersistentHistoryCache::recordHeader(uint16_t slot) const {
+  return *reinterpret_cast<RecordHeader *>(mp_mapping + sizeof(FileHeader) +
+                                           slot * RECORD_SIZE);
+}
+
+uint8_t *PersistentHistoryCache::recordPayload(uint16_t slot) const {
+  return mp_mapping + sizeof(FileHeader) + slot * RECORD_SIZE +
+         sizeof(RecordHeader);
+}
+
+uint16_t PersistentHistoryCache::slotOf(const SequenceNumber_t &sn) {
+  const uint64_t value =
+      (static_cast<uint64_t>(static_cast<uint32_t>(sn.high)) << 32) | sn.low;
+  return static_cast<uint16_t>(value % NUM_RECORDS);
+}
+
+#undef PHC_VERBOSE
+
+#endif // unix
@@ -0,0 +1,146 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#include "rtps/storages/ReaderHistory.h"
+#include "rtps/utils/Lock.h"
+
+using rtps::ReaderHistory;
+
+#define RH_VERBOSE 0
+
+#if RH_VERBOSE
+#include "rtps/utils/printutils.h"
+#endif
+
+ReaderHistory::~ReaderHistory() {
+  if (isEnabled()) {
+    sys_mutex_free(&m_mutex);
+  }
+}
+
+bool ReaderHistory::init(HistoryKind_t kind, uint8_t depth) {
+  if (isEnabled() || depth == 0 || depth > m_samples.size()) {
+    return false;
+  }
+  if (sys_mutex_new(&m_mutex) != ERR_OK) {
+#if RH_VERBOSE
+    printf("ReaderHistory: Failed to create mutex\n");
+#endif
+    return false;
+  }
+  m_kind = kind;
+  m_depth = depth;
+  return true;
+}
+
+bool ReaderHistory::add(ChangeKind_t kind, const Guid &writerGuid,
+                        const SequenceNumber_t &sn, pbuf *packet,
+                        const uint8_t *data, DataSize_t size) {
+  ReaderSample sample;
+  if (packet != nullptr) {
+    pbuf_ref(packet);
+    sample.packet = PBufWrapper(packet);
+    sample.data = data;
+  } else if (size != 0) {
+    // Nothing to keep a reference to, e.g. a change that was put together
+    // locally. Fall back to copying it.
+    pbuf *copy = pbuf_alloc(PBUF_RAW, size, PBUF_RAM);
+    if (copy == nullptr) {
+      return false;
+    }
+    pbuf_take(copy, data, size);
+    sample.packet = PBufWrapper(copy);
+    sample.data = static_cast<const uint8_t *>(copy->payload);
+  }
+  sample.kind = kind;
+  sample.writerGuid = writerGuid;
+  sample.sn = sn;
+  sample.size = size;
+
+  Lock lock{m_mutex};
+  if (m_numSamples == m_depth) {
+    if (m_kind == HistoryKind_t::KEEP_ALL) {
+      return false;
+    }
+#if RH_VERBOSE
+    printf("ReaderHistory: Dropping oldest sample\n");
+#endif
+    m_samples[m_head] = ReaderSample{};
+    m_head = slotOf(1);
+    --m_numSamples;
+  }
+  if (m_numSamples == 0) {
+    m_wakeup = true;
+  }
+  m_samples[slotOf(m_numSamples)] = std::move(sample);
+  ++m_numSamples;
+  return true;
+}
+
+uint32_t ReaderHistory::take(ReaderSample *samples, uint32_t maxSamples) {
+  if (!isEnabled()) {
+    return 0;
+  }
+  Lock lock{m_mutex};
+  uint32_t num = 0;
+  for (; num < maxSamples && m_numSamples != 0; ++num) {
+    samples[num] = std::move(m_samples[m_head]);
+    m_head = slotOf(1);
+    --m_numSamples;
+  }
+  return num;
+}
+
+uint32_t ReaderHistory::read(ReaderSample *samples, uint32_t maxSamples) {
+  if (!isEnabled()) {
+    return 0;
+  }
+  Lock lock{m_mutex};
+  uint32_t num = 0;
+  for (; num < maxSamples && num < m_numSamples; ++num) {
+    samples[num] = m_samples[slotOf(num)];
+  }
+  return num;
+}
+
+uint32_t ReaderHistory::getNumSamples() {
+  if (!isEnabled()) {
+    return 0;
+  }
+  Lock lock{m_mutex};
+  return m_numSamples;
+}
+
+bool ReaderHistory::takeWakeup() {
+  if (!isEnabled()) {
+    return false;
+  }
+  Lock lock{m_mutex};
+  const bool wakeup = m_wakeup;
+  m_wakeup = false;
+  return wakeup;
+}
+
+#undef RH_VERBOSE
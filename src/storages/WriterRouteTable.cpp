@@ -0,0 +1,105 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+
+#include "rtps/storages/WriterRouteTable.h"
+#include "rtps/utils/Lock.h"
+
+using rtps::WriterRouteTable;
+
+#define ROUTE_VERBOSE 0
+
+#if ROUTE_VERBOSE
+#include "rtps/utils/printutils.h"
+#endif
+
+WriterRouteTable::WriterRouteTable() {
+  if (sys_mutex_new(&m_mutex) != ERR_OK) {
+#if ROUTE_VERBOSE
+    printf("WriterRouteTable: Failed to create mutex\n");
+#endif
+  }
+}
+
+WriterRouteTable::~WriterRouteTable() { sys_mutex_free(&m_mutex); }
+
+bool WriterRouteTable::add(const Guid &writerGuid, Reader *reader) {
+  if (reader == nullptr) {
+    return false;
+  }
+  Lock lock{m_mutex};
+  Route *route = findRoute(writerGuid);
+  if (route == nullptr) {
+    route = findRoute(Guid{GUIDPREFIX_UNKNOWN, ENTITYID_UNKNOWN});
+    if (route == nullptr) {
+#if ROUTE_VERBOSE
+      printf("WriterRouteTable: No free route left\n");
+#endif
+      return false;
+    }
+    route->writerGuid = writerGuid;
+    route->numReaders = 0;
+  }
+
+  for (uint8_t i = 0; i < route->numReaders; ++i) {
+    if (route->readers[i] == reader) {
+      return true;
+    }
+  }
+  if (route->numReaders == route->readers.size()) {
+    return false;
+  }
+  route->readers[route->numReaders++] = reader;
+  return true;
+}
+
+uint8_t WriterRouteTable::find(const Guid &writerGuid, ReaderList &readers) {
+  Lock lock{m_mutex};
+  const Route *route = findRoute(writerGuid);
+  if (route == nullptr) {
+    return 0;
+  }
+  readers = route->readers;
+  return route->numReaders;
+}
+
+void WriterRouteTable::removeParticipant(const GuidPrefix_t &prefix) {
+  Lock lock{m_mutex};
+  for (auto &route : m_routes) {
+    if (route.writerGuid.prefix == prefix) {
+      route = Route{};
+    }
+  }
+}
+
+WriterRouteTable::Route *WriterRouteTable::findRoute(const Guid &writerGuid) {
+  for (auto &route : m_routes) {
+    if (route.writerGuid == writerGuid) {
+      return &route;
+    }
+  }
+  return nullptr;
+}
+
+#undef ROUTE_VERBOSE
@@ -0,0 +1,83 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#ifndef RTPS_NETWORKDRIVERMOCK_H
+#define RTPS_NETWORKDRIVERMOCK_H
+
+#include "rtps/communication/PacketInfo.h"
+
+#include <mutex>
+#include <vector>
+
+namespace rtps {
+
+/**
+ * Stands in for UdpDriver as NetworkDriver of the endpoint templates. Every
+ * message is copied out of its pbufs and kept for inspection.
+ */
+class NetworkDriverMock {
+public:
+  struct SentMessage {
+    ip4_addr_t destAddr;
+    Ip4Port_t destPort;
+    std::vector<uint8_t> data;
+  };
+
+  const UdpConnection *createUdpConnection(Ip4Port_t) { return nullptr; }
+
+  void sendPacket(PacketInfo &info) {
+    SentMessage message;
+    message.destAddr = info.destAddr;
+    message.destPort = info.destPort;
+    message.data.resize(info.buffer.spaceUsed());
+    pbuf_copy_partial(info.buffer.firstElement, message.data.data(),
+                      message.data.size(), 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sent.push_back(std::move(message));
+  }
+
+  void sendPackets(PacketInfo *packets, uint8_t numPackets) {
+    for (uint8_t i = 0; i < numPackets; ++i) {
+      sendPacket(packets[i]);
+    }
+  }
+
+  std::vector<SentMessage> getSent() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sent;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sent.clear();
+  }
+
+private:
+  std::mutex m_mutex;
+  std::vector<SentMessage> m_sent;
+};
+
+} // namespace rtps
+
+#endif // RTPS_NETWORKDRIVERMOCK_H
@@ -0,0 +1,172 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/communication/MessageAggregator.h"
+#include "rtps/messages/MessageFactory.h"
+#include "unittests/utils/MessageUtils.h"
+
+#include <vector>
+
+using rtps::MessageAggregator;
+using rtps::PacketInfo;
+using rtps::PBufWrapper;
+using rtps::SubmessageKind;
+using rtps::test::SubmessageView;
+
+namespace {
+class MessageAggregatorTest : public ::testing::Test {
+protected:
+  std::vector<std::vector<uint8_t>> sent;
+  MessageAggregator aggregator{send, this};
+  const rtps::GuidPrefix_t prefix{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  const rtps::EntityId_t writerId{
+      {1, 2, 3}, rtps::EntityKind_t::USER_DEFINED_WRITER_WITHOUT_KEY};
+
+  static void send(void *callee, PacketInfo &packet) {
+    auto *test = static_cast<MessageAggregatorTest *>(callee);
+    std::vector<uint8_t> message(packet.buffer.spaceUsed());
+    pbuf_copy_partial(packet.buffer.firstElement, message.data(),
+                      static_cast<uint16_t>(message.size()), 0);
+    test->sent.push_back(message);
+  }
+
+  void makePacket(PacketInfo &packet) {
+    packet.srcPort = 7410;
+    packet.destPort = 7411;
+    packet.destAddr.addr = 0x0100007f;
+    rtps::MessageFactory::addHeader(packet.buffer, prefix);
+    rtps::MessageFactory::addSubMessageDestination(packet.buffer);
+  }
+
+  //! Ends the message with sample, chained without copy like a writer does
+  void makeDataPacket(PacketInfo &packet, const std::vector<uint8_t> &sample) {
+    makePacket(packet);
+    PBufWrapper payload(static_cast<rtps::DataSize_t>(sample.size()));
+    payload.append(sample.data(), static_cast<rtps::DataSize_t>(sample.size()));
+    rtps::MessageFactory::addSubMessageData(packet.buffer, payload, false,
+                                            {0, 1}, writerId,
+                                            rtps::ENTITYID_UNKNOWN);
+  }
+
+  void makeHeartbeatPacket(PacketInfo &packet) {
+    makePacket(packet);
+    rtps::MessageFactory::addHeartbeat(packet.buffer, writerId,
+                                       rtps::ENTITYID_UNKNOWN, {0, 1}, {0, 1},
+                                       rtps::Count_t{1}, true);
+  }
+
+  std::vector<SubmessageView> split(const std::vector<uint8_t> &message) {
+    std::vector<SubmessageView> submessages;
+    EXPECT_TRUE(rtps::test::splitMessage(message, submessages));
+    return submessages;
+  }
+};
+
+const std::vector<uint8_t> encapsulatedSample{0x00, 0x01, 0x00, 0x00,
+                                              'a',  'b',  'c'};
+} // namespace
+
+TEST_F(MessageAggregatorTest, PadsChainedPayloadBeforeNextMessage) {
+  PacketInfo data;
+  makeDataPacket(data, encapsulatedSample);
+  PacketInfo heartbeat;
+  makeHeartbeatPacket(heartbeat);
+  EXPECT_TRUE(aggregator.add(data));
+  EXPECT_FALSE(aggregator.add(heartbeat));
+  aggregator.flush();
+
+  ASSERT_EQ(sent.size(), 1u);
+  const auto submessages = split(sent[0]);
+  ASSERT_EQ(submessages.size(), 4u);
+  EXPECT_EQ(submessages[1].kind, SubmessageKind::DATA);
+  EXPECT_EQ(submessages[3].kind, SubmessageKind::HEARTBEAT);
+
+  // The padding is recorded in the encapsulation options
+  const uint8_t padding = 1;
+  const uint32_t payloadOffset =
+      submessages[1].offset + rtps::SubmessageData::getRawSize();
+  EXPECT_EQ(submessages[1].length,
+            rtps::SubmessageData::getRawSize() -
+                rtps::SubmessageHeader::getRawSize() +
+                encapsulatedSample.size() + padding);
+  EXPECT_EQ(sent[0][payloadOffset + 3], padding);
+  EXPECT_EQ(sent[0][payloadOffset + encapsulatedSample.size()], 0);
+}
+
+TEST_F(MessageAggregatorTest, SendsUnpaddablePayloadOnItsOwn) {
+  // Without encapsulation the receiver could not strip the padding
+  PacketInfo data;
+  makeDataPacket(data, {'a', 'b', 'c', 'd', 'e'});
+  PacketInfo heartbeat;
+  makeHeartbeatPacket(heartbeat);
+  aggregator.add(data);
+  aggregator.add(heartbeat);
+  aggregator.flush();
+
+  ASSERT_EQ(sent.size(), 2u);
+  EXPECT_EQ(rtps::test::countSubmessages(sent[0], SubmessageKind::DATA), 1u);
+  EXPECT_EQ(
+      rtps::test::countSubmessages(sent[1], SubmessageKind::HEARTBEAT), 1u);
+  EXPECT_TRUE(rtps::test::isAligned(sent[1]));
+}
+
+TEST_F(MessageAggregatorTest, FixesLengthOfSubmessageUntilEnd) {
+  PacketInfo data;
+  makeDataPacket(data, {0x00, 0x01, 0x00, 0x00, 'a', 'b'});
+  // Length 0: the DATA extends to the end of the message
+  const uint8_t zeroLength[2] = {0, 0};
+  const uint16_t dataOffset = rtps::Header::getRawSize() +
+                              rtps::SubmessageInfoDst::getRawSize();
+  pbuf_take_at(data.buffer.firstElement, zeroLength, sizeof(zeroLength),
+               dataOffset + 2);
+  PacketInfo heartbeat;
+  makeHeartbeatPacket(heartbeat);
+  aggregator.add(data);
+  aggregator.add(heartbeat);
+  aggregator.flush();
+
+  ASSERT_EQ(sent.size(), 1u);
+  const auto submessages = split(sent[0]);
+  ASSERT_EQ(submessages.size(), 4u);
+  EXPECT_EQ(submessages[1].kind, SubmessageKind::DATA);
+  EXPECT_EQ(submessages[3].kind, SubmessageKind::HEARTBEAT);
+}
+
+TEST_F(MessageAggregatorTest, KeepsAlignedMessagesUnchanged) {
+  PacketInfo first;
+  makeHeartbeatPacket(first);
+  PacketInfo second;
+  makeHeartbeatPacket(second);
+  const uint16_t size = first.buffer.spaceUsed();
+  aggregator.add(first);
+  aggregator.add(second);
+  aggregator.flush();
+
+  ASSERT_EQ(sent.size(), 1u);
+  // The second INFO_DST is kept, no padding added
+  EXPECT_EQ(sent[0].size(), 2u * size - rtps::Header::getRawSize());
+  EXPECT_TRUE(rtps::test::isAligned(sent[0]));
+}
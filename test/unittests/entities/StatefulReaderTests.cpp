@@ -0,0 +1,167 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "mocking/NetworkDriverMock.h"
+#include "rtps/entities/StatefulReader.h"
+
+#include <vector>
+
+using rtps::ChangeKind_t;
+using rtps::Guid;
+using rtps::ReaderCacheChange;
+using rtps::SequenceNumber_t;
+
+namespace {
+constexpr uint8_t WINDOW = rtps::Config::SF_READER_REORDER_WINDOW_SIZE;
+
+class StatefulReaderTest : public ::testing::Test {
+protected:
+  rtps::NetworkDriverMock driver;
+  rtps::StatefulReaderT<rtps::NetworkDriverMock> reader;
+  Guid writerGuid{
+      {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},
+      {{1, 2, 3}, rtps::EntityKind_t::USER_DEFINED_WRITER_WITHOUT_KEY}};
+  std::vector<uint32_t> delivered;
+  std::vector<std::vector<uint8_t>> payloads;
+
+  static void callback(void *callee, const ReaderCacheChange &change) {
+    auto *test = static_cast<StatefulReaderTest *>(callee);
+    test->delivered.push_back(change.sn.low);
+    test->payloads.emplace_back(change.data, change.data + change.size);
+    // Payload starts with its own sequence number
+    EXPECT_EQ(change.data[0], static_cast<uint8_t>(change.sn.low));
+  }
+
+  void SetUp() override {
+    rtps::TopicData attributes;
+    attributes.reliabilityKind = rtps::ReliabilityKind_t::RELIABLE;
+    reader.init(attributes, driver);
+    reader.registerCallback(callback, this);
+    ASSERT_TRUE(reader.addNewMatchedWriter(rtps::WriterProxy{writerGuid, {}}));
+  }
+
+  void receive(uint32_t sn) {
+    pbuf *packet = pbuf_alloc(PBUF_RAW, 1, PBUF_POOL);
+    ASSERT_NE(packet, nullptr);
+    auto *data = static_cast<uint8_t *>(packet->payload);
+    data[0] = static_cast<uint8_t>(sn);
+    ReaderCacheChange change{ChangeKind_t::ALIVE, writerGuid,
+                             SequenceNumber_t{0, sn}, data, 1, packet};
+    reader.newChange(change);
+    // Buffered changes hold their own reference
+    pbuf_free(packet);
+  }
+
+  //! Fragment fragmentNum of a sample of sampleSize bytes with SN sn whose
+  //! byte i is sn + i, padded like a sender does
+  void receiveFragment(uint32_t sn, uint32_t fragmentNum, uint16_t sampleSize,
+                       uint16_t fragmentSize) {
+    rtps::SubmessageDataFrag msg;
+    msg.writerId = writerGuid.entityId;
+    msg.writerSN = {0, sn};
+    msg.fragmentStartingNum.value = fragmentNum;
+    msg.fragmentsInSubmessage = 1;
+    msg.fragmentSize = fragmentSize;
+    msg.sampleSize = sampleSize;
+    std::vector<uint8_t> data(fragmentSize, 0);
+    const uint32_t offset = (fragmentNum - 1) * fragmentSize;
+    for (uint32_t i = 0; i < fragmentSize && offset + i < sampleSize; ++i) {
+      data[i] = static_cast<uint8_t>(sn + offset + i);
+    }
+    reader.onNewDataFrag(msg, writerGuid.prefix, data.data(),
+                         static_cast<rtps::DataSize_t>(data.size()));
+  }
+};
+} // namespace
+
+TEST_F(StatefulReaderTest, DeliversInOrderChangesImmediately) {
+  receive(1);
+  receive(2);
+  EXPECT_EQ(delivered, (std::vector<uint32_t>{1, 2}));
+}
+
+TEST_F(StatefulReaderTest, HoldsChangesBackUntilGapIsFilled) {
+  receive(3);
+  receive(2);
+  EXPECT_TRUE(delivered.empty());
+
+  receive(1);
+  EXPECT_EQ(delivered, (std::vector<uint32_t>{1, 2, 3}));
+}
+
+TEST_F(StatefulReaderTest, DropsDuplicates) {
+  receive(2);
+  receive(2);
+  receive(1);
+  receive(1);
+  receive(2);
+  EXPECT_EQ(delivered, (std::vector<uint32_t>{1, 2}));
+}
+
+TEST_F(StatefulReaderTest, DropsChangesBeyondWindow) {
+  receive(2 + WINDOW);
+  receive(1 + WINDOW);
+  for (uint32_t sn = 1; sn <= WINDOW; ++sn) {
+    receive(sn);
+  }
+
+  // 2 + WINDOW was outside the window when it arrived and is requested again
+  std::vector<uint32_t> expected;
+  for (uint32_t sn = 1; sn <= 1u + WINDOW; ++sn) {
+    expected.push_back(sn);
+  }
+  EXPECT_EQ(delivered, expected);
+}
+
+TEST_F(StatefulReaderTest, ReassemblesFragmentedSample) {
+  const uint16_t sampleSize = 10;
+  receive(1);
+  receiveFragment(2, 3, sampleSize, 4);
+  receiveFragment(2, 1, sampleSize, 4);
+  EXPECT_EQ(delivered, (std::vector<uint32_t>{1}));
+
+  receiveFragment(2, 2, sampleSize, 4);
+
+  ASSERT_EQ(delivered, (std::vector<uint32_t>{1, 2}));
+  std::vector<uint8_t> expected(sampleSize);
+  for (uint8_t i = 0; i < sampleSize; ++i) {
+    expected[i] = static_cast<uint8_t>(2 + i);
+  }
+  EXPECT_EQ(payloads[1], expected);
+}
+
+TEST_F(StatefulReaderTest, ReassemblesSampleAheadOfExpected) {
+  const uint16_t sampleSize = 6;
+  receiveFragment(2, 2, sampleSize, 4);
+  receiveFragment(2, 1, sampleSize, 4);
+  EXPECT_TRUE(delivered.empty());
+
+  receive(1);
+
+  EXPECT_EQ(delivered, (std::vector<uint32_t>{1, 2}));
+  ASSERT_EQ(payloads.size(), 2u);
+  EXPECT_EQ(payloads[1].size(), sampleSize);
+}
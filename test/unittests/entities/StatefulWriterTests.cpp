@@ -0,0 +1,370 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "mocking/NetworkDriverMock.h"
+#include "rtps/entities/StatefulWriter.h"
+#include "unittests/utils/MessageUtils.h"
+
+#include <vector>
+
+using rtps::ChangeKind_t;
+using rtps::Guid;
+using rtps::SequenceNumberSet;
+using rtps::SubmessageKind;
+
+namespace {
+class StatefulWriterTest : public ::testing::Test {
+protected:
+  rtps::NetworkDriverMock driver;
+  rtps::StatefulWriterT<rtps::NetworkDriverMock> writer;
+  const rtps::GuidPrefix_t readerPrefix{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  const Guid readerGuid{
+      readerPrefix,
+      {{4, 5, 6}, rtps::EntityKind_t::USER_DEFINED_READER_WITHOUT_KEY}};
+  int32_t ackNackCount = 0;
+
+  void SetUp() override {
+    rtps::TopicData attributes;
+    attributes.endpointGuid.entityId = {
+        {1, 2, 3}, rtps::EntityKind_t::USER_DEFINED_WRITER_WITHOUT_KEY};
+    attributes.reliabilityKind = rtps::ReliabilityKind_t::RELIABLE;
+    attributes.unicastLocator = rtps::getUserUnicastLocator(0);
+    // Without a thread pool nothing is pushed, only requested changes are sent
+    ASSERT_TRUE(
+        writer.init(attributes, rtps::TopicKind_t::NO_KEY, nullptr, driver));
+    ASSERT_TRUE(writer.addNewMatchedReader(
+        rtps::ReaderProxy{readerGuid, rtps::getUserUnicastLocator(1)}));
+  }
+
+  //! CDR encapsulated samples with every size remainder modulo 4
+  void addChanges(uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+      std::vector<uint8_t> sample(5 + i % 4, static_cast<uint8_t>(i));
+      sample[0] = 0x00;
+      sample[1] = 0x01;
+      sample[2] = 0x00;
+      sample[3] = 0x00;
+      ASSERT_NE(writer.newChange(ChangeKind_t::ALIVE, sample.data(),
+                                 static_cast<rtps::DataSize_t>(sample.size())),
+                nullptr);
+    }
+  }
+
+  //! CDR encapsulated sample of size bytes
+  void addChange(rtps::DataSize_t size) {
+    std::vector<uint8_t> sample(size, 0xab);
+    sample[0] = 0x00;
+    sample[1] = 0x01;
+    sample[2] = 0x00;
+    sample[3] = 0x00;
+    ASSERT_NE(writer.newChange(ChangeKind_t::ALIVE, sample.data(), size),
+              nullptr);
+  }
+
+  void requestAll(uint32_t numChanges) {
+    rtps::SubmessageAckNack msg;
+    msg.readerId = readerGuid.entityId;
+    msg.writerId = writer.m_attributes.endpointGuid.entityId;
+    msg.readerSNState = SequenceNumberSet({0, 1});
+    msg.readerSNState.numBits = numChanges;
+    for (uint32_t bit = 0; bit < numChanges; ++bit) {
+      msg.readerSNState.set(bit);
+    }
+    msg.count = {++ackNackCount};
+    writer.onNewAckNack(msg, readerPrefix);
+  }
+
+  //! Messages with user data, periodic heartbeats are left out
+  std::vector<std::vector<uint8_t>> getDataMessages() {
+    std::vector<std::vector<uint8_t>> messages;
+    for (const auto &sent : driver.getSent()) {
+      if (rtps::test::countSubmessages(sent.data, SubmessageKind::DATA) != 0 ||
+          rtps::test::countSubmessages(sent.data, SubmessageKind::GAP) != 0) {
+        messages.push_back(sent.data);
+      }
+    }
+    return messages;
+  }
+};
+} // namespace
+
+TEST_F(StatefulWriterTest, PacksRequestedChangesAligned) {
+  const uint32_t numChanges = 6;
+  addChanges(numChanges);
+  requestAll(numChanges);
+
+  const auto messages = getDataMessages();
+  ASSERT_FALSE(messages.empty());
+  EXPECT_LT(messages.size(), numChanges);
+  uint32_t numData = 0;
+  for (const auto &message : messages) {
+    EXPECT_TRUE(rtps::test::isAligned(message));
+    numData += rtps::test::countSubmessages(message, SubmessageKind::DATA);
+  }
+  EXPECT_EQ(numData, numChanges);
+}
+
+TEST_F(StatefulWriterTest, PacksGapForEvictedChangesAligned) {
+  const uint32_t numChanges = rtps::Config::HISTORY_SIZE + 2;
+  addChanges(numChanges);
+  requestAll(numChanges);
+
+  const auto messages = getDataMessages();
+  ASSERT_FALSE(messages.empty());
+  uint32_t numData = 0;
+  uint32_t numGaps = 0;
+  for (const auto &message : messages) {
+    EXPECT_TRUE(rtps::test::isAligned(message));
+    numData += rtps::test::countSubmessages(message, SubmessageKind::DATA);
+    numGaps += rtps::test::countSubmessages(message, SubmessageKind::GAP);
+  }
+  EXPECT_EQ(numData, rtps::Config::HISTORY_SIZE);
+  EXPECT_EQ(numGaps, 1u);
+}
+
+TEST_F(StatefulWriterTest, PushesRunAligned) {
+  const uint32_t numChanges = 6;
+  addChanges(numChanges);
+  writer.progress();
+
+  const auto messages = getDataMessages();
+  ASSERT_FALSE(messages.empty());
+  uint32_t numData = 0;
+  uint32_t numHeartbeats = 0;
+  for (const auto &message : messages) {
+    EXPECT_TRUE(rtps::test::isAligned(message));
+    numData += rtps::test::countSubmessages(message, SubmessageKind::DATA);
+    numHeartbeats +=
+        rtps::test::countSubmessages(message, SubmessageKind::HEARTBEAT);
+  }
+  EXPECT_EQ(numData, numChanges);
+  EXPECT_EQ(numHeartbeats, 1u);
+}
+
+TEST_F(StatefulWriterTest, PushesSingleChangeWithHeartbeatAligned) {
+  addChanges(1);
+  writer.progress();
+
+  const auto messages = getDataMessages();
+  ASSERT_EQ(messages.size(), 1u);
+  EXPECT_TRUE(rtps::test::isAligned(messages[0]));
+  EXPECT_EQ(
+      rtps::test::countSubmessages(messages[0], SubmessageKind::HEARTBEAT),
+      1u);
+}
+
+TEST_F(StatefulWriterTest, KeepsPaddedRunWithinMessageSize) {
+  // Four of these fit a message unpadded, but not with padding and HEARTBEAT
+  constexpr uint32_t headersSize = rtps::Header::getRawSize() +
+                                   rtps::SubmessageInfoDst::getRawSize() +
+                                   rtps::SubmessageInfoTs::getRawSize();
+  const auto size = static_cast<rtps::DataSize_t>(
+      (rtps::Config::SF_WRITER_MAX_MESSAGE_SIZE - headersSize) / 4 -
+      rtps::SubmessageData::getRawSize());
+  const uint32_t numChanges = 4;
+  for (uint32_t i = 0; i < numChanges; ++i) {
+    addChange(size - 3);
+  }
+  writer.progress();
+
+  const auto messages = getDataMessages();
+  uint32_t numData = 0;
+  for (const auto &message : messages) {
+    EXPECT_LE(message.size(), rtps::Config::SF_WRITER_MAX_MESSAGE_SIZE);
+    EXPECT_TRUE(rtps::test::isAligned(message));
+    numData += rtps::test::countSubmessages(message, SubmessageKind::DATA);
+  }
+  EXPECT_EQ(numData, numChanges);
+}
+
+TEST_F(StatefulWriterTest, ResendsRequestHeldBackByFlowControl) {
+  const uint32_t numChanges = 6;
+  addChanges(numChanges);
+  // The first request drains the bucket, the second one has to wait
+  writer.setFlowControl(1000, 100, 150);
+  requestAll(numChanges);
+  ASSERT_FALSE(getDataMessages().empty());
+  driver.clear();
+
+  requestAll(numChanges);
+  EXPECT_TRUE(getDataMessages().empty());
+
+  uint32_t numData = 0;
+  for (uint32_t waitedMs = 0; numData < numChanges && waitedMs < 1000;
+       waitedMs += 10) {
+    sys_msleep(10);
+    numData = 0;
+    for (const auto &message : getDataMessages()) {
+      numData += rtps::test::countSubmessages(message, SubmessageKind::DATA);
+    }
+  }
+  EXPECT_EQ(numData, numChanges);
+}
+
+TEST_F(StatefulWriterTest, PacksMulticastRunWithHeartbeatsAligned) {
+  const rtps::Locator group = rtps::getUserMulticastLocator();
+  static_assert(rtps::Config::MULTICAST_MIN_READERS <= 2 &&
+                    rtps::Config::NUM_READER_PROXIES_PER_WRITER >= 3,
+                "Test adds two readers sharing the group");
+  for (uint8_t i = 0; i < 2; ++i) {
+    rtps::GuidPrefix_t prefix = readerPrefix;
+    prefix.id[0] = static_cast<uint8_t>(0x10 + i);
+    ASSERT_TRUE(writer.addNewMatchedReader(rtps::ReaderProxy{
+        {prefix, readerGuid.entityId}, rtps::getUserUnicastLocator(2), group}));
+  }
+  // Sizes that leave no room for the HEARTBEATs if they are not accounted for
+  constexpr uint32_t headersSize = rtps::Header::getRawSize() +
+                                   rtps::SubmessageInfoDst::getRawSize() +
+                                   rtps::SubmessageInfoTs::getRawSize();
+  const auto size = static_cast<rtps::DataSize_t>(
+      (rtps::Config::SF_WRITER_MAX_MESSAGE_SIZE - headersSize) / 4 -
+      rtps::SubmessageData::getRawSize());
+  const uint32_t numChanges = 4;
+  for (uint32_t i = 0; i < numChanges; ++i) {
+    addChange(size - 3);
+  }
+  writer.progress();
+
+  const ip4_addr_t groupAddress = group.getIp4Address();
+  uint32_t numData = 0;
+  uint32_t numHeartbeats = 0;
+  for (const auto &sent : driver.getSent()) {
+    if (!ip4_addr_cmp(&sent.destAddr, &groupAddress)) {
+      continue;
+    }
+    EXPECT_LE(sent.data.size(), rtps::Config::SF_WRITER_MAX_MESSAGE_SIZE);
+    EXPECT_TRUE(rtps::test::isAligned(sent.data));
+    numData += rtps::test::countSubmessages(sent.data, SubmessageKind::DATA);
+    numHeartbeats +=
+        rtps::test::countSubmessages(sent.data, SubmessageKind::HEARTBEAT);
+  }
+  EXPECT_EQ(numData, numChanges);
+  EXPECT_EQ(numHeartbeats, 2u);
+}
+
+TEST_F(StatefulWriterTest, ReplaysHistoryToTransientLocalReadersOnly) {
+  writer.m_attributes.durabilityKind = rtps::DurabilityKind_t::TRANSIENT_LOCAL;
+  const uint32_t numChanges = 3;
+  addChanges(numChanges);
+
+  const rtps::Locator volatileLocator = rtps::getUserUnicastLocator(2);
+  const rtps::Locator transientLocator = rtps::getUserUnicastLocator(3);
+  rtps::GuidPrefix_t prefix = readerPrefix;
+  prefix.id[0] = 0x20;
+  ASSERT_TRUE(writer.addNewMatchedReader(
+      rtps::ReaderProxy{{prefix, readerGuid.entityId}, volatileLocator}));
+  prefix.id[0] = 0x21;
+  ASSERT_TRUE(writer.addNewMatchedReader(rtps::ReaderProxy{
+      {prefix, readerGuid.entityId}, transientLocator, rtps::Locator(),
+      rtps::DurabilityKind_t::TRANSIENT_LOCAL}));
+
+  // The heartbeat thread paces the replay out
+  uint32_t numReplayed = 0;
+  uint32_t numToVolatile = 0;
+  for (uint32_t waitedMs = 0; waitedMs < 2000 && numReplayed < numChanges;
+       waitedMs += 10) {
+    sys_msleep(10);
+    numReplayed = 0;
+    numToVolatile = 0;
+    for (const auto &sent : driver.getSent()) {
+      const uint32_t numData =
+          rtps::test::countSubmessages(sent.data, SubmessageKind::DATA);
+      if (sent.destPort == transientLocator.port) {
+        numReplayed += numData;
+      } else if (sent.destPort == volatileLocator.port) {
+        numToVolatile += numData;
+      }
+    }
+  }
+  EXPECT_EQ(numReplayed, numChanges);
+  EXPECT_EQ(numToVolatile, 0u);
+}
+
+TEST_F(StatefulWriterTest, ChargesFlowControlOncePerDatagram) {
+  const rtps::Locator group = rtps::getUserMulticastLocator();
+  static_assert(rtps::Config::MULTICAST_MIN_READERS <= 2 &&
+                    rtps::Config::NUM_READER_PROXIES_PER_WRITER >= 3,
+                "Test adds two readers sharing the group");
+  for (uint8_t i = 0; i < 2; ++i) {
+    rtps::GuidPrefix_t prefix = readerPrefix;
+    prefix.id[0] = static_cast<uint8_t>(0x10 + i);
+    ASSERT_TRUE(writer.addNewMatchedReader(rtps::ReaderProxy{
+        {prefix, readerGuid.entityId}, rtps::getUserUnicastLocator(2), group}));
+  }
+  // Room for both samples to the group and the unicast reader, but not for
+  // one DATA per reader. The bucket does not refill during the test.
+  const rtps::DataSize_t size = 100;
+  const uint32_t perDatagram = rtps::SubmessageData::getRawSize() + size;
+  writer.setFlowControl(1, 1000000, 4 * perDatagram);
+  const uint32_t numChanges = 2;
+  for (uint32_t i = 0; i < numChanges; ++i) {
+    addChange(size);
+  }
+  writer.progress();
+
+  uint32_t numData = 0;
+  for (const auto &message : getDataMessages()) {
+    numData += rtps::test::countSubmessages(message, SubmessageKind::DATA);
+  }
+  EXPECT_EQ(numData, 2 * numChanges);
+}
+
+TEST_F(StatefulWriterTest, RemovesAllReadersOfParticipant) {
+  const Guid secondReader{
+      readerPrefix,
+      {{4, 5, 7}, rtps::EntityKind_t::USER_DEFINED_READER_WITHOUT_KEY}};
+  ASSERT_TRUE(writer.addNewMatchedReader(
+      rtps::ReaderProxy{secondReader, rtps::getUserUnicastLocator(1)}));
+  rtps::GuidPrefix_t otherPrefix = readerPrefix;
+  otherPrefix.id[0] = 0x30;
+  const rtps::Locator otherLocator = rtps::getUserUnicastLocator(2);
+  ASSERT_TRUE(writer.addNewMatchedReader(
+      rtps::ReaderProxy{{otherPrefix, readerGuid.entityId}, otherLocator}));
+  const uint32_t numChanges = 2;
+  addChanges(numChanges);
+
+  writer.removeReaderOfParticipant(readerPrefix);
+  requestAll(numChanges);
+  EXPECT_TRUE(getDataMessages().empty());
+
+  rtps::SubmessageAckNack msg;
+  msg.readerId = readerGuid.entityId;
+  msg.writerId = writer.m_attributes.endpointGuid.entityId;
+  msg.readerSNState = SequenceNumberSet({0, 1});
+  msg.readerSNState.numBits = numChanges;
+  for (uint32_t bit = 0; bit < numChanges; ++bit) {
+    msg.readerSNState.set(bit);
+  }
+  msg.count = {1};
+  writer.onNewAckNack(msg, otherPrefix);
+  const auto messages = getDataMessages();
+  ASSERT_FALSE(messages.empty());
+  for (const auto &sent : driver.getSent()) {
+    if (rtps::test::countSubmessages(sent.data, SubmessageKind::DATA) != 0) {
+      EXPECT_EQ(sent.destPort, otherLocator.port);
+    }
+  }
+}
@@ -0,0 +1,137 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/entities/WriterProxy.h"
+
+using rtps::ChangeKind_t;
+using rtps::SequenceNumber_t;
+using rtps::WriterProxy;
+
+namespace {
+constexpr uint8_t WINDOW = rtps::Config::SF_READER_REORDER_WINDOW_SIZE;
+
+class WriterProxyTest : public ::testing::Test {
+protected:
+  WriterProxy proxy{{rtps::GUIDPREFIX_UNKNOWN, rtps::ENTITYID_UNKNOWN},
+                    rtps::Locator()};
+  pbuf *packet = nullptr;
+  uint8_t payload[4] = {0, 1, 0, 0};
+
+  void SetUp() override {
+    packet = pbuf_alloc(PBUF_RAW, sizeof(payload), PBUF_POOL);
+    ASSERT_NE(packet, nullptr);
+  }
+
+  void TearDown() override {
+    for (uint8_t slot = 0; slot < WINDOW; ++slot) {
+      proxy.reorderSlots[slot] = rtps::BufferedChange{};
+    }
+    pbuf_free(packet);
+  }
+
+  bool buffer(uint32_t sn) {
+    return proxy.bufferChange({0, sn}, ChangeKind_t::ALIVE, packet, payload,
+                              sizeof(payload));
+  }
+};
+} // namespace
+
+TEST_F(WriterProxyTest, BuffersOnlyChangesAheadOfExpectedInsideWindow) {
+  proxy.expectedSN = {0, 5};
+
+  EXPECT_FALSE(buffer(4));
+  EXPECT_FALSE(buffer(5));
+  EXPECT_TRUE(buffer(6));
+  EXPECT_TRUE(buffer(5 + WINDOW));
+  EXPECT_FALSE(buffer(6 + WINDOW));
+}
+
+TEST_F(WriterProxyTest, RejectsDuplicates) {
+  EXPECT_TRUE(buffer(3));
+  EXPECT_FALSE(buffer(3));
+  EXPECT_TRUE(proxy.isBuffered({0, 3}));
+}
+
+TEST_F(WriterProxyTest, KeepsPacketReferencedWhileBuffered) {
+  const auto refs = packet->ref;
+  ASSERT_TRUE(buffer(2));
+  EXPECT_EQ(packet->ref, refs + 1);
+
+  proxy.expectedSN = {0, 2};
+  proxy.releaseExpected();
+  EXPECT_EQ(packet->ref, refs);
+}
+
+TEST_F(WriterProxyTest, ReleasesBufferedChangesInOrder) {
+  ASSERT_TRUE(buffer(3));
+  ASSERT_TRUE(buffer(2));
+  EXPECT_EQ(proxy.getBufferedExpected(), nullptr);
+
+  ++proxy.expectedSN;
+  for (uint32_t sn = 2; sn <= 3; ++sn) {
+    const rtps::BufferedChange *change = proxy.getBufferedExpected();
+    ASSERT_NE(change, nullptr);
+    EXPECT_EQ(change->sn, (SequenceNumber_t{0, sn}));
+    EXPECT_EQ(change->data, payload);
+    EXPECT_EQ(change->size, sizeof(payload));
+    proxy.releaseExpected();
+    ++proxy.expectedSN;
+  }
+  EXPECT_EQ(proxy.getBufferedExpected(), nullptr);
+  EXPECT_EQ(proxy.reorderBitMap, 0u);
+}
+
+TEST_F(WriterProxyTest, ReusesSlotOnceWindowMoved) {
+  ASSERT_TRUE(buffer(2));
+  proxy.expectedSN = {0, 2};
+  proxy.releaseExpected();
+  ++proxy.expectedSN;
+
+  // Same slot as SN 2
+  EXPECT_TRUE(buffer(2 + WINDOW));
+  EXPECT_TRUE(proxy.isBuffered({0, 2u + WINDOW}));
+  EXPECT_FALSE(proxy.isBuffered({0, 2}));
+}
+
+TEST_F(WriterProxyTest, SkipToDropsEverythingBefore) {
+  ASSERT_TRUE(buffer(2));
+  ASSERT_TRUE(buffer(4));
+  ASSERT_TRUE(buffer(6));
+
+  proxy.skipTo({0, 4});
+
+  EXPECT_EQ(proxy.expectedSN, (SequenceNumber_t{0, 4}));
+  EXPECT_FALSE(proxy.isBuffered({0, 2}));
+  EXPECT_TRUE(proxy.isBuffered({0, 4}));
+  EXPECT_TRUE(proxy.isBuffered({0, 6}));
+  EXPECT_NE(proxy.getBufferedExpected(), nullptr);
+}
+
+TEST_F(WriterProxyTest, SkipToNeverMovesBackwards) {
+  proxy.expectedSN = {0, 10};
+  proxy.skipTo({0, 4});
+  EXPECT_EQ(proxy.expectedSN, (SequenceNumber_t{0, 10}));
+}
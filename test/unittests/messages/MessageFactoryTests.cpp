@@ -0,0 +1,191 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/messages/MessageFactory.h"
+#include "rtps/storages/PBufWrapper.h"
+#include "unittests/utils/MessageUtils.h"
+
+#include <vector>
+
+using rtps::PBufWrapper;
+using rtps::SubmessageKind;
+using rtps::test::SubmessageView;
+
+namespace {
+std::vector<uint8_t> toVector(const PBufWrapper &buffer) {
+  std::vector<uint8_t> result(buffer.spaceUsed());
+  pbuf_copy_partial(buffer.firstElement, result.data(), result.size(), 0);
+  return result;
+}
+
+PBufWrapper makePayload(const std::vector<uint8_t> &bytes) {
+  PBufWrapper payload(static_cast<rtps::DataSize_t>(bytes.size()));
+  payload.append(bytes.data(), static_cast<rtps::DataSize_t>(bytes.size()));
+  return payload;
+}
+
+class MessageFactoryTest : public ::testing::Test {
+protected:
+  PBufWrapper buffer;
+  const rtps::EntityId_t writerId{
+      {1, 2, 3}, rtps::EntityKind_t::USER_DEFINED_WRITER_WITHOUT_KEY};
+
+  void SetUp() override {
+    rtps::MessageFactory::addHeader(buffer, rtps::GUIDPREFIX_UNKNOWN);
+  }
+
+  void addData(const PBufWrapper &payload, uint32_t sn, bool copyPayload) {
+    rtps::MessageFactory::addSubMessageData(buffer, payload, false, {0, sn},
+                                            writerId, rtps::ENTITYID_UNKNOWN,
+                                            copyPayload);
+  }
+
+  void addHeartbeat() {
+    rtps::MessageFactory::addHeartbeat(buffer, writerId,
+                                       rtps::ENTITYID_UNKNOWN, {0, 1}, {0, 3},
+                                       rtps::Count_t{1}, true);
+  }
+};
+} // namespace
+
+TEST_F(MessageFactoryTest, PadsCopiedPayloadAndRecordsPadding) {
+  const std::vector<uint8_t> sample{0x00, 0x01, 0x00, 0x00, 'a', 'b', 'c'};
+  addData(makePayload(sample), 1, true);
+  addHeartbeat();
+
+  const std::vector<uint8_t> message = toVector(buffer);
+  std::vector<SubmessageView> submessages;
+  ASSERT_TRUE(rtps::test::splitMessage(message, submessages));
+  ASSERT_EQ(submessages.size(), 2u);
+  EXPECT_EQ(submessages[0].kind, SubmessageKind::DATA);
+  EXPECT_EQ(submessages[1].kind, SubmessageKind::HEARTBEAT);
+
+  const uint32_t payloadOffset =
+      submessages[0].offset + rtps::SubmessageData::getRawSize();
+  const uint8_t padding = 1;
+  EXPECT_EQ(submessages[0].length, rtps::SubmessageData::getRawSize() -
+                                       rtps::SubmessageHeader::getRawSize() +
+                                       sample.size() + padding);
+  // Options carry the padding, everything else is left as is
+  EXPECT_EQ(message[payloadOffset + 3], padding);
+  for (uint32_t i = 0; i < sample.size(); ++i) {
+    if (i != 3) {
+      EXPECT_EQ(message[payloadOffset + i], sample[i]);
+    }
+  }
+  EXPECT_EQ(message[payloadOffset + sample.size()], 0);
+}
+
+TEST_F(MessageFactoryTest, PadsPayloadWithoutEncapsulationUnchanged) {
+  const std::vector<uint8_t> sample{0xff, 0xfe, 0xfd, 0xfc, 0xfb};
+  addData(makePayload(sample), 1, true);
+  addHeartbeat();
+
+  const std::vector<uint8_t> message = toVector(buffer);
+  std::vector<SubmessageView> submessages;
+  ASSERT_TRUE(rtps::test::splitMessage(message, submessages));
+  const uint32_t payloadOffset =
+      submessages[0].offset + rtps::SubmessageData::getRawSize();
+  for (uint32_t i = 0; i < sample.size(); ++i) {
+    EXPECT_EQ(message[payloadOffset + i], sample[i]);
+  }
+}
+
+TEST_F(MessageFactoryTest, LeavesChainedPayloadUnpadded) {
+  const std::vector<uint8_t> sample{0x00, 0x01, 0x00, 0x00, 'a'};
+  const PBufWrapper payload = makePayload(sample);
+  addData(payload, 1, false);
+
+  const std::vector<uint8_t> message = toVector(buffer);
+  std::vector<SubmessageView> submessages;
+  ASSERT_TRUE(rtps::test::splitMessage(message, submessages));
+  ASSERT_EQ(submessages.size(), 1u);
+  EXPECT_EQ(message.size(), submessages[0].offset +
+                                rtps::SubmessageData::getRawSize() +
+                                sample.size());
+  EXPECT_EQ(message.back(), 'a');
+}
+
+TEST_F(MessageFactoryTest, PackedDataStaysAligned) {
+  // Every remainder modulo 4, with and without encapsulation header
+  std::vector<PBufWrapper> payloads;
+  for (uint8_t size = 4; size < 12; ++size) {
+    std::vector<uint8_t> sample(size, size);
+    if (size % 2 == 0) {
+      sample[0] = 0x00;
+      sample[1] = 0x01;
+      sample[2] = 0x00;
+      sample[3] = 0x00;
+    }
+    payloads.push_back(makePayload(sample));
+  }
+  uint32_t sn = 1;
+  for (const auto &payload : payloads) {
+    addData(payload, sn++, true);
+  }
+  rtps::SequenceNumberSet gapList({0, 20});
+  gapList.numBits = 0;
+  rtps::MessageFactory::addGap(buffer, writerId, rtps::ENTITYID_UNKNOWN,
+                               {0, 12}, gapList);
+  addHeartbeat();
+
+  const std::vector<uint8_t> message = toVector(buffer);
+  EXPECT_TRUE(rtps::test::isAligned(message));
+  EXPECT_EQ(rtps::test::countSubmessages(message, SubmessageKind::DATA),
+            payloads.size());
+  EXPECT_EQ(rtps::test::countSubmessages(message, SubmessageKind::GAP), 1u);
+  EXPECT_EQ(rtps::test::countSubmessages(message, SubmessageKind::HEARTBEAT),
+            1u);
+}
+
+TEST_F(MessageFactoryTest, PadsDataFragButKeepsFragmentSize) {
+  std::vector<uint8_t> sample(10);
+  for (uint8_t i = 0; i < sample.size(); ++i) {
+    sample[i] = i;
+  }
+  const PBufWrapper payload = makePayload(sample);
+  const uint16_t fragmentSize = 4;
+  for (uint32_t fragment = 1; fragment <= 3; ++fragment) {
+    rtps::MessageFactory::addSubMessageDataFrag(buffer, payload, fragment,
+                                                fragmentSize, {0, 1}, writerId,
+                                                rtps::ENTITYID_UNKNOWN);
+  }
+  addHeartbeat();
+
+  const std::vector<uint8_t> message = toVector(buffer);
+  std::vector<SubmessageView> submessages;
+  ASSERT_TRUE(rtps::test::splitMessage(message, submessages));
+  ASSERT_EQ(submessages.size(), 4u);
+  // The last fragment holds 2 bytes and 2 bytes of padding
+  const SubmessageView &last = submessages[2];
+  EXPECT_EQ(last.length % 4, 0u);
+  const uint32_t payloadOffset =
+      last.offset + rtps::SubmessageDataFrag::getRawSize();
+  EXPECT_EQ(message[payloadOffset], 8);
+  EXPECT_EQ(message[payloadOffset + 1], 9);
+  EXPECT_EQ(message[payloadOffset + 2], 0);
+  EXPECT_EQ(message[payloadOffset + 3], 0);
+}
@@ -0,0 +1,185 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/entities/Participant.h"
+#include "rtps/entities/Reader.h"
+#include "rtps/messages/MessageFactory.h"
+#include "rtps/messages/MessageReceiver.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using rtps::GuidPrefix_t;
+using rtps::SubmessageKind;
+
+namespace {
+//! Checks that each sample is attributed to the writer whose prefix byte it
+//! carries at the end of its payload
+class PrefixCheckingReader final : public rtps::Reader {
+public:
+  std::atomic<uint32_t> numReceived{0};
+  std::atomic<uint32_t> numWrongWriter{0};
+
+  void newChange(const rtps::ReaderCacheChange &change) override {
+    ++numReceived;
+    if (change.size != samplePayloadSize ||
+        change.writerGuid.prefix.id[0] != change.data[4]) {
+      ++numWrongWriter;
+    }
+  }
+  bool onNewHeartbeat(const rtps::SubmessageHeartbeat &,
+                      const GuidPrefix_t &) override {
+    return true;
+  }
+  bool onNewGap(const rtps::SubmessageGap &, const GuidPrefix_t &) override {
+    return true;
+  }
+  void onNewDataFrag(const rtps::SubmessageDataFrag &, const GuidPrefix_t &,
+                     const uint8_t *, rtps::DataSize_t) override {}
+  bool addNewMatchedWriter(const rtps::WriterProxy &) override {
+    return true;
+  }
+  void removeWriter(const rtps::Guid &) override {}
+  void removeWriterOfParticipant(const rtps::GuidPrefix_t &) override {}
+
+  static constexpr rtps::DataSize_t samplePayloadSize = 8;
+};
+
+constexpr rtps::DataSize_t PrefixCheckingReader::samplePayloadSize;
+
+class MessageReceiverTest : public ::testing::Test {
+protected:
+  const GuidPrefix_t ownPrefix{1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+  const GuidPrefix_t otherPrefix{2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2};
+  rtps::Participant participant{ownPrefix, 0};
+  PrefixCheckingReader reader;
+
+  void SetUp() override {
+    reader.m_attributes.endpointGuid = {
+        ownPrefix,
+        {{0, 0, 1}, rtps::EntityKind_t::USER_DEFINED_READER_WITHOUT_KEY}};
+    ASSERT_NE(participant.addReader(&reader), nullptr);
+  }
+
+  static GuidPrefix_t makePrefix(uint8_t id) {
+    GuidPrefix_t prefix;
+    prefix.id.fill(id);
+    return prefix;
+  }
+
+  static void addInfoSrc(rtps::PBufWrapper &buffer, const GuidPrefix_t &src) {
+    const uint8_t header[12] = {
+        static_cast<uint8_t>(SubmessageKind::INFO_SRC),
+        rtps::FLAG_LITTLE_ENDIAN,
+        20,
+        0,
+        0,
+        0,
+        0,
+        0,
+        rtps::PROTOCOLVERSION.major,
+        rtps::PROTOCOLVERSION.minor,
+        0,
+        0};
+    buffer.reserve(sizeof(header) + src.id.size());
+    buffer.append(header, sizeof(header));
+    buffer.append(src.id.data(), static_cast<rtps::DataSize_t>(src.id.size()));
+  }
+
+  //! DATA from the writer with prefix src, the payload carries src's first
+  //! byte so that the reader can check the attribution
+  void addData(rtps::PBufWrapper &buffer, uint8_t src, uint32_t sn) {
+    const uint8_t sample[PrefixCheckingReader::samplePayloadSize] = {
+        0x00, 0x01, 0x00, 0x00, src, 0, 0, 0};
+    rtps::PBufWrapper payload(sizeof(sample));
+    payload.append(sample, sizeof(sample));
+    rtps::MessageFactory::addSubMessageData(
+        buffer, payload, false, {0, sn},
+        {{0, 0, 2}, rtps::EntityKind_t::USER_DEFINED_WRITER_WITHOUT_KEY},
+        reader.m_attributes.endpointGuid.entityId, true);
+  }
+
+  //! Two writers in one message, told apart only by INFO_SRC
+  std::vector<uint8_t> makeMessage(uint8_t firstSrc, uint8_t secondSrc,
+                                   GuidPrefix_t dest) {
+    rtps::PBufWrapper buffer;
+    rtps::MessageFactory::addHeader(buffer, makePrefix(0x33));
+    rtps::MessageFactory::addSubMessageDestination(buffer, dest.id.data());
+    addInfoSrc(buffer, makePrefix(firstSrc));
+    rtps::MessageFactory::addSubMessageTimeStamp(buffer);
+    addData(buffer, firstSrc, 1);
+    addInfoSrc(buffer, makePrefix(secondSrc));
+    addData(buffer, secondSrc, 2);
+
+    std::vector<uint8_t> message(buffer.spaceUsed());
+    pbuf_copy_partial(buffer.firstElement, message.data(),
+                      static_cast<uint16_t>(message.size()), 0);
+    return message;
+  }
+
+  bool process(const std::vector<uint8_t> &message) {
+    return participant.getMessageReceiver()->processMessage(
+        message.data(), static_cast<rtps::DataSize_t>(message.size()));
+  }
+};
+} // namespace
+
+TEST_F(MessageReceiverTest, AttributesDataToInfoSrc) {
+  EXPECT_TRUE(process(makeMessage(0x40, 0x41, ownPrefix)));
+  EXPECT_EQ(reader.numReceived, 2u);
+  EXPECT_EQ(reader.numWrongWriter, 0u);
+}
+
+TEST_F(MessageReceiverTest, SkipsDataForOtherParticipant) {
+  process(makeMessage(0x40, 0x41, otherPrefix));
+  EXPECT_EQ(reader.numReceived, 0u);
+}
+
+TEST_F(MessageReceiverTest, KeepsStatePerMessageAcrossThreads) {
+  constexpr uint32_t numThreads = 4;
+  constexpr uint32_t numMessages = 5000;
+  std::vector<std::thread> threads;
+  for (uint8_t t = 0; t < numThreads; ++t) {
+    // The last thread addresses another participant, its INFO_DST must not
+    // leak into the messages of the others
+    const GuidPrefix_t &dest = t + 1 == numThreads ? otherPrefix : ownPrefix;
+    const std::vector<uint8_t> message =
+        makeMessage(static_cast<uint8_t>(0x40 + 2 * t),
+                    static_cast<uint8_t>(0x41 + 2 * t), dest);
+    threads.emplace_back([this, message] {
+      for (uint32_t i = 0; i < numMessages; ++i) {
+        process(message);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(reader.numReceived, 2 * (numThreads - 1) * numMessages);
+  EXPECT_EQ(reader.numWrongWriter, 0u);
+}
@@ -0,0 +1,247 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/messages/MessageTypes.h"
+
+#include <vector>
+
+using rtps::MessageProcessingInfo;
+using rtps::SubmessageKind;
+
+namespace {
+//! Serializes submessages in either byte order like a remote peer would
+class WireWriter {
+public:
+  explicit WireWriter(bool isLittleEndian) : m_isLittleEndian(isLittleEndian) {}
+
+  void header(SubmessageKind kind, uint8_t flags, uint16_t length) {
+    put8(static_cast<uint8_t>(kind));
+    put8(static_cast<uint8_t>(
+        flags | (m_isLittleEndian ? rtps::FLAG_LITTLE_ENDIAN : 0)));
+    put16(length);
+  }
+
+  void put8(uint8_t value) { bytes.push_back(value); }
+
+  void put16(uint16_t value) { putBytes(value, sizeof(value)); }
+
+  void put32(uint32_t value) { putBytes(value, sizeof(value)); }
+
+  void putEntityId(const rtps::EntityId_t &id) {
+    bytes.insert(bytes.end(), id.entityKey.begin(), id.entityKey.end());
+    put8(static_cast<uint8_t>(id.entityKind));
+  }
+
+  void putSN(const rtps::SequenceNumber_t &sn) {
+    put32(static_cast<uint32_t>(sn.high));
+    put32(sn.low);
+  }
+
+  MessageProcessingInfo getInfo() const {
+    return MessageProcessingInfo(bytes.data(),
+                                 static_cast<rtps::DataSize_t>(bytes.size()));
+  }
+
+  std::vector<uint8_t> bytes;
+
+private:
+  bool m_isLittleEndian;
+
+  void putBytes(uint32_t value, uint8_t size) {
+    for (uint8_t i = 0; i < size; ++i) {
+      const uint8_t shift = m_isLittleEndian ? 8 * i : 8 * (size - 1 - i);
+      put8(static_cast<uint8_t>(value >> shift));
+    }
+  }
+};
+
+const rtps::EntityId_t readerId{
+    {1, 2, 3}, rtps::EntityKind_t::USER_DEFINED_READER_WITH_KEY};
+const rtps::EntityId_t writerId{
+    {4, 5, 6}, rtps::EntityKind_t::USER_DEFINED_WRITER_WITH_KEY};
+
+// The parameter is the byte order of the sender, one of both differs from ours
+class MessageTypesTest : public ::testing::TestWithParam<bool> {
+protected:
+  WireWriter writer{GetParam()};
+};
+} // namespace
+
+TEST_P(MessageTypesTest, ReadsHeartbeat) {
+  writer.header(SubmessageKind::HEARTBEAT, rtps::FLAG_FINAL, 28);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 5});
+  writer.putSN({1, 0x01020304});
+  writer.put32(7);
+
+  rtps::SubmessageHeartbeat msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.header.submessageId, SubmessageKind::HEARTBEAT);
+  EXPECT_EQ(msg.header.submessageLength, 28);
+  EXPECT_EQ(msg.readerId, readerId);
+  EXPECT_EQ(msg.writerId, writerId);
+  EXPECT_EQ(msg.firstSN, (rtps::SequenceNumber_t{0, 5}));
+  EXPECT_EQ(msg.lastSN, (rtps::SequenceNumber_t{1, 0x01020304}));
+  EXPECT_EQ(msg.count.value, 7);
+}
+
+TEST_P(MessageTypesTest, ReadsAckNackBitmap) {
+  writer.header(SubmessageKind::ACKNACK, 0, 36);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 3});
+  writer.put32(40);
+  writer.put32(0x80000001);
+  writer.put32(0x40000000);
+  writer.put32(9);
+
+  rtps::SubmessageAckNack msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.readerSNState.base, (rtps::SequenceNumber_t{0, 3}));
+  EXPECT_EQ(msg.readerSNState.numBits, 40u);
+  EXPECT_TRUE(msg.readerSNState.isSet(0));
+  EXPECT_FALSE(msg.readerSNState.isSet(1));
+  EXPECT_TRUE(msg.readerSNState.isSet(31));
+  EXPECT_TRUE(msg.readerSNState.isSet(33));
+  EXPECT_EQ(msg.count.value, 9);
+}
+
+TEST_P(MessageTypesTest, RejectsAckNackWithTooManyBits) {
+  writer.header(SubmessageKind::ACKNACK, 0, 24);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 3});
+  writer.put32(rtps::SNS_NUM_BITS + 1);
+  writer.put32(1);
+
+  rtps::SubmessageAckNack msg;
+  EXPECT_FALSE(rtps::deserializeMessage(writer.getInfo(), msg));
+}
+
+TEST_P(MessageTypesTest, ReadsGap) {
+  writer.header(SubmessageKind::GAP, 0, 32);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 2});
+  writer.putSN({0, 6});
+  writer.put32(3);
+  writer.put32(0xa0000000);
+
+  rtps::SubmessageGap msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.gapStart, (rtps::SequenceNumber_t{0, 2}));
+  EXPECT_EQ(msg.gapList.base, (rtps::SequenceNumber_t{0, 6}));
+  EXPECT_EQ(msg.gapList.numBits, 3u);
+  EXPECT_TRUE(msg.gapList.isSet(0));
+  EXPECT_FALSE(msg.gapList.isSet(1));
+  EXPECT_TRUE(msg.gapList.isSet(2));
+}
+
+TEST_P(MessageTypesTest, ReadsDataHeader) {
+  writer.header(SubmessageKind::DATA, rtps::FLAG_DATA_PAYLOAD, 24);
+  writer.put16(0);
+  writer.put16(16);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 0x00010203});
+  writer.put32(0x00010000); // Payload is opaque
+
+  rtps::SubmessageData msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.header.submessageLength, 24);
+  EXPECT_EQ(msg.octetsToInlineQos, 16);
+  EXPECT_EQ(msg.writerId, writerId);
+  EXPECT_EQ(msg.writerSN, (rtps::SequenceNumber_t{0, 0x00010203}));
+}
+
+TEST_P(MessageTypesTest, RejectsDataLongerThanMessage) {
+  writer.header(SubmessageKind::DATA, rtps::FLAG_DATA_PAYLOAD, 0x0100);
+  writer.put16(0);
+  writer.put16(16);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 1});
+  writer.put32(0);
+
+  rtps::SubmessageData msg;
+  EXPECT_FALSE(rtps::deserializeMessage(writer.getInfo(), msg));
+}
+
+TEST_P(MessageTypesTest, ReadsDataFrag) {
+  writer.header(SubmessageKind::DATA_FRAG, 0, 36);
+  writer.put16(0);
+  writer.put16(28);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 4});
+  writer.put32(3);
+  writer.put16(2);
+  writer.put16(1024);
+  writer.put32(5000);
+  writer.put32(0); // Fragment data is opaque
+
+  rtps::SubmessageDataFrag msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.writerSN, (rtps::SequenceNumber_t{0, 4}));
+  EXPECT_EQ(msg.fragmentStartingNum.value, 3u);
+  EXPECT_EQ(msg.fragmentsInSubmessage, 2);
+  EXPECT_EQ(msg.fragmentSize, 1024);
+  EXPECT_EQ(msg.sampleSize, 5000u);
+}
+
+TEST_P(MessageTypesTest, ReadsNackFragBitmap) {
+  writer.header(SubmessageKind::NACK_FRAG, 0, 32);
+  writer.putEntityId(readerId);
+  writer.putEntityId(writerId);
+  writer.putSN({0, 4});
+  writer.put32(2);
+  writer.put32(5);
+  writer.put32(0x48000000);
+  writer.put32(11);
+
+  rtps::SubmessageNackFrag msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.fragmentNumberState.base.value, 2u);
+  EXPECT_EQ(msg.fragmentNumberState.numBits, 5u);
+  EXPECT_TRUE(msg.fragmentNumberState.isSet(1));
+  EXPECT_TRUE(msg.fragmentNumberState.isSet(4));
+  EXPECT_FALSE(msg.fragmentNumberState.isSet(0));
+  EXPECT_EQ(msg.count.value, 11);
+}
+
+TEST_P(MessageTypesTest, ReadsTimestamp) {
+  writer.header(SubmessageKind::INFO_TS, 0, 8);
+  writer.put32(0x00010002);
+  writer.put32(0x80000000);
+
+  rtps::SubmessageInfoTs msg;
+  ASSERT_TRUE(rtps::deserializeMessage(writer.getInfo(), msg));
+  EXPECT_EQ(msg.timestamp.seconds, 0x00010002);
+  EXPECT_EQ(msg.timestamp.fraction, 0x80000000u);
+}
+
+INSTANTIATE_TEST_CASE_P(ByteOrders, MessageTypesTest, ::testing::Bool());
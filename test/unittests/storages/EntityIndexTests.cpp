@@ -0,0 +1,131 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/storages/EntityIndex.h"
+
+#include <atomic>
+#include <thread>
+
+using rtps::EntityId_t;
+using rtps::EntityIndex;
+using rtps::EntityKind_t;
+
+namespace {
+EntityId_t
+makeId(uint32_t key,
+       EntityKind_t kind = EntityKind_t::USER_DEFINED_READER_WITH_KEY) {
+  return {{static_cast<uint8_t>(key >> 16), static_cast<uint8_t>(key >> 8),
+           static_cast<uint8_t>(key)},
+          kind};
+}
+} // namespace
+
+TEST(EntityIndexTest, FindsAddedEntries) {
+  EntityIndex<int, 4> index;
+  int values[4];
+  for (uint32_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(index.add(makeId(i + 1), &values[i]));
+  }
+  EXPECT_EQ(index.getNumEntries(), 4u);
+  for (uint32_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(index.find(makeId(i + 1)), &values[i]);
+  }
+  EXPECT_EQ(index.find(makeId(5)), nullptr);
+}
+
+TEST(EntityIndexTest, RejectsDuplicatesNullAndOverflow) {
+  EntityIndex<int, 2> index;
+  int values[3];
+  EXPECT_FALSE(index.add(makeId(1), nullptr));
+  EXPECT_TRUE(index.add(makeId(1), &values[0]));
+  EXPECT_FALSE(index.add(makeId(1), &values[1]));
+  EXPECT_TRUE(index.add(makeId(2), &values[1]));
+  EXPECT_FALSE(index.add(makeId(3), &values[2]));
+
+  EXPECT_EQ(index.getNumEntries(), 2u);
+  EXPECT_EQ(index.find(makeId(1)), &values[0]);
+  EXPECT_EQ(index.find(makeId(3)), nullptr);
+}
+
+TEST(EntityIndexTest, DistinguishesKindsOfSameKey) {
+  EntityIndex<int, 2> index;
+  int reader;
+  int writer;
+  index.add(makeId(7, EntityKind_t::USER_DEFINED_READER_WITH_KEY), &reader);
+  index.add(makeId(7, EntityKind_t::USER_DEFINED_WRITER_WITH_KEY), &writer);
+
+  EXPECT_EQ(index.find(makeId(7, EntityKind_t::USER_DEFINED_READER_WITH_KEY)),
+            &reader);
+  EXPECT_EQ(index.find(makeId(7, EntityKind_t::USER_DEFINED_WRITER_WITH_KEY)),
+            &writer);
+  EXPECT_EQ(
+      index.find(makeId(7, EntityKind_t::USER_DEFINED_READER_WITHOUT_KEY)),
+      nullptr);
+}
+
+TEST(EntityIndexTest, FindsEveryEntryOfFullIndex) {
+  // Enough entries for probing sequences to collide
+  constexpr uint32_t size = 64;
+  EntityIndex<uint32_t, size> index;
+  uint32_t values[size];
+  for (uint32_t i = 0; i < size; ++i) {
+    values[i] = i;
+    ASSERT_TRUE(index.add(makeId(i * 0x0101), &values[i]));
+  }
+  for (uint32_t i = 0; i < size; ++i) {
+    const uint32_t *found = index.find(makeId(i * 0x0101));
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, i);
+  }
+  for (uint32_t i = size; i < 4 * size; ++i) {
+    EXPECT_EQ(index.find(makeId(i * 0x0101)), nullptr);
+  }
+}
+
+TEST(EntityIndexTest, FindRunsConcurrentlyWithAdd) {
+  constexpr uint32_t size = 32;
+  EntityIndex<uint32_t, size> index;
+  uint32_t values[size];
+  std::atomic<bool> running{true};
+  std::atomic<uint32_t> numWrong{0};
+
+  std::thread finder([&] {
+    while (running) {
+      for (uint32_t i = 0; i < size; ++i) {
+        const uint32_t *found = index.find(makeId(i + 1));
+        numWrong += found != nullptr && found != &values[i] ? 1 : 0;
+      }
+    }
+  });
+  for (uint32_t i = 0; i < size; ++i) {
+    values[i] = i;
+    index.add(makeId(i + 1), &values[i]);
+    std::this_thread::yield();
+  }
+  running = false;
+  finder.join();
+  EXPECT_EQ(numWrong, 0u);
+}
@@ -0,0 +1,160 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/storages/FragmentBuffer.h"
+
+#include <vector>
+
+using rtps::FragmentBuffer;
+using rtps::Guid;
+
+namespace {
+class FragmentBufferTest : public ::testing::Test {
+protected:
+  static constexpr uint16_t FRAGMENT_SIZE = 4;
+  FragmentBuffer buffer;
+  const Guid writerGuid{rtps::GUIDPREFIX_UNKNOWN, rtps::ENTITYID_UNKNOWN};
+  std::vector<uint8_t> sample;
+
+  void startWithSampleSize(uint32_t size) {
+    sample.resize(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      sample[i] = static_cast<uint8_t>(i + 1);
+    }
+    ASSERT_TRUE(buffer.start(writerGuid, {0, 1}, size, FRAGMENT_SIZE));
+  }
+
+  //! Adds fragment fragmentNum as a sender does, padded to FRAGMENT_SIZE
+  bool addFragment(uint32_t fragmentNum, uint16_t numFragments = 1) {
+    std::vector<uint8_t> data(numFragments * FRAGMENT_SIZE, 0);
+    const uint32_t offset = (fragmentNum - 1) * FRAGMENT_SIZE;
+    for (uint32_t i = 0; i < data.size() && offset + i < sample.size(); ++i) {
+      data[i] = sample[offset + i];
+    }
+    return buffer.add(fragmentNum, numFragments, FRAGMENT_SIZE, data.data(),
+                      static_cast<rtps::DataSize_t>(data.size()));
+  }
+
+  void expectSample() {
+    ASSERT_TRUE(buffer.isComplete());
+    ASSERT_EQ(buffer.getSampleSize(), sample.size());
+    EXPECT_EQ(std::vector<uint8_t>(buffer.getData(),
+                                   buffer.getData() + sample.size()),
+              sample);
+  }
+};
+} // namespace
+
+TEST_F(FragmentBufferTest, ReassemblesFragmentsInAnyOrder) {
+  startWithSampleSize(10);
+
+  EXPECT_TRUE(addFragment(3));
+  EXPECT_TRUE(addFragment(1));
+  EXPECT_FALSE(buffer.isComplete());
+  EXPECT_TRUE(addFragment(2));
+
+  expectSample();
+}
+
+TEST_F(FragmentBufferTest, TakesSeveralFragmentsPerSubmessage) {
+  startWithSampleSize(16);
+
+  EXPECT_TRUE(addFragment(1, 2));
+  EXPECT_TRUE(addFragment(3, 2));
+
+  expectSample();
+}
+
+TEST_F(FragmentBufferTest, CountsDuplicatesOnce) {
+  startWithSampleSize(8);
+
+  EXPECT_TRUE(addFragment(1));
+  EXPECT_TRUE(addFragment(1));
+  EXPECT_FALSE(buffer.isComplete());
+  EXPECT_TRUE(addFragment(2));
+
+  expectSample();
+}
+
+TEST_F(FragmentBufferTest, IgnoresPaddingAfterLastFragment) {
+  startWithSampleSize(5);
+
+  // The last fragment holds a single byte followed by padding
+  EXPECT_TRUE(addFragment(2));
+  EXPECT_TRUE(addFragment(1));
+
+  expectSample();
+}
+
+TEST_F(FragmentBufferTest, RejectsTruncatedFragment) {
+  startWithSampleSize(8);
+  const uint8_t data[2] = {1, 2};
+
+  EXPECT_FALSE(buffer.add(1, 1, FRAGMENT_SIZE, data, sizeof(data)));
+  EXPECT_EQ(buffer.getMissing().base.value, 1u);
+}
+
+TEST_F(FragmentBufferTest, RejectsOtherFragmentSizeAndNumbers) {
+  startWithSampleSize(8);
+  const uint8_t data[8] = {};
+
+  EXPECT_FALSE(buffer.add(1, 1, FRAGMENT_SIZE * 2, data, sizeof(data)));
+  EXPECT_FALSE(buffer.add(0, 1, FRAGMENT_SIZE, data, sizeof(data)));
+  EXPECT_FALSE(buffer.add(3, 1, FRAGMENT_SIZE, data, sizeof(data)));
+}
+
+TEST_F(FragmentBufferTest, ReportsMissingFragments) {
+  startWithSampleSize(20);
+  ASSERT_TRUE(addFragment(1));
+  ASSERT_TRUE(addFragment(3));
+  ASSERT_TRUE(addFragment(5));
+
+  const rtps::FragmentNumberSet missing = buffer.getMissing();
+  EXPECT_EQ(missing.base.value, 2u);
+  ASSERT_EQ(missing.numBits, 4u);
+  EXPECT_TRUE(missing.isSet(0));
+  EXPECT_FALSE(missing.isSet(1));
+  EXPECT_TRUE(missing.isSet(2));
+  EXPECT_FALSE(missing.isSet(3));
+}
+
+TEST_F(FragmentBufferTest, StartDropsPreviousSample) {
+  startWithSampleSize(8);
+  ASSERT_TRUE(addFragment(1));
+
+  ASSERT_TRUE(buffer.start(writerGuid, {0, 2}, 8, FRAGMENT_SIZE));
+
+  EXPECT_TRUE(buffer.isFor(writerGuid, {0, 2}));
+  EXPECT_FALSE(buffer.isFor(writerGuid, {0, 1}));
+  EXPECT_EQ(buffer.getMissing().base.value, 1u);
+}
+
+TEST_F(FragmentBufferTest, RejectsSamplesWithTooManyFragments) {
+  EXPECT_FALSE(buffer.start(writerGuid, {0, 1},
+                            (rtps::FNS_NUM_BITS + 1) * FRAGMENT_SIZE,
+                            FRAGMENT_SIZE));
+  EXPECT_FALSE(buffer.isInUse());
+}
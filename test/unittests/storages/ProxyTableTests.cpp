@@ -0,0 +1,158 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#include <gtest/gtest.h>
+
+#include "rtps/storages/ProxyTable.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using rtps::ProxyTable;
+
+namespace {
+using Table = ProxyTable<uint32_t, 2>;
+
+bool isValue(void *value, const uint32_t &element) {
+  return *static_cast<uint32_t *>(value) == element;
+}
+
+bool remove(Table &table, uint32_t value) {
+  return table.remove(isValue, &value);
+}
+
+std::vector<uint32_t> getElements(Table::View &view) {
+  std::vector<uint32_t> elements;
+  for (uint32_t element : view) {
+    elements.push_back(element);
+  }
+  return elements;
+}
+} // namespace
+
+TEST(ProxyTableTest, AddsUntilFull) {
+  Table table;
+  EXPECT_TRUE(table.isEmpty());
+  EXPECT_TRUE(table.add(1));
+  EXPECT_TRUE(table.add(2));
+  EXPECT_FALSE(table.add(3));
+  EXPECT_EQ(table.getNumElements(), 2u);
+
+  auto view = table.read();
+  EXPECT_EQ(getElements(view), (std::vector<uint32_t>{1, 2}));
+}
+
+TEST(ProxyTableTest, ReusesRemovedSlotWithoutViews) {
+  Table table;
+  table.add(1);
+  table.add(2);
+
+  EXPECT_TRUE(remove(table, 1));
+  EXPECT_FALSE(remove(table, 1));
+  EXPECT_EQ(table.getNumElements(), 1u);
+  EXPECT_TRUE(table.add(3));
+
+  auto view = table.read();
+  EXPECT_EQ(getElements(view), (std::vector<uint32_t>{3, 2}));
+}
+
+TEST(ProxyTableTest, KeepsRemovedElementForEarlierView) {
+  Table table;
+  table.add(1);
+  table.add(2);
+  {
+    auto view = table.read();
+    EXPECT_TRUE(remove(table, 1));
+    // The slot is retired, not free
+    EXPECT_FALSE(table.add(3));
+    EXPECT_EQ(getElements(view), (std::vector<uint32_t>{1, 2}));
+
+    auto laterView = table.read();
+    EXPECT_EQ(getElements(laterView), (std::vector<uint32_t>{2}));
+  }
+  EXPECT_TRUE(table.add(3));
+}
+
+TEST(ProxyTableTest, LaterViewDoesNotDelayReclaim) {
+  Table table;
+  table.add(1);
+  table.add(2);
+  auto *earlierView = new Table::View(table.read());
+  remove(table, 1);
+  auto laterView = table.read();
+  EXPECT_FALSE(table.add(3));
+
+  delete earlierView;
+  EXPECT_TRUE(table.add(3));
+  // The later view never saw the removed element, nor sees the new one
+  EXPECT_EQ(getElements(laterView), (std::vector<uint32_t>{2}));
+}
+
+TEST(ProxyTableTest, MovedViewKeepsElement) {
+  Table table;
+  table.add(1);
+  table.add(2);
+  auto view = table.read();
+  remove(table, 2);
+  Table::View movedView(std::move(view));
+  EXPECT_FALSE(table.add(3));
+  EXPECT_EQ(getElements(movedView), (std::vector<uint32_t>{1, 2}));
+}
+
+TEST(ProxyTableTest, ElementsStayUnchangedWhileViewed) {
+  ProxyTable<uint32_t, 4> table;
+  std::atomic<bool> running{true};
+  std::atomic<uint32_t> numChanged{0};
+
+  std::vector<std::thread> readers;
+  for (uint8_t i = 0; i < 3; ++i) {
+    readers.emplace_back([&] {
+      while (running) {
+        auto view = table.read();
+        std::vector<uint32_t> seen;
+        for (uint32_t element : view) {
+          seen.push_back(element);
+        }
+        std::this_thread::yield();
+        uint32_t index = 0;
+        for (uint32_t element : view) {
+          numChanged += element != seen[index++] ? 1 : 0;
+        }
+      }
+    });
+  }
+
+  auto isAny = [](void *, const uint32_t &) { return true; };
+  for (uint32_t value = 1; value < 20000; ++value) {
+    if (!table.add(value)) {
+      table.remove(isAny, nullptr);
+    }
+  }
+  running = false;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(numChanged, 0u);
+}
@@ -0,0 +1,102 @@
+/*
+The MIT License
+Copyright (c) 2019 Lehrstuhl Informatik 11 - RWTH Aachen University
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE
+
+This file is part of embeddedRTPS.
+
+Author: i11 - Embedded Software, RWTH Aachen University
+*/
+
+#ifndef RTPS_TEST_MESSAGEUTILS_H
+#define RTPS_TEST_MESSAGEUTILS_H
+
+#include "rtps/messages/MessageTypes.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace rtps {
+namespace test {
+
+struct SubmessageView {
+  uint32_t offset;
+  SubmessageKind kind;
+  uint8_t flags;
+  //! Body length, i.e. without the submessage header
+  uint32_t length;
+};
+
+//! Splits a serialized RTPS message into its submessages. Returns false if
+//! the message is truncated or a submessage does not start at a multiple of 4
+//! bytes (RTPS 2.3 9.4.1).
+inline bool splitMessage(const std::vector<uint8_t> &message,
+                         std::vector<SubmessageView> &submessages) {
+  submessages.clear();
+  uint32_t offset = Header::getRawSize();
+  if (message.size() < offset) {
+    return false;
+  }
+  while (offset < message.size()) {
+    if (offset % 4 != 0 ||
+        message.size() - offset < SubmessageHeader::getRawSize()) {
+      return false;
+    }
+    SubmessageView view;
+    view.offset = offset;
+    view.kind = static_cast<SubmessageKind>(message[offset]);
+    view.flags = message[offset + 1];
+    if ((view.flags & FLAG_LITTLE_ENDIAN) != 0) {
+      view.length = message[offset + 2] | (message[offset + 3] << 8);
+    } else {
+      view.length = (message[offset + 2] << 8) | message[offset + 3];
+    }
+    offset += SubmessageHeader::getRawSize();
+    if (view.length == 0 && view.kind != SubmessageKind::PAD &&
+        view.kind != SubmessageKind::INFO_TS) {
+      // Extends to the end of the message
+      view.length = static_cast<uint32_t>(message.size() - offset);
+    }
+    if (message.size() - offset < view.length) {
+      return false;
+    }
+    offset += view.length;
+    submessages.push_back(view);
+  }
+  return true;
+}
+
+inline bool isAligned(const std::vector<uint8_t> &message) {
+  std::vector<SubmessageView> submessages;
+  return splitMessage(message, submessages);
+}
+
+inline uint32_t countSubmessages(const std::vector<uint8_t> &message,
+                                 SubmessageKind kind) {
+  std::vector<SubmessageView> submessages;
+  splitMessage(message, submessages);
+  uint32_t count = 0;
+  for (const auto &submessage : submessages) {
+    count += submessage.kind == kind ? 1 : 0;
+  }
+  return count;
+}
+
+} // namespace test
+} // namespace rtps
+
+#endif // RTPS_TEST_MESSAGEUTILS_H